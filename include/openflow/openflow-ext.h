@@ -90,6 +90,153 @@ OFP_ASSERT(sizeof(struct openflow_ext_set_dp_desc) == 272);
 #define ofq_error_string(rv) (((rv) < OFQ_ERR_COUNT) && ((rv) >= 0) ? \
     openflow_queue_error_strings[rv] : "Unknown error code")
 
+/****************************************************************
+ *
+ * OpenFlow extension statistics
+ *
+ ****************************************************************/
+
+/* The body of an OFPST_VENDOR stats request or reply for OPENFLOW_VENDOR_ID
+ * begins with this header. */
+struct ofp_ext_stats_header {
+    uint32_t vendor;            /* OPENFLOW_VENDOR_ID. */
+    uint32_t subtype;           /* One of OFP_EXT_STATS_*. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_stats_header) == 8);
+
+enum ofp_extension_stats_types {
+    /* Packet buffer statistics.
+     * The request body is struct ofp_ext_stats_header.
+     * The reply body is struct ofp_ext_buffer_stats. */
+    OFP_EXT_STATS_BUFFER,
+
+    /* Flow statistics for only the flows that changed since an earlier
+     * request.
+     * The request body is struct ofp_ext_flow_delta_request.
+     * The body of each reply is struct ofp_ext_flow_delta_reply. */
+    OFP_EXT_STATS_FLOW_DELTA,
+
+    /* Flow memory statistics.
+     * The request body is struct ofp_ext_stats_header.
+     * The reply body is struct ofp_ext_flow_slab_stats. */
+    OFP_EXT_STATS_FLOW_SLAB,
+
+    /* Statistics for copies of transmitted packets seen by each port.
+     * The request body is struct ofp_ext_stats_header.
+     * The reply body is struct ofp_ext_stats_header followed by a struct
+     * ofp_ext_port_outgoing_stats for each port. */
+    OFP_EXT_STATS_PORT_OUTGOING,
+
+    /* Hash bucket occupancy and probe statistics for the flow tables that
+     * hash their flows.
+     * The request body is struct ofp_ext_stats_header.
+     * The reply body is struct ofp_ext_stats_header followed by a struct
+     * ofp_ext_table_hash_stats for each such table. */
+    OFP_EXT_STATS_TABLE_HASH
+};
+
+/* Body of reply to OFP_EXT_STATS_BUFFER request. */
+struct ofp_ext_buffer_stats {
+    struct ofp_ext_stats_header header;
+    uint32_t n_buffers;         /* Number of packet buffers. */
+    uint32_t n_active;          /* Number of buffers holding a packet. */
+    uint64_t saved_count;       /* Packets buffered. */
+    uint64_t refused_count;     /* Packets sent unbuffered because every
+                                   buffer held a packet too young to
+                                   overwrite. */
+    uint64_t expired_count;     /* Packets aged out or overwritten without
+                                   being used. */
+    uint64_t hit_count;         /* Buffer ids that found their packet. */
+    uint64_t miss_count;        /* Buffer ids whose packet had already been
+                                   used. */
+    uint64_t stale_count;       /* Buffer ids whose packet had been aged out
+                                   or overwritten. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_buffer_stats) == 64);
+
+/* Body of reply to OFP_EXT_STATS_FLOW_SLAB request.  Flows are allocated from
+ * a slab of fixed-size slots, obtained from the heap in chunks. */
+struct ofp_ext_flow_slab_stats {
+    struct ofp_ext_stats_header header;
+    uint32_t slot_size;         /* Bytes per flow. */
+    uint32_t n_chunks;          /* Chunks obtained from the heap. */
+    uint32_t n_slots;           /* Flows that fit in those chunks. */
+    uint32_t n_used;            /* Flows currently allocated. */
+    uint32_t max_used;          /* Maximum value of 'n_used' so far. */
+    uint32_t n_external;        /* Flows whose actions did not fit in their
+                                   slot and were allocated separately. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_flow_slab_stats) == 32);
+
+/* Part of the reply to an OFP_EXT_STATS_PORT_OUTGOING request.  The switch
+ * transmits packets on some ports through sockets of their own, and the
+ * kernel also delivers a copy of each such packet back to the port's receive
+ * socket.  These copies have to be discarded. */
+struct ofp_ext_port_outgoing_stats {
+    uint16_t port_no;
+    uint8_t pad[6];             /* Align to 64 bits. */
+    uint64_t filtered_count;    /* Copies discarded by the kernel. */
+    uint64_t dropped_count;     /* Copies received by the switch and then
+                                   discarded. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_port_outgoing_stats) == 24);
+
+/* Part of the reply to an OFP_EXT_STATS_TABLE_HASH request.  'table_id' is
+ * as in an OFPST_TABLE reply. */
+struct ofp_ext_table_hash_stats {
+    uint8_t table_id;
+    uint8_t pad[3];             /* Align to 32 bits. */
+    uint32_t active_count;      /* Number of active entries. */
+    uint32_t n_buckets;         /* Number of hash buckets. */
+    uint32_t max_chain;         /* Entries in the fullest bucket. */
+    uint64_t lookup_count;      /* Number of packets looked up in table. */
+    uint64_t probe_count;       /* Entries compared during lookups, or 0 if
+                                   the table does not count them. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_table_hash_stats) == 32);
+
+/* Body of OFP_EXT_STATS_FLOW_DELTA request. */
+struct ofp_ext_flow_delta_request {
+    struct ofp_ext_stats_header header;
+    uint32_t since;             /* 'generation' from an earlier reply, or 0
+                                   to request every flow. */
+    uint8_t pad[4];             /* Align to 64 bits. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_flow_delta_request) == 16);
+
+enum ofp_ext_flow_delta_flags {
+    /* The reply lists every flow, because the request asked for every flow
+     * or because the switch no longer knows which flows were removed since
+     * the requested generation.  Flows that the reply does not list do not
+     * exist. */
+    OFP_EXT_FLOW_DELTA_FULL = 1 << 0
+};
+
+/* Body of each reply to an OFP_EXT_STATS_FLOW_DELTA request.  It is followed
+ * by 'n_removed' instances of struct ofp_ext_flow_delta_removed, then by a
+ * struct ofp_flow_stats, as in an OFPST_FLOW reply, for each flow that was
+ * added, had its actions modified, or had its counters change since the
+ * requested generation. */
+struct ofp_ext_flow_delta_reply {
+    struct ofp_ext_stats_header header;
+    uint32_t generation;        /* Generation to pass in the next request. */
+    uint16_t flags;             /* Bitmap of OFP_EXT_FLOW_DELTA_* flags. */
+    uint16_t n_removed;         /* Number of removed flows that follow. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_flow_delta_reply) == 16);
+
+/* A flow removed since the requested generation. */
+struct ofp_ext_flow_delta_removed {
+    struct ofp_match match;     /* Description of fields. */
+    uint64_t cookie;            /* Opaque controller-issued identifier. */
+    uint64_t packet_count;      /* Final packet count. */
+    uint64_t byte_count;        /* Final byte count. */
+    uint16_t priority;          /* Priority level of flow entry. */
+    uint8_t reason;             /* One of OFPRR_*. */
+    uint8_t pad[5];             /* Align to 64 bits. */
+};
+OFP_ASSERT(sizeof(struct ofp_ext_flow_delta_removed) == 72);
+
 /****************************************************************
  *
  * Unsupported, but potential extended queue properties
@@ -115,6 +115,7 @@ struct dhclient {
     /* Used by dhclient_run() and dhclient_wait() */
     unsigned int min_timeout;
     int received;
+    bool tx_pending;            /* Frame still queued on 'netdev'. */
 
     /* Set when we send out a DHCPDISCOVER message. */
     uint32_t secs;
@@ -790,11 +791,24 @@ dhclient_run_RELEASED(struct dhclient *cli UNUSED)
     /* Nothing to do. */
 }
 
+/* Hands the frame that do_send_msg() queued on 'cli''s network device to
+ * the kernel.  If the kernel has no room for it yet, it stays queued and
+ * dhclient_wait() waits until it is worth trying again. */
+static void
+dhclient_flush(struct dhclient *cli)
+{
+    cli->tx_pending = netdev_send_flush(cli->netdev, NULL) == EAGAIN;
+}
+
 /* Processes the DHCP protocol for 'cli'. */
 void
 dhclient_run(struct dhclient *cli)
 {
     int old_state;
+
+    if (cli->tx_pending) {
+        dhclient_flush(cli);
+    }
     do {
         old_state = cli->state;
         cli->min_timeout = UINT_MAX;
@@ -833,6 +847,9 @@ dhclient_wait(struct dhclient *cli)
     if (cli->state & (S_SELECTING | S_REQUESTING | S_RENEWING | S_REBINDING)) {
         netdev_recv_wait(cli->netdev);
     }
+    if (cli->tx_pending) {
+        netdev_send_wait(cli->netdev);
+    }
 }
 
 static void
@@ -1049,7 +1066,9 @@ do_send_msg(struct dhclient *cli, const struct dhcp_msg *msg)
             VLOG_INFO("sending %s", dhcp_type_name(msg->type));
         }
         error = netdev_send(cli->netdev, &b, 0);
-        if (error) {
+        if (!error) {
+            dhclient_flush(cli);
+        } else {
             VLOG_ERR("send failed on %s: %s",
                      netdev_get_name(cli->netdev), strerror(error));
         }
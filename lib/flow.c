@@ -44,183 +44,158 @@
 #include "vlog.h"
 #define THIS_MODULE VLM_flow
 
-static struct arp_header *
-pull_arp(struct ofpbuf *packet)
+/* Extracts the transport header of the IPv4 packet in 'packet', which begins
+ * 'ofs' bytes into the packet, into 'flow', and points 'packet->l7' just past
+ * it.  'flow->nw_proto' must already be set.  If the transport header is
+ * truncated, clears 'flow->nw_proto' instead, to avoid tricking other code
+ * into thinking that this packet has an L4 header. */
+static void
+extract_l4(struct ofpbuf *packet, size_t ofs, struct flow *flow)
 {
-    if (packet->size >= ARP_ETH_HEADER_LEN) {
-        struct arp_eth_header *arp = packet->data;
-        return ofpbuf_pull(packet, ARP_ETH_HEADER_LEN);
-    }
-    return NULL;
-}
-
-static struct ip_header *
-pull_ip(struct ofpbuf *packet)
-{
-    if (packet->size >= IP_HEADER_LEN) {
-        struct ip_header *ip = packet->data;
-        int ip_len = IP_IHL(ip->ip_ihl_ver) * 4;
-        if (ip_len >= IP_HEADER_LEN && packet->size >= ip_len) {
-            return ofpbuf_pull(packet, ip_len);
+    uint8_t *l4 = (uint8_t *) packet->data + ofs;
+    size_t left = packet->size - ofs;
+    size_t l4_len = 0;
+
+    if (flow->nw_proto == IP_TYPE_TCP) {
+        const struct tcp_header *tcp = (const struct tcp_header *) l4;
+        if (left >= TCP_HEADER_LEN) {
+            l4_len = TCP_OFFSET(tcp->tcp_ctl) * 4;
+            if (l4_len >= TCP_HEADER_LEN && left >= l4_len) {
+                flow->tp_src = tcp->tcp_src;
+                flow->tp_dst = tcp->tcp_dst;
+            } else {
+                l4_len = 0;
+            }
         }
-    }
-    return NULL;
-}
-
-static struct tcp_header *
-pull_tcp(struct ofpbuf *packet) 
-{
-    if (packet->size >= TCP_HEADER_LEN) {
-        struct tcp_header *tcp = packet->data;
-        int tcp_len = TCP_OFFSET(tcp->tcp_ctl) * 4;
-        if (tcp_len >= TCP_HEADER_LEN && packet->size >= tcp_len) {
-            return ofpbuf_pull(packet, tcp_len);
+    } else if (flow->nw_proto == IP_TYPE_UDP) {
+        const struct udp_header *udp = (const struct udp_header *) l4;
+        if (left >= UDP_HEADER_LEN) {
+            flow->tp_src = udp->udp_src;
+            flow->tp_dst = udp->udp_dst;
+            l4_len = UDP_HEADER_LEN;
         }
+    } else if (flow->nw_proto == IP_TYPE_ICMP) {
+        const struct icmp_header *icmp = (const struct icmp_header *) l4;
+        if (left >= ICMP_HEADER_LEN) {
+            flow->icmp_type = htons(icmp->icmp_type);
+            flow->icmp_code = htons(icmp->icmp_code);
+            l4_len = ICMP_HEADER_LEN;
+        }
+    } else {
+        return;
     }
-    return NULL;
-}
-
-static struct udp_header *
-pull_udp(struct ofpbuf *packet) 
-{
-    return ofpbuf_try_pull(packet, UDP_HEADER_LEN);
-}
 
-static struct icmp_header *
-pull_icmp(struct ofpbuf *packet) 
-{
-    return ofpbuf_try_pull(packet, ICMP_HEADER_LEN);
-}
-
-static struct eth_header *
-pull_eth(struct ofpbuf *packet) 
-{
-    return ofpbuf_try_pull(packet, ETH_HEADER_LEN);
-}
-
-static struct vlan_header *
-pull_vlan(struct ofpbuf *packet)
-{
-    return ofpbuf_try_pull(packet, VLAN_HEADER_LEN);
+    if (l4_len) {
+        packet->l7 = l4 + l4_len;
+    } else {
+        flow->nw_proto = 0;
+    }
 }
 
-/* Returns 1 if 'packet' is an IP fragment, 0 otherwise. */
+/* Extracts the flow in 'packet', received on 'in_port', into 'flow', and
+ * points 'packet''s l2, l3, l4, and l7 members at the headers that it finds.
+ *
+ * The packet is parsed in a single pass: each header is read in place at its
+ * offset from the start of the packet, after checking that it fits, so
+ * 'packet->data' and 'packet->size' are never modified.
+ *
+ * Returns 1 if 'packet' is an IP fragment, 0 otherwise. */
 int
 flow_extract(struct ofpbuf *packet, uint16_t in_port, struct flow *flow)
 {
-    struct ofpbuf b = *packet;
-    struct eth_header *eth;
-    int retval = 0;
+    uint8_t *data = packet->data;
+    size_t size = packet->size;
+    const struct eth_header *eth;
+    size_t ofs;
 
     memset(flow, 0, sizeof *flow);
     flow->dl_vlan = htons(OFP_VLAN_NONE);
     flow->in_port = htons(in_port);
 
-    packet->l2 = b.data;
+    packet->l2 = data;
     packet->l3 = NULL;
     packet->l4 = NULL;
     packet->l7 = NULL;
 
-    eth = pull_eth(&b);
-    if (eth) {
-        if (ntohs(eth->eth_type) >= OFP_DL_TYPE_ETH2_CUTOFF) {
-            /* This is an Ethernet II frame */
-            flow->dl_type = eth->eth_type;
+    if (size < ETH_HEADER_LEN) {
+        return 0;
+    }
+    eth = (const struct eth_header *) data;
+    ofs = ETH_HEADER_LEN;
+
+    if (ntohs(eth->eth_type) >= OFP_DL_TYPE_ETH2_CUTOFF) {
+        /* This is an Ethernet II frame */
+        flow->dl_type = eth->eth_type;
+    } else {
+        /* This is an 802.2 frame */
+        const struct llc_snap_header *llc_snap
+            = (const struct llc_snap_header *) (data + ofs);
+        if (size - ofs < LLC_HEADER_LEN) {
+            return 0;
+        }
+        if (size - ofs >= LLC_SNAP_HEADER_LEN
+            && llc_snap->llc.llc_dsap == LLC_DSAP_SNAP
+            && llc_snap->llc.llc_ssap == LLC_SSAP_SNAP
+            && llc_snap->llc.llc_cntl == LLC_CNTL_SNAP
+            && !memcmp(llc_snap->snap.snap_org, SNAP_ORG_ETHERNET,
+                       sizeof llc_snap->snap.snap_org)) {
+            flow->dl_type = llc_snap->snap.snap_type;
+            ofs += LLC_SNAP_HEADER_LEN;
         } else {
-            /* This is an 802.2 frame */
-            struct llc_header *llc = ofpbuf_at(&b, 0, sizeof *llc);
-            struct snap_header *snap = ofpbuf_at(&b, sizeof *llc,
-                                                 sizeof *snap);
-            if (llc == NULL) {
-                return 0;
-            }
-            if (snap
-                && llc->llc_dsap == LLC_DSAP_SNAP
-                && llc->llc_ssap == LLC_SSAP_SNAP
-                && llc->llc_cntl == LLC_CNTL_SNAP
-                && !memcmp(snap->snap_org, SNAP_ORG_ETHERNET,
-                           sizeof snap->snap_org)) {
-                flow->dl_type = snap->snap_type;
-                ofpbuf_pull(&b, LLC_SNAP_HEADER_LEN);
-            } else {
-                flow->dl_type = htons(OFP_DL_TYPE_NOT_ETH_TYPE);
-                ofpbuf_pull(&b, sizeof(struct llc_header));
-            }
+            flow->dl_type = htons(OFP_DL_TYPE_NOT_ETH_TYPE);
+            ofs += LLC_HEADER_LEN;
         }
+    }
 
-        /* Check for a VLAN tag */
-        if (flow->dl_type == htons(ETH_TYPE_VLAN)) {
-            struct vlan_header *vh = pull_vlan(&b);
-            if (vh) {
-                flow->dl_type = vh->vlan_next_type;
-                flow->dl_vlan = vh->vlan_tci & htons(VLAN_VID_MASK);
-                flow->dl_vlan_pcp = (uint8_t)((ntohs(vh->vlan_tci) >> VLAN_PCP_SHIFT)
-                                               & VLAN_PCP_BITMASK);
-            }
-        }
-        memcpy(flow->dl_src, eth->eth_src, ETH_ADDR_LEN);
-        memcpy(flow->dl_dst, eth->eth_dst, ETH_ADDR_LEN);
+    /* Check for a VLAN tag */
+    if (flow->dl_type == htons(ETH_TYPE_VLAN) && size - ofs >= VLAN_HEADER_LEN) {
+        const struct vlan_header *vh
+            = (const struct vlan_header *) (data + ofs);
+        flow->dl_type = vh->vlan_next_type;
+        flow->dl_vlan = vh->vlan_tci & htons(VLAN_VID_MASK);
+        flow->dl_vlan_pcp = (uint8_t)((ntohs(vh->vlan_tci) >> VLAN_PCP_SHIFT)
+                                      & VLAN_PCP_BITMASK);
+        ofs += VLAN_HEADER_LEN;
+    }
+    memcpy(flow->dl_src, eth->eth_src, ETH_ADDR_LEN);
+    memcpy(flow->dl_dst, eth->eth_dst, ETH_ADDR_LEN);
 
-        packet->l3 = b.data;
-        if (flow->dl_type == htons(ETH_TYPE_IP)) {
-            const struct ip_header *nh = pull_ip(&b);
-            if (nh) {
-                flow->nw_tos = nh->ip_tos & 0xfc;
-                flow->nw_proto = nh->ip_proto;
-                flow->nw_src = nh->ip_src;
-                flow->nw_dst = nh->ip_dst;
-                packet->l4 = b.data;
-                if (!IP_IS_FRAGMENT(nh->ip_frag_off)) {
-                    if (flow->nw_proto == IP_TYPE_TCP) {
-                        const struct tcp_header *tcp = pull_tcp(&b);
-                        if (tcp) {
-                            flow->tp_src = tcp->tcp_src;
-                            flow->tp_dst = tcp->tcp_dst;
-                            packet->l7 = b.data;
-                        } else {
-                            /* Avoid tricking other code into thinking that
-                             * this packet has an L4 header. */
-                            flow->nw_proto = 0;
-                        }
-                    } else if (flow->nw_proto == IP_TYPE_UDP) {
-                        const struct udp_header *udp = pull_udp(&b);
-                        if (udp) {
-                            flow->tp_src = udp->udp_src;
-                            flow->tp_dst = udp->udp_dst;
-                            packet->l7 = b.data;
-                        } else {
-                            /* Avoid tricking other code into thinking that
-                             * this packet has an L4 header. */
-                            flow->nw_proto = 0;
-                        }
-                    } else if (flow->nw_proto == IP_TYPE_ICMP) {
-                        const struct icmp_header *icmp = pull_icmp(&b);
-                        if (icmp) {
-                            flow->icmp_type = htons(icmp->icmp_type);
-                            flow->icmp_code = htons(icmp->icmp_code);
-                            packet->l7 = b.data;
-                        } else {
-                            /* Avoid tricking other code into thinking that
-                             * this packet has an L4 header. */
-                            flow->nw_proto = 0;
-                        }
-                    }
-                } else {
-                    retval = 1;
-                }
-            }
-        } else if (flow->dl_type == htons(ETH_TYPE_ARP)) {
-            const struct arp_eth_header *arp = pull_arp(&b);
-            if (arp) {
-                if (arp->ar_pro == htons(ARP_PRO_IP) && arp->ar_pln == IP_ADDR_LEN) {
-                    flow->nw_src = arp->ar_spa;
-                    flow->nw_dst = arp->ar_tpa;
-                }
-                flow->nw_proto = ntohs(arp->ar_op) & 0xff;
+    packet->l3 = data + ofs;
+    if (flow->dl_type == htons(ETH_TYPE_IP)) {
+        const struct ip_header *nh = (const struct ip_header *) (data + ofs);
+        size_t ip_len;
+
+        if (size - ofs < IP_HEADER_LEN) {
+            return 0;
+        }
+        ip_len = IP_IHL(nh->ip_ihl_ver) * 4;
+        if (ip_len < IP_HEADER_LEN || size - ofs < ip_len) {
+            return 0;
+        }
+        flow->nw_tos = nh->ip_tos & 0xfc;
+        flow->nw_proto = nh->ip_proto;
+        flow->nw_src = nh->ip_src;
+        flow->nw_dst = nh->ip_dst;
+        ofs += ip_len;
+        packet->l4 = data + ofs;
+
+        if (IP_IS_FRAGMENT(nh->ip_frag_off)) {
+            return 1;
+        }
+        extract_l4(packet, ofs, flow);
+    } else if (flow->dl_type == htons(ETH_TYPE_ARP)) {
+        const struct arp_eth_header *arp
+            = (const struct arp_eth_header *) (data + ofs);
+        if (size - ofs >= ARP_ETH_HEADER_LEN) {
+            if (arp->ar_pro == htons(ARP_PRO_IP)
+                && arp->ar_pln == IP_ADDR_LEN) {
+                flow->nw_src = arp->ar_spa;
+                flow->nw_dst = arp->ar_tpa;
             }
+            flow->nw_proto = ntohs(arp->ar_op) & 0xff;
         }
     }
-    return retval;
+    return 0;
 }
 
 void
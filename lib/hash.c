@@ -59,10 +59,9 @@
       c ^= b; c -= rot(b, 24);                  \
     } while (0)
 
-/* Returns the hash of the 'n' 32-bit words at 'p', starting from 'basis'.
- * 'p' must be properly aligned. */
-uint32_t
-hash_words(const uint32_t *p, size_t n, uint32_t basis)
+static inline void
+hash_words__(const uint32_t *p, size_t n, uint32_t basis,
+             uint32_t *bp, uint32_t *cp)
 {
     uint32_t a, b, c;
 
@@ -91,9 +90,30 @@ hash_words(const uint32_t *p, size_t n, uint32_t basis)
     case 0:
         break;
     }
+    *bp = b;
+    *cp = c;
+}
+
+/* Returns the hash of the 'n' 32-bit words at 'p', starting from 'basis'.
+ * 'p' must be properly aligned. */
+uint32_t
+hash_words(const uint32_t *p, size_t n, uint32_t basis)
+{
+    uint32_t b, c;
+
+    hash_words__(p, n, basis, &b, &c);
     return c;
 }
 
+/* Stores two hashes of the 'n' 32-bit words at 'p', starting from 'basis',
+ * into 'hashes'.  hashes[0] is the value that hash_words() would return.
+ * 'p' must be properly aligned. */
+void
+hash_words2(const uint32_t *p, size_t n, uint32_t basis, uint32_t hashes[2])
+{
+    hash_words__(p, n, basis, &hashes[1], &hashes[0]);
+}
+
 /* Returns the hash of the 'n' bytes at 'p', starting from 'basis'. */
 uint32_t
 hash_bytes(const void *p_, size_t n, uint32_t basis)
@@ -37,6 +37,8 @@
 #include <stdint.h>
 
 uint32_t hash_words(const uint32_t *, size_t n_word, uint32_t basis);
+void hash_words2(const uint32_t *, size_t n_word, uint32_t basis,
+                 uint32_t hashes[2]);
 uint32_t hash_bytes(const void *, size_t n_bytes, uint32_t basis);
 
 #endif /* hash.h */
@@ -83,7 +83,7 @@ static inline void hmap_remove(struct hmap *, struct hmap_node *);
 #define HMAP_FOR_EACH_WITH_HASH(NODE, STRUCT, MEMBER, HASH, HMAP)       \
     for ((NODE) = CONTAINER_OF(hmap_first_with_hash(HMAP, HASH),        \
                                STRUCT, MEMBER);                         \
-         &(NODE)->MEMBER != NULL;                                       \
+         (NODE) != CONTAINER_OF(NULL, STRUCT, MEMBER);                  \
          (NODE) = CONTAINER_OF(hmap_next_with_hash(&(NODE)->MEMBER),    \
                                STRUCT, MEMBER))
 
@@ -98,13 +98,13 @@ static inline struct hmap_node *hmap_next_with_hash(const struct hmap_node *);
  * intact. */
 #define HMAP_FOR_EACH(NODE, STRUCT, MEMBER, HMAP)                   \
     for ((NODE) = CONTAINER_OF(hmap_first(HMAP), STRUCT, MEMBER);   \
-         &(NODE)->MEMBER != NULL;                                   \
+         (NODE) != CONTAINER_OF(NULL, STRUCT, MEMBER);              \
          (NODE) = CONTAINER_OF(hmap_next(HMAP, &(NODE)->MEMBER),    \
                                STRUCT, MEMBER))
 
 #define HMAP_FOR_EACH_SAFE(NODE, NEXT, STRUCT, MEMBER, HMAP)        \
     for ((NODE) = CONTAINER_OF(hmap_first(HMAP), STRUCT, MEMBER);   \
-         (&(NODE)->MEMBER != NULL                                   \
+         ((NODE) != CONTAINER_OF(NULL, STRUCT, MEMBER)              \
           ? (NEXT) = CONTAINER_OF(hmap_next(HMAP, &(NODE)->MEMBER), \
                                   STRUCT, MEMBER), 1                \
           : 0);                                                     \
@@ -58,17 +58,18 @@
 #endif
 
 #include <linux/ethtool.h>
+#include <linux/filter.h>
 #include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #include <linux/version.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <net/if_arp.h>
-#include <net/if_packet.h>
 #include <net/route.h>
 #include <netinet/in.h>
 #include <stdlib.h>
@@ -127,8 +128,70 @@ struct netdev {
 
     int save_flags;             /* Initial device flags. */
     int changed_flags;          /* Flags that we changed. */
+
+    /* Memory-mapped packet rings, or a null pointer if the device was not
+     * opened with the "mmap:" prefix. */
+    struct netdev_ring *ring;
+
+    /* Packets that netdev_send() has queued for transmission with sendmmsg(),
+     * or a null pointer if none have been queued yet.  Used only for devices
+     * that have neither a TX ring nor a TAP device. */
+    struct netdev_txq *txq;
+
+    /* Queued packets dropped because of errors, not yet reported by
+     * netdev_send_flush(). */
+    struct netdev_send_drops send_drops;
+
+    /* Copies of packets that we transmit through the queue sockets are also
+     * delivered to the receive socket, as PACKET_OUTGOING.  If 'filtering'
+     * is true, the kernel discards them before they reach us. */
+    bool filtering;
+    unsigned long long n_outgoing_filtered; /* Discarded by the kernel. */
+    unsigned long long n_outgoing_dropped;  /* Discarded in userspace. */
 };
 
+#ifdef TPACKET3_HDRLEN
+/* PACKET_MMAP rings shared with the kernel.  The RX ring is made up of
+ * TPACKET_V3 blocks, each holding a variable number of frames, which the
+ * kernel hands over to us a block at a time.  The TX ring is made up of
+ * fixed-size frames.
+ *
+ * Blocks that netdev_recv_ring() has read completely are "held" until
+ * netdev_release_ring() gives them back to the kernel, because the ofpbufs
+ * that it returned point into them.  Thus, rx_released + rx_held == rx_block,
+ * modulo the number of blocks. */
+struct netdev_ring {
+    char *map;                  /* mmap()'d RX ring, followed by TX ring. */
+    size_t map_size;
+
+    struct tpacket_req3 rx_req;
+    unsigned int rx_block;      /* Block being read. */
+    unsigned int rx_left;       /* Frames not yet read in 'rx_block'. */
+    struct tpacket3_hdr *rx_frame; /* Next frame to read in 'rx_block'. */
+    unsigned int rx_released;   /* First block held. */
+    unsigned int rx_held;       /* Number of blocks held. */
+
+    char *tx_map;               /* Start of TX ring, or null if none. */
+    struct tpacket_req3 tx_req;
+    unsigned int tx_frame;      /* Next frame to fill. */
+    unsigned int tx_pending;    /* Frames filled but not yet flushed. */
+};
+
+/* Number of bytes of data in each RX ring and each TX ring. */
+#define NETDEV_RING_RX_SIZE (4 * 1024 * 1024)
+#define NETDEV_RING_TX_SIZE (512 * 1024)
+
+/* Size of each ring block. */
+#define NETDEV_RING_BLOCK_SIZE (64 * 1024)
+
+/* Milliseconds after which the kernel hands over a partially full RX
+ * block. */
+#define NETDEV_RING_TIMEOUT 2
+
+/* Offset of packet data within a TX frame. */
+#define NETDEV_RING_TX_OFFSET TPACKET_ALIGN(sizeof(struct tpacket3_hdr))
+#endif /* TPACKET3_HDRLEN */
+
 /* All open network devices. */
 static struct list netdev_list = LIST_INITIALIZER(&netdev_list);
 
@@ -142,6 +205,13 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
 static void init_netdev(void);
 static int do_open_netdev(const char *name, int ethertype, int tap_fd,
                           struct netdev **netdev_);
+static bool filter_outgoing(int fd, const char *name);
+static int open_ring(struct netdev *);
+static void close_ring(struct netdev *);
+static int ring_send(struct netdev *, const struct ofpbuf *);
+#ifdef HAVE_SENDMMSG
+static int txq_flush(struct netdev *);
+#endif
 static int restore_flags(struct netdev *netdev);
 static int get_flags(const char *netdev_name, int *flagsp);
 static int set_flags(const char *netdev_name, int flags);
@@ -623,12 +693,28 @@ do_ethtool(struct netdev *netdev)
  * 'ethertype' may be a 16-bit Ethernet protocol value in host byte order to
  * capture frames of that type received on the device.  It may also be one of
  * the 'enum netdev_pseudo_ethertype' values to receive frames in one of those
- * categories. */
+ * categories.
+ *
+ * If 'name' begins with "tap:", the rest of it names a TAP device to create
+ * (see netdev_open_tap()).  If 'name' begins with "mmap:", the rest of it
+ * names a network device that is accessed through packet rings shared with
+ * the kernel instead of with a system call per packet (see
+ * netdev_recv_ring()). */
 int
 netdev_open(const char *name, int ethertype, struct netdev **netdevp)
 {
     if (!strncmp(name, "tap:", 4)) {
         return netdev_open_tap(name + 4, netdevp);
+    } else if (!strncmp(name, "mmap:", 5)) {
+        int error = do_open_netdev(name + 5, ethertype, -1, netdevp);
+        if (!error) {
+            error = open_ring(*netdevp);
+            if (error) {
+                netdev_close(*netdevp);
+                *netdevp = NULL;
+            }
+        }
+        return error;
     } else {
         return do_open_netdev(name, ethertype, -1, netdevp);
     }
@@ -680,6 +766,39 @@ netdev_open_tap(const char *name, struct netdev **netdevp)
     return error;
 }
 
+/* Arranges for the kernel not to deliver PACKET_OUTGOING packets to the
+ * packet socket 'fd', bound to network device 'name', so that we do not have
+ * to receive and discard them.  Returns true if successful. */
+static bool
+filter_outgoing(int fd, const char *name)
+{
+    /* Classic BPF equivalent of "if (pkttype == PACKET_OUTGOING) drop". */
+    static struct sock_filter insns[] = {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_RET | BPF_K, UINT32_MAX),
+    };
+    struct sock_fprog prog;
+
+#ifdef PACKET_IGNORE_OUTGOING
+    int ignore = 1;
+    if (!setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING,
+                    &ignore, sizeof ignore)) {
+        return true;
+    }
+#endif
+
+    prog.len = ARRAY_SIZE(insns);
+    prog.filter = insns;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof prog)) {
+        VLOG_WARN("%s: could not filter outgoing packets in kernel: %s",
+                  name, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
 static int
 do_open_netdev(const char *name, int ethertype, int tap_fd,
                struct netdev **netdev_)
@@ -693,6 +812,7 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
     int mtu;
     int txqlen;
     int hwaddr_family;
+    bool filtering;
     int error;
     struct netdev *netdev;
 
@@ -733,7 +853,10 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
         goto error;
     }
 
+    filtering = false;
     if (ethertype != NETDEV_ETH_TYPE_NONE) {
+        filtering = filter_outgoing(netdev_fd, name);
+
         /* Between the socket() and bind() calls above, the socket receives all
          * packets of the requested type on all system interfaces.  We do not
          * want to receive that data, but there is no way to avoid it.  So we
@@ -788,6 +911,12 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
     netdev->mtu = mtu;
     netdev->in6 = in6;
     netdev->num_queues = 0;
+    netdev->ring = NULL;
+    netdev->txq = NULL;
+    memset(&netdev->send_drops, 0, sizeof netdev->send_drops);
+    netdev->filtering = filtering;
+    netdev->n_outgoing_filtered = 0;
+    netdev->n_outgoing_dropped = 0;
 
     /* Get speed, features. */
     do_ethtool(netdev);
@@ -835,14 +964,29 @@ netdev_close(struct netdev *netdev)
                       netdev->name, strerror(error));
         }
 
+        if (netdev->n_outgoing_filtered || netdev->n_outgoing_dropped) {
+            VLOG_INFO("%s: %llu outgoing packets filtered in kernel, "
+                      "%llu dropped in userspace", netdev->name,
+                      netdev->n_outgoing_filtered,
+                      netdev->n_outgoing_dropped);
+        }
+
         /* Free. */
+        close_ring(netdev);
+        if (netdev->txq) {
+            netdev_send_flush(netdev, NULL);
+            free(netdev->txq);
+        }
         free(netdev->name);
+        poll_fd_forget(netdev->netdev_fd);
         close(netdev->netdev_fd);
         if (netdev->netdev_fd != netdev->tap_fd) {
+            poll_fd_forget(netdev->tap_fd);
             close(netdev->tap_fd);
         }
 
         for (i =1; i <= netdev->num_queues; i++) {
+            poll_fd_forget(netdev->queue_fd[i]);
             close(netdev->queue_fd[i]);
         }
         free(netdev);
@@ -859,6 +1003,380 @@ pad_to_minimum_length(struct ofpbuf *buffer)
     }
 }
 
+#ifdef TPACKET3_HDRLEN
+/* Sets up packet rings on 'netdev''s socket.  The TX ring is optional, since
+ * only Linux 4.11 and later support one with TPACKET_V3; without it, packets
+ * are transmitted with write() as usual. */
+static int
+open_ring(struct netdev *netdev)
+{
+    int version = TPACKET_V3;
+    int reserve = NETDEV_RING_HEADROOM;
+    int loss = 1;
+    int fd = netdev->netdev_fd;
+    struct netdev_ring *r;
+    size_t frame_size, rx_size, tx_size;
+    int error;
+
+    if (netdev->tap_fd != netdev->netdev_fd) {
+        return EOPNOTSUPP;
+    }
+
+    /* Each frame must have room for the TPACKET_V3 header, the reserved
+     * headroom, and a maximum-size VLAN-tagged frame.  The kernel requires
+     * the frame size to be a multiple of TPACKET_ALIGNMENT, and we want it to
+     * divide the block size, so round up to a power of 2. */
+    frame_size = 2048;
+    while (frame_size < (TPACKET3_HDRLEN + NETDEV_RING_HEADROOM + 16
+                         + VLAN_ETH_HEADER_LEN + netdev->mtu)) {
+        frame_size *= 2;
+    }
+    if (frame_size > NETDEV_RING_BLOCK_SIZE) {
+        VLOG_ERR("%s: MTU %d too large for packet ring",
+                 netdev->name, netdev->mtu);
+        return EMSGSIZE;
+    }
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION,
+                   &version, sizeof version) < 0
+        || setsockopt(fd, SOL_PACKET, PACKET_RESERVE,
+                      &reserve, sizeof reserve) < 0
+        || setsockopt(fd, SOL_PACKET, PACKET_LOSS, &loss, sizeof loss) < 0) {
+        error = errno;
+        VLOG_ERR("%s: setting up TPACKET_V3 socket failed: %s",
+                 netdev->name, strerror(error));
+        return error;
+    }
+
+    r = xcalloc(1, sizeof *r);
+    r->rx_req.tp_block_size = NETDEV_RING_BLOCK_SIZE;
+    r->rx_req.tp_block_nr = NETDEV_RING_RX_SIZE / NETDEV_RING_BLOCK_SIZE;
+    r->rx_req.tp_frame_size = frame_size;
+    r->rx_req.tp_frame_nr = (NETDEV_RING_RX_SIZE / frame_size);
+    r->rx_req.tp_retire_blk_tov = NETDEV_RING_TIMEOUT;
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING,
+                   &r->rx_req, sizeof r->rx_req) < 0) {
+        error = errno;
+        VLOG_ERR("%s: setting up RX ring failed: %s",
+                 netdev->name, strerror(error));
+        free(r);
+        return error;
+    }
+    rx_size = NETDEV_RING_RX_SIZE;
+
+    r->tx_req.tp_block_size = NETDEV_RING_BLOCK_SIZE;
+    r->tx_req.tp_block_nr = NETDEV_RING_TX_SIZE / NETDEV_RING_BLOCK_SIZE;
+    r->tx_req.tp_frame_size = frame_size;
+    r->tx_req.tp_frame_nr = NETDEV_RING_TX_SIZE / frame_size;
+    if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING,
+                   &r->tx_req, sizeof r->tx_req) < 0) {
+        VLOG_WARN("%s: no TX ring, transmitting with write(): %s",
+                  netdev->name, strerror(errno));
+        memset(&r->tx_req, 0, sizeof r->tx_req);
+        tx_size = 0;
+    } else {
+        tx_size = NETDEV_RING_TX_SIZE;
+    }
+
+    r->map_size = rx_size + tx_size;
+    r->map = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  fd, 0);
+    if (r->map == MAP_FAILED) {
+        error = errno;
+        VLOG_ERR("%s: mmap of packet ring failed: %s",
+                 netdev->name, strerror(error));
+        free(r);
+        return error;
+    }
+    r->tx_map = tx_size ? r->map + rx_size : NULL;
+    netdev->ring = r;
+
+    /* Discard anything received before the ring was set up, since nothing
+     * will ever read it from the socket's receive queue. */
+    drain_rcvbuf(fd);
+
+    VLOG_DBG("%s: using %zu kB RX and %zu kB TX packet rings, "
+             "%zu-byte frames", netdev->name, rx_size / 1024, tx_size / 1024,
+             frame_size);
+    return 0;
+}
+
+static void
+close_ring(struct netdev *netdev)
+{
+    struct netdev_ring *r = netdev->ring;
+    if (r) {
+        munmap(r->map, r->map_size);
+        free(r);
+        netdev->ring = NULL;
+    }
+}
+
+static struct tpacket_block_desc *
+ring_rx_block(const struct netdev_ring *r, unsigned int idx)
+{
+    return (struct tpacket_block_desc *)
+        (r->map + (size_t) idx * r->rx_req.tp_block_size);
+}
+
+/* Finishes reading the current RX block, holding it until
+ * netdev_release_ring(). */
+static void
+ring_rx_next_block(struct netdev_ring *r)
+{
+    r->rx_block = (r->rx_block + 1) % r->rx_req.tp_block_nr;
+    r->rx_held++;
+}
+
+/* Returns the next frame in 'r''s RX ring, or a null pointer if none is
+ * ready.  Stores in '*endp' the end of the space available to the frame. */
+static struct tpacket3_hdr *
+ring_rx_next(struct netdev_ring *r, char **endp)
+{
+    struct tpacket_block_desc *bd;
+    struct tpacket3_hdr *frame;
+
+    while (!r->rx_left) {
+        if (r->rx_held >= r->rx_req.tp_block_nr) {
+            return NULL;
+        }
+        bd = ring_rx_block(r, r->rx_block);
+        if (!(bd->hdr.bh1.block_status & TP_STATUS_USER)) {
+            return NULL;
+        }
+        __sync_synchronize();
+        r->rx_left = bd->hdr.bh1.num_pkts;
+        r->rx_frame = (struct tpacket3_hdr *)
+            ((char *) bd + bd->hdr.bh1.offset_to_first_pkt);
+        if (!r->rx_left) {
+            ring_rx_next_block(r);
+        }
+    }
+
+    frame = r->rx_frame;
+    if (--r->rx_left) {
+        r->rx_frame = (struct tpacket3_hdr *)
+            ((char *) frame + frame->tp_next_offset);
+        *endp = (char *) r->rx_frame;
+    } else {
+        *endp = ((char *) ring_rx_block(r, r->rx_block)
+                 + r->rx_req.tp_block_size);
+        ring_rx_next_block(r);
+    }
+    return frame;
+}
+
+/* Receives up to 'n' packets from 'netdev''s RX ring without copying them.
+ * Stores in each of the first '*n_recvp' elements of 'buffers' a newly
+ * allocated ofpbuf whose data points into the ring, with at least
+ * NETDEV_RING_HEADROOM bytes of headroom.  The caller must delete each of
+ * them (or make sure that none refers to the ring any longer, e.g. by
+ * expanding it, which copies its data) and then call netdev_release_ring()
+ * before receiving from 'netdev' again in any way.
+ *
+ * Returns 0 if at least one packet is received, otherwise a positive errno
+ * value: EAGAIN if no packet is ready, or EOPNOTSUPP if 'netdev' has no RX
+ * ring. */
+int
+netdev_recv_ring(struct netdev *netdev, struct ofpbuf *buffers[], size_t n,
+                 size_t *n_recvp)
+{
+    struct netdev_ring *r = netdev->ring;
+    struct tpacket3_hdr *frame;
+    size_t n_recv;
+    char *end;
+
+    *n_recvp = 0;
+    if (!r) {
+        return EOPNOTSUPP;
+    }
+
+    n_recv = 0;
+    while (n_recv < n && (frame = ring_rx_next(r, &end)) != NULL) {
+        struct sockaddr_ll *sll;
+        struct ofpbuf *b;
+        char *base;
+
+        /* Drop our own transmissions, as in netdev_recv(). */
+        sll = (struct sockaddr_ll *)
+            ((char *) frame + TPACKET_ALIGN(sizeof *frame));
+        if (sll->sll_pkttype == PACKET_OUTGOING) {
+            netdev->n_outgoing_dropped++;
+            continue;
+        }
+
+        base = (char *) (sll + 1);
+        b = xmalloc(sizeof *b);
+        ofpbuf_use_foreign(b, base, end - base);
+        b->data = (char *) frame + frame->tp_mac;
+        b->size = frame->tp_snaplen;
+        pad_to_minimum_length(b);
+        buffers[n_recv++] = b;
+    }
+    *n_recvp = n_recv;
+    return n_recv ? 0 : EAGAIN;
+}
+
+/* Gives back to the kernel the RX ring blocks that 'netdev' has finished
+ * reading.  See netdev_recv_ring() for details. */
+void
+netdev_release_ring(struct netdev *netdev)
+{
+    struct netdev_ring *r = netdev->ring;
+
+    if (!r) {
+        return;
+    }
+    if (r->rx_held) {
+        __sync_synchronize();
+    }
+    for (; r->rx_held; r->rx_held--) {
+        ring_rx_block(r, r->rx_released)->hdr.bh1.block_status
+            = TP_STATUS_KERNEL;
+        r->rx_released = (r->rx_released + 1) % r->rx_req.tp_block_nr;
+    }
+}
+
+/* Receives a single packet from 'netdev''s RX ring into 'buffer', copying
+ * it. */
+static int
+ring_recv_copy(struct netdev *netdev, struct ofpbuf *buffer)
+{
+    struct ofpbuf *b;
+    size_t n_recv;
+    int error;
+
+    error = netdev_recv_ring(netdev, &b, 1, &n_recv);
+    if (!error) {
+        ofpbuf_put(buffer, b->data, MIN(b->size, ofpbuf_tailroom(buffer)));
+        ofpbuf_delete(b);
+    }
+    netdev_release_ring(netdev);
+    return error;
+}
+
+/* Queues 'buffer' for transmission in 'netdev''s TX ring.  The kernel is
+ * told about queued packets only when the ring is getting full or on a call
+ * to netdev_send_flush(). */
+static int
+ring_send(struct netdev *netdev, const struct ofpbuf *buffer)
+{
+    struct netdev_ring *r = netdev->ring;
+    struct tpacket3_hdr *frame;
+
+    frame = (struct tpacket3_hdr *)
+        (r->tx_map + (size_t) r->tx_frame * r->tx_req.tp_frame_size);
+    if (frame->tp_status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) {
+        netdev_send_flush(netdev, NULL);
+        return EAGAIN;
+    }
+    if (buffer->size > r->tx_req.tp_frame_size - NETDEV_RING_TX_OFFSET) {
+        VLOG_WARN_RL(&rl, "%zu-byte packet too big for TX ring on %s",
+                     buffer->size, netdev->name);
+        return EMSGSIZE;
+    }
+
+    memcpy((char *) frame + NETDEV_RING_TX_OFFSET, buffer->data,
+           buffer->size);
+    frame->tp_len = buffer->size;
+    frame->tp_snaplen = buffer->size;
+    frame->tp_next_offset = 0;
+    __sync_synchronize();
+    frame->tp_status = TP_STATUS_SEND_REQUEST;
+
+    r->tx_frame = (r->tx_frame + 1) % r->tx_req.tp_frame_nr;
+    if (++r->tx_pending >= r->tx_req.tp_frame_nr / 4) {
+        netdev_send_flush(netdev, NULL);
+    }
+    return 0;
+}
+#else  /* !TPACKET3_HDRLEN */
+static int
+open_ring(struct netdev *netdev UNUSED)
+{
+    return EOPNOTSUPP;
+}
+
+static void
+close_ring(struct netdev *netdev UNUSED)
+{
+}
+
+int
+netdev_recv_ring(struct netdev *netdev UNUSED,
+                 struct ofpbuf *buffers[] UNUSED, size_t n UNUSED,
+                 size_t *n_recvp)
+{
+    *n_recvp = 0;
+    return EOPNOTSUPP;
+}
+
+void
+netdev_release_ring(struct netdev *netdev UNUSED)
+{
+}
+
+static int
+ring_recv_copy(struct netdev *netdev UNUSED, struct ofpbuf *buffer UNUSED)
+{
+    NOT_REACHED();
+}
+
+static int
+ring_send(struct netdev *netdev UNUSED, const struct ofpbuf *buffer UNUSED)
+{
+    NOT_REACHED();
+}
+#endif /* !TPACKET3_HDRLEN */
+
+/* Returns true if 'netdev' was opened with packet rings, so that
+ * netdev_recv_ring() can receive packets from it without copying them. */
+bool
+netdev_has_ring(const struct netdev *netdev)
+{
+    return netdev->ring != NULL;
+}
+
+/* Tells the kernel to transmit any packets that netdev_send() has queued on
+ * 'netdev' but not yet handed over.  Returns 0 if no packets remain queued,
+ * or EAGAIN if the kernel had no room for some of them, in which case they
+ * stay queued for the next call; netdev_send_wait() can be used to wait until
+ * it is worth trying again.
+ *
+ * If 'drops' is nonnull, stores in it the queued packets that were dropped
+ * because of errors since the last time that they were reported this way,
+ * including by flushes within netdev_send().  netdev_send() returned 0 for
+ * them, so callers that count transmitted packets should take these back
+ * out. */
+int
+netdev_send_flush(struct netdev *netdev, struct netdev_send_drops *drops)
+{
+    int error = 0;
+
+#ifdef TPACKET3_HDRLEN
+    struct netdev_ring *r = netdev->ring;
+
+    if (r && r->tx_pending) {
+        r->tx_pending = 0;
+        if (send(netdev->netdev_fd, NULL, 0, MSG_DONTWAIT) < 0
+            && errno != EAGAIN && errno != ENOBUFS) {
+            VLOG_WARN_RL(&rl, "error flushing TX ring on %s: %s",
+                         netdev->name, strerror(errno));
+        }
+    }
+#endif
+#ifdef HAVE_SENDMMSG
+    if (netdev->txq) {
+        error = txq_flush(netdev);
+    }
+#endif
+    if (drops) {
+        *drops = netdev->send_drops;
+        memset(&netdev->send_drops, 0, sizeof netdev->send_drops);
+    }
+    return error;
+}
+
 /* Attempts to receive a packet from 'netdev' into 'buffer', which the caller
  * must have initialized with sufficient room for the packet.  The space
  * required to receive any packet is ETH_HEADER_LEN bytes, plus VLAN_HEADER_LEN
@@ -881,6 +1399,10 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer)
     assert(buffer->size == 0);
     assert(ofpbuf_tailroom(buffer) >= ETH_TOTAL_MIN);
 
+    if (netdev->ring) {
+        return ring_recv_copy(netdev, buffer);
+    }
+
     /* prepare to call recvfrom */
     memset(&sll,0,sizeof sll);
     sll_len = sizeof sll;
@@ -907,9 +1429,10 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer)
         return errno;
     } else {
         /* we have multiple raw sockets at the same interface, so we also
-         * receive what others send, and need to filter them out.
-         * TODO(yiannisy): can we install this as a BPF at kernel? */
+         * receive what others send, and need to filter them out.  Normally
+         * filter_outgoing() has the kernel do this for us. */
         if (sll.sll_pkttype == PACKET_OUTGOING) {
+            netdev->n_outgoing_dropped++;
             return EAGAIN;
         }
 
@@ -926,14 +1449,139 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer)
     }
 }
 
+/* Maximum number of packets that netdev_recv_batch() receives with a single
+ * system call. */
+#define NETDEV_RECV_BATCH 64
+
+static int
+netdev_recv_batch_fallback(struct netdev *netdev, struct ofpbuf *buffers[],
+                           size_t n, size_t *n_recvp)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        int error = netdev_recv(netdev, buffers[i]);
+        if (error) {
+            *n_recvp = i;
+            return i ? 0 : error;
+        }
+    }
+    *n_recvp = n;
+    return 0;
+}
+
+/* Attempts to receive up to 'n' packets from 'netdev' into 'buffers', each of
+ * which the caller must have initialized as for netdev_recv().  Where the
+ * system supports it, packets are received with a single recvmmsg() call.
+ *
+ * If at least one packet is received, returns 0 and stores the number of
+ * packets received in '*n_recvp'.  The buffers that received packets are
+ * moved to the front of 'buffers', in the order that the packets arrived;
+ * the remaining buffers are untouched.  Otherwise, returns a positive errno
+ * value, which is EAGAIN if no packet is ready to be received. */
+int
+netdev_recv_batch(struct netdev *netdev, struct ofpbuf *buffers[], size_t n,
+                  size_t *n_recvp)
+{
+#ifdef HAVE_RECVMMSG
+    struct sockaddr_ll slls[NETDEV_RECV_BATCH];
+    struct mmsghdr msgs[NETDEV_RECV_BATCH];
+    struct iovec iovs[NETDEV_RECV_BATCH];
+    size_t n_recv;
+    int retval;
+    int i;
+
+    *n_recvp = 0;
+    if (!strncmp(netdev->name, "tap", 3) || netdev->ring) {
+        /* recvmmsg() only works on sockets, and does not use the ring. */
+        return netdev_recv_batch_fallback(netdev, buffers, n, n_recvp);
+    }
+
+    n = MIN(n, NETDEV_RECV_BATCH);
+    for (i = 0; i < n; i++) {
+        struct ofpbuf *b = buffers[i];
+
+        assert(b->size == 0);
+        assert(ofpbuf_tailroom(b) >= ETH_TOTAL_MIN);
+
+        iovs[i].iov_base = ofpbuf_tail(b);
+        iovs[i].iov_len = ofpbuf_tailroom(b);
+        memset(&msgs[i].msg_hdr, 0, sizeof msgs[i].msg_hdr);
+        msgs[i].msg_hdr.msg_name = &slls[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof slls[i];
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    do {
+        retval = recvmmsg(netdev->tap_fd, msgs, n, MSG_DONTWAIT, NULL);
+    } while (retval < 0 && errno == EINTR);
+    if (retval < 0) {
+        if (errno == ENOSYS) {
+            return netdev_recv_batch_fallback(netdev, buffers, n, n_recvp);
+        } else if (errno != EAGAIN) {
+            VLOG_WARN_RL(&rl, "error receiving Ethernet packets on %s: %s",
+                         netdev->name, strerror(errno));
+        }
+        return errno;
+    }
+
+    n_recv = 0;
+    for (i = 0; i < retval; i++) {
+        struct ofpbuf *b = buffers[i];
+
+        /* Drop our own transmissions, as in netdev_recv(). */
+        if (slls[i].sll_pkttype == PACKET_OUTGOING) {
+            netdev->n_outgoing_dropped++;
+            continue;
+        }
+
+        b->size += msgs[i].msg_len;
+        pad_to_minimum_length(b);
+        buffers[i] = buffers[n_recv];
+        buffers[n_recv++] = b;
+    }
+    *n_recvp = n_recv;
+    return n_recv ? 0 : EAGAIN;
+#else
+    return netdev_recv_batch_fallback(netdev, buffers, n, n_recvp);
+#endif
+}
+
 /* Registers with the poll loop to wake up from the next call to poll_block()
  * when a packet is ready to be received with netdev_recv() on 'netdev'. */
 void
 netdev_recv_wait(struct netdev *netdev)
 {
+#ifdef TPACKET3_HDRLEN
+    if (netdev->ring && netdev->ring->rx_left) {
+        /* The rest of a block that we already have is ready. */
+        poll_immediate_wake();
+        return;
+    }
+#endif
     poll_fd_wait(netdev->tap_fd, POLLIN);
 }
 
+/* Like netdev_recv_wait(), for a caller that calls poll() itself instead of
+ * using the poll loop (which may be used only by the main thread).  Fills in
+ * 'pfd' to wait for a packet to be ready to be received from 'netdev'.
+ * Returns true if a packet might be ready already, in which case the caller
+ * should not block. */
+bool
+netdev_recv_pollfd(const struct netdev *netdev, struct pollfd *pfd)
+{
+    pfd->fd = netdev->tap_fd;
+    pfd->events = POLLIN;
+    pfd->revents = 0;
+#ifdef TPACKET3_HDRLEN
+    if (netdev->ring && netdev->ring->rx_left) {
+        return true;
+    }
+#endif
+    return false;
+}
+
 /* Discards all packets waiting to be received from 'netdev'. */
 int
 netdev_drain(struct netdev *netdev)
@@ -941,34 +1589,31 @@ netdev_drain(struct netdev *netdev)
     if (netdev->tap_fd != netdev->netdev_fd) {
         drain_fd(netdev->tap_fd, netdev->txqlen);
         return 0;
+    } else if (netdev->ring) {
+        struct ofpbuf *b;
+        size_t n;
+
+        while (!netdev_recv_ring(netdev, &b, 1, &n)) {
+            ofpbuf_delete(b);
+            netdev_release_ring(netdev);
+        }
+        return 0;
     } else {
         return drain_rcvbuf(netdev->netdev_fd);
     }
 }
 
-/* Sends 'buffer' on 'netdev'.  Returns 0 if successful, otherwise a positive
- * errno value.  Returns EAGAIN without blocking if the packet cannot be queued
- * immediately.  Returns EMSGSIZE if a partial packet was transmitted or if
- * the packet is too big or too small to transmit on the device.
- *
- * class_id denotes the queue to send the packet. If 0, it goes to the
- * default,best-effort queue.
- *
- * The caller retains ownership of 'buffer' in all cases.
- *
- * The kernel maintains a packet transmission queue, so the caller is not
- * expected to do additional queuing of packets.
- */
-int
-netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
-            uint16_t class_id)
+/* Transmits the 'size' bytes at 'data' on 'netdev''s queue 'class_id' with a
+ * single system call.  Returns 0 if successful, otherwise a positive errno
+ * value, as described for netdev_send(). */
+static int
+send_packet(struct netdev *netdev, uint16_t class_id,
+            const void *data, size_t size)
 {
     ssize_t n_bytes;
 
-    assert(class_id <= NETDEV_MAX_QUEUES);
-
     do {
-        n_bytes = write(netdev->queue_fd[class_id], buffer->data, buffer->size);
+        n_bytes = write(netdev->queue_fd[class_id], data, size);
     } while (n_bytes < 0 && errno == EINTR);
 
     if (n_bytes < 0) {
@@ -982,26 +1627,221 @@ netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
                          netdev->name, strerror(errno));
         }
         return errno;
-    } else if (n_bytes != buffer->size) {
+    } else if (n_bytes != size) {
         VLOG_WARN_RL(&rl,
                      "send partial Ethernet packet (%d bytes of %zu) on %s",
-                     (int) n_bytes, buffer->size, netdev->name);
+                     (int) n_bytes, size, netdev->name);
         return EMSGSIZE;
     } else {
+        if (class_id && netdev->filtering) {
+            netdev->n_outgoing_filtered++;
+        }
         return 0;
     }
 }
 
+#ifdef HAVE_SENDMMSG
+/* Maximum number of packets that netdev_send() queues before transmitting
+ * them with a single sendmmsg() call. */
+#define NETDEV_SEND_BATCH 32
+
+/* Largest packet that netdev_send() queues.  Bigger packets are transmitted
+ * immediately, after any that are already queued. */
+#define NETDEV_SEND_SLOT 2048
+
+/* Packets queued by netdev_send() on a device, oldest first.  Each queued
+ * packet has a slot of its own in 'slots', which it keeps until it is sent,
+ * so that partially sending the queue does not require copying packets. */
+struct netdev_txq {
+    size_t n;                   /* Number of packets in 'pkts'. */
+    struct netdev_txq_pkt {
+        char *data;             /* One of the 'slots'. */
+        size_t size;            /* Packet size in bytes. */
+        uint16_t class_id;      /* Queue to transmit on. */
+    } pkts[NETDEV_SEND_BATCH];
+    char slots[NETDEV_SEND_BATCH][NETDEV_SEND_SLOT];
+};
+
+/* Removes the first 'n' packets from 'q', moving their slots to the end so
+ * that they can be reused. */
+static void
+txq_pop(struct netdev_txq *q, size_t n)
+{
+    struct netdev_txq_pkt sent[NETDEV_SEND_BATCH];
+
+    memcpy(sent, q->pkts, n * sizeof *sent);
+    memmove(q->pkts, &q->pkts[n], (q->n - n) * sizeof *q->pkts);
+    memcpy(&q->pkts[q->n - n], sent, n * sizeof *sent);
+    q->n -= n;
+}
+
+/* Transmits as many packets from 'netdev''s TX queue as the kernel will
+ * accept, with one sendmmsg() call for each run of packets destined to the
+ * same queue socket.  Packets are dropped only on hard errors, which are
+ * logged and counted in 'send_drops'; when the kernel is out of room, the
+ * rest stay queued.  Returns 0 if the queue is now empty, otherwise
+ * EAGAIN. */
+static int
+txq_flush(struct netdev *netdev)
+{
+    struct netdev_txq *q = netdev->txq;
+    size_t n_done = 0;
+
+    while (n_done < q->n) {
+        struct mmsghdr msgs[NETDEV_SEND_BATCH];
+        struct iovec iovs[NETDEV_SEND_BATCH];
+        uint16_t class_id = q->pkts[n_done].class_id;
+        size_t n = 0;
+        int retval;
+
+        for (; n_done + n < q->n && q->pkts[n_done + n].class_id == class_id;
+             n++) {
+            const struct netdev_txq_pkt *pkt = &q->pkts[n_done + n];
+
+            iovs[n].iov_base = pkt->data;
+            iovs[n].iov_len = pkt->size;
+            memset(&msgs[n].msg_hdr, 0, sizeof msgs[n].msg_hdr);
+            msgs[n].msg_hdr.msg_iov = &iovs[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+        }
+
+        do {
+            retval = sendmmsg(netdev->queue_fd[class_id], msgs, n,
+                              MSG_DONTWAIT);
+        } while (retval < 0 && errno == EINTR);
+
+        if (retval < 0) {
+            const struct netdev_txq_pkt *pkt = &q->pkts[n_done];
+            int error = errno;
+
+            if (error == ENOSYS) {
+                error = send_packet(netdev, class_id, pkt->data, pkt->size);
+            } else if (error == ENOBUFS) {
+                error = EAGAIN;
+            } else if (error != EAGAIN) {
+                VLOG_WARN_RL(&rl, "error sending Ethernet packet on %s: %s",
+                             netdev->name, strerror(error));
+            }
+            if (error == EAGAIN) {
+                break;
+            } else if (error) {
+                netdev->send_drops.n_packets++;
+                netdev->send_drops.n_bytes += pkt->size;
+            }
+            retval = 1;         /* Sent or dropped. */
+        } else if (class_id && netdev->filtering) {
+            netdev->n_outgoing_filtered += retval;
+        }
+        n_done += retval;
+    }
+    txq_pop(q, n_done);
+    return q->n ? EAGAIN : 0;
+}
+
+/* Queues 'buffer' for transmission on 'netdev''s queue 'class_id', as
+ * described for netdev_send(). */
+static int
+txq_send(struct netdev *netdev, const struct ofpbuf *buffer,
+         uint16_t class_id)
+{
+    struct netdev_txq *q = netdev->txq;
+    struct netdev_txq_pkt *pkt;
+
+    if (buffer->size > NETDEV_SEND_SLOT) {
+        if (q && netdev_send_flush(netdev, NULL)) {
+            return EAGAIN;
+        }
+        return send_packet(netdev, class_id, buffer->data, buffer->size);
+    }
+
+    if (!q) {
+        size_t i;
+
+        q = netdev->txq = xmalloc(sizeof *q);
+        q->n = 0;
+        for (i = 0; i < NETDEV_SEND_BATCH; i++) {
+            q->pkts[i].data = q->slots[i];
+        }
+    } else if (q->n >= NETDEV_SEND_BATCH && txq_flush(netdev)
+               && q->n >= NETDEV_SEND_BATCH) {
+        return EAGAIN;
+    }
+
+    pkt = &q->pkts[q->n++];
+    memcpy(pkt->data, buffer->data, buffer->size);
+    pkt->size = buffer->size;
+    pkt->class_id = class_id;
+    if (q->n >= NETDEV_SEND_BATCH) {
+        txq_flush(netdev);
+    }
+    return 0;
+}
+#endif  /* HAVE_SENDMMSG */
+
+/* Sends 'buffer' on 'netdev'.  Returns 0 if successful, otherwise a positive
+ * errno value.  Returns EAGAIN without blocking if the packet cannot be queued
+ * immediately.  Returns EMSGSIZE if a partial packet was transmitted or if
+ * the packet is too big or too small to transmit on the device.
+ *
+ * class_id denotes the queue to send the packet. If 0, it goes to the
+ * default,best-effort queue.
+ *
+ * The caller retains ownership of 'buffer' in all cases.
+ *
+ * Packets sent on a device with a TX ring, or on an ordinary network device
+ * on a system with sendmmsg(), are copied into a queue and handed to the
+ * kernel in batches: when the queue fills up, or on a call to
+ * netdev_send_flush(), which the caller must make after each batch of
+ * packets.  Errors that occur at that point are logged rather than
+ * returned, and netdev_send_flush() reports the packets that they dropped.
+ */
+int
+netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
+            uint16_t class_id)
+{
+    assert(class_id <= NETDEV_MAX_QUEUES);
+
+#ifdef TPACKET3_HDRLEN
+    if (!class_id && netdev->ring && netdev->ring->tx_map) {
+        return ring_send(netdev, buffer);
+    }
+#endif
+#ifdef HAVE_SENDMMSG
+    if (netdev->tap_fd == netdev->netdev_fd) {
+        return txq_send(netdev, buffer, class_id);
+    }
+#endif
+    return send_packet(netdev, class_id, buffer->data, buffer->size);
+}
+
+/* Stores in '*filtered' the number of copies of packets transmitted on
+ * 'netdev' through its queue sockets that the kernel kept from being received
+ * by 'netdev' itself, and in '*dropped' the number of packets received on
+ * 'netdev' that had to be discarded in userspace because they were outgoing
+ * packets.  Without kernel filtering, the former would show up in the
+ * latter. */
+void
+netdev_get_outgoing_stats(const struct netdev *netdev,
+                          unsigned long long *filtered,
+                          unsigned long long *dropped)
+{
+    *filtered = netdev->n_outgoing_filtered;
+    *dropped = netdev->n_outgoing_dropped;
+}
+
 /* Registers with the poll loop to wake up from the next call to poll_block()
  * when the packet transmission queue has sufficient room to transmit a packet
- * with netdev_send().
- *
- * The kernel maintains a packet transmission queue, so the client is not
- * expected to do additional queuing of packets.  Thus, this function is
- * unlikely to ever be used.  It is included for completeness. */
+ * with netdev_send(), or, if netdev_send_flush() left packets queued, to
+ * transmit the first of them. */
 void
 netdev_send_wait(struct netdev *netdev)
 {
+#ifdef HAVE_SENDMMSG
+    if (netdev->txq && netdev->txq->n) {
+        poll_fd_wait(netdev->queue_fd[netdev->txq->pkts[0].class_id], POLLOUT);
+        return;
+    }
+#endif
     if (netdev->tap_fd == netdev->netdev_fd) {
         poll_fd_wait(netdev->tap_fd, POLLOUT);
     } else {
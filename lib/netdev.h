@@ -47,6 +47,7 @@
 struct ofpbuf;
 struct in_addr;
 struct in6_addr;
+struct pollfd;
 struct svec;
 
 enum netdev_feature_type {
@@ -70,17 +71,38 @@ enum netdev_pseudo_ethertype {
 
 #define NETDEV_MAX_QUEUES 8
 
+/* Minimum headroom in front of packets received by netdev_recv_ring(). */
+#define NETDEV_RING_HEADROOM 128
+
 struct netdev;
 
+/* Packets that netdev_send() accepted but that could not be transmitted when
+ * they were later handed to the kernel. */
+struct netdev_send_drops {
+    unsigned long long n_packets;
+    unsigned long long n_bytes;
+};
+
 int netdev_open(const char *name, int ethertype, struct netdev **);
 int netdev_open_tap(const char *name, struct netdev **);
 void netdev_close(struct netdev *);
 
 int netdev_recv(struct netdev *, struct ofpbuf *);
+int netdev_recv_batch(struct netdev *, struct ofpbuf *buffers[], size_t n,
+                      size_t *n_recvp);
+bool netdev_has_ring(const struct netdev *);
+int netdev_recv_ring(struct netdev *, struct ofpbuf *buffers[], size_t n,
+                     size_t *n_recvp);
+void netdev_release_ring(struct netdev *);
 void netdev_recv_wait(struct netdev *);
+bool netdev_recv_pollfd(const struct netdev *, struct pollfd *);
 int netdev_drain(struct netdev *);
 int netdev_send(struct netdev *, const struct ofpbuf *, uint16_t class_id);
+int netdev_send_flush(struct netdev *, struct netdev_send_drops *);
 void netdev_send_wait(struct netdev *);
+void netdev_get_outgoing_stats(const struct netdev *,
+                               unsigned long long *filtered,
+                               unsigned long long *dropped);
 int netdev_set_etheraddr(struct netdev *, const uint8_t mac[6]);
 const uint8_t *netdev_get_etheraddr(const struct netdev *);
 const char *netdev_get_name(const struct netdev *);
@@ -204,6 +204,7 @@ void
 nl_sock_destroy(struct nl_sock *sock) 
 {
     if (sock) {
+        poll_fd_forget(sock->fd);
         close(sock->fd);
         free_pid(sock->pid);
         free(sock);
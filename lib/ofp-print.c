@@ -35,10 +35,8 @@
 #include "ofp-print.h"
 #include "xtoxll.h"
 
-#include <errno.h>
 #include <inttypes.h>
 #include <netinet/in.h>
-#include <sys/wait.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -49,70 +47,389 @@
 #include "ofpbuf.h"
 #include "openflow/openflow.h"
 #include "openflow/nicira-ext.h"
+#include "openflow/openflow-ext.h"
 #include "packets.h"
-#include "pcap.h"
+#include "stp.h"
 #include "util.h"
 
 static void ofp_print_port_name(struct ds *string, uint16_t port);
 static void ofp_print_match(struct ds *, const struct ofp_match *,
                             int verbosity);
 
-/* Returns a string that represents the contents of the Ethernet frame in the
- * 'len' bytes starting at 'data' to 'stream' as output by tcpdump.
- * 'total_len' specifies the full length of the Ethernet frame (of which 'len'
- * bytes were captured).
- *
- * The caller must free the returned string.
- *
- * This starts and kills a tcpdump subprocess so it's quite expensive. */
-char *
-ofp_packet_to_string(const void *data, size_t len, size_t total_len UNUSED)
+static const char *
+eth_type_name(uint16_t eth_type)
 {
-    struct ds ds = DS_EMPTY_INITIALIZER;
-    struct ofpbuf buf;
+    switch (eth_type) {
+    case ETH_TYPE_IP:
+        return "IPv4";
+    case ETH_TYPE_ARP:
+        return "ARP";
+    case ETH_TYPE_VLAN:
+        return "802.1Q";
+    case ETH_TYPE_LLDP:
+        return "LLDP";
+    case 0x86dd:
+        return "IPv6";
+    default:
+        return NULL;
+    }
+}
 
-    char command[128];
-    FILE *pcap;
-    FILE *tcpdump;
-    int status;
-    int c;
+static void
+print_eth_type(struct ds *string, uint16_t eth_type)
+{
+    const char *name = eth_type_name(eth_type);
+    if (name) {
+        ds_put_format(string, "ethertype %s (0x%04"PRIx16")", name, eth_type);
+    } else {
+        ds_put_format(string, "ethertype 0x%04"PRIx16, eth_type);
+    }
+}
 
-    buf.data = (void *) data;
-    buf.size = len;
+static void
+print_stp_id(struct ds *string, uint64_t id)
+{
+    int i;
 
-    pcap = tmpfile();
-    if (!pcap) {
-        ofp_error(errno, "tmpfile");
-        return xstrdup("<error>");
+    ds_put_format(string, "%04"PRIx16".", (uint16_t) (id >> 48));
+    for (i = 5; i >= 0; i--) {
+        ds_put_format(string, "%02"PRIx8"%s",
+                      (uint8_t) (id >> (i * 8)), i ? ":" : "");
     }
-    pcap_write_header(pcap);
-    pcap_write(pcap, &buf);
-    fflush(pcap);
-    if (ferror(pcap)) {
-        ofp_error(errno, "error writing temporary file");
+}
+
+/* Appends to 'string' a summary of the 'len'-byte BPDU at 'data'. */
+static void
+print_stp(struct ds *string, const uint8_t *data, size_t len)
+{
+    const struct stp_bpdu_header *hdr = (const struct stp_bpdu_header *) data;
+
+    if (len < sizeof *hdr) {
+        ds_put_cstr(string, "[|stp]");
+    } else if (hdr->protocol_id != htons(STP_PROTOCOL_ID)
+               || hdr->protocol_version != STP_PROTOCOL_VERSION) {
+        ds_put_format(string, "STP, protocol 0x%04"PRIx16", version %"PRIu8,
+                      ntohs(hdr->protocol_id), hdr->protocol_version);
+    } else if (hdr->bpdu_type == STP_TYPE_TCN) {
+        ds_put_cstr(string, "STP 802.1d, Topology Change");
+    } else if (hdr->bpdu_type != STP_TYPE_CONFIG) {
+        ds_put_format(string, "STP 802.1d, type 0x%02"PRIx8, hdr->bpdu_type);
+    } else if (len < sizeof(struct stp_config_bpdu)) {
+        ds_put_cstr(string, "STP 802.1d, Config [|stp]");
+    } else {
+        const struct stp_config_bpdu *config
+            = (const struct stp_config_bpdu *) data;
+
+        ds_put_cstr(string, "STP 802.1d, Config, Flags [");
+        if (config->flags & STP_CONFIG_TOPOLOGY_CHANGE) {
+            ds_put_cstr(string, "Topology change");
+            if (config->flags & STP_CONFIG_TOPOLOGY_CHANGE_ACK) {
+                ds_put_cstr(string, ", ");
+            }
+        }
+        if (config->flags & STP_CONFIG_TOPOLOGY_CHANGE_ACK) {
+            ds_put_cstr(string, "Topology change ACK");
+        }
+        if (!(config->flags & (STP_CONFIG_TOPOLOGY_CHANGE
+                               | STP_CONFIG_TOPOLOGY_CHANGE_ACK))) {
+            ds_put_cstr(string, "none");
+        }
+        ds_put_cstr(string, "], bridge-id ");
+        print_stp_id(string, ntohll(config->bridge_id));
+        ds_put_format(string, ".%04"PRIx16", root-id ",
+                      ntohs(config->port_id));
+        print_stp_id(string, ntohll(config->root_id));
+        ds_put_format(string, ", root-pathcost %"PRIu32", message-age %.2fs, "
+                      "max-age %.2fs, hello-time %.2fs, "
+                      "forwarding-delay %.2fs",
+                      ntohl(config->root_path_cost),
+                      ntohs(config->message_age) / 256.0,
+                      ntohs(config->max_age) / 256.0,
+                      ntohs(config->hello_time) / 256.0,
+                      ntohs(config->forward_delay) / 256.0);
     }
-    rewind(pcap);
+}
+
+/* Appends to 'string' the 'len'-byte LLDP ID at 'data', which is an Ethernet
+ * address if 'is_mac' is true. */
+static void
+print_lldp_id(struct ds *string, const uint8_t *data, size_t len,
+              bool is_mac)
+{
+    size_t i;
 
-    snprintf(command, sizeof command, "/usr/sbin/tcpdump -e -n -r /dev/fd/%d 2>/dev/null",
-             fileno(pcap));
-    tcpdump = popen(command, "r");
-    fclose(pcap);
-    if (!tcpdump) {
-        ofp_error(errno, "exec(\"%s\")", command);
-        return xstrdup("<error>");
+    if (is_mac && len == ETH_ADDR_LEN) {
+        ds_put_format(string, ETH_ADDR_FMT, ETH_ADDR_ARGS(data));
+        return;
+    }
+    for (i = 0; i < len; i++) {
+        if (!isprint(data[i])) {
+            for (i = 0; i < len; i++) {
+                ds_put_format(string, "%02"PRIx8, data[i]);
+            }
+            return;
+        }
     }
+    ds_put_format(string, "\"%.*s\"", (int) len, data);
+}
 
-    while ((c = getc(tcpdump)) != EOF) {
-        ds_put_char(&ds, c);
+/* Appends to 'string' a summary of the 'len'-byte LLDPDU at 'data'. */
+static void
+print_lldp(struct ds *string, const uint8_t *data, size_t len)
+{
+    ds_put_cstr(string, "LLDP");
+    while (len >= LLDP_TLV_HEADER_LEN) {
+        uint16_t hdr = (data[0] << 8) | data[1];
+        unsigned int type = LLDP_TLV_TYPE(hdr);
+        size_t tlv_len = LLDP_TLV_LEN(hdr);
+        const uint8_t *value = data + LLDP_TLV_HEADER_LEN;
+
+        if (type == LLDP_TLV_END) {
+            return;
+        } else if (len - LLDP_TLV_HEADER_LEN < tlv_len) {
+            break;
+        }
+
+        if ((type == LLDP_TLV_CHASSIS_ID || type == LLDP_TLV_PORT_ID)
+            && tlv_len > 1) {
+            bool is_mac = value[0] == (type == LLDP_TLV_CHASSIS_ID
+                                       ? LLDP_CHASSIS_ID_MAC
+                                       : LLDP_PORT_ID_MAC);
+            ds_put_format(string, ", %s id ",
+                          type == LLDP_TLV_CHASSIS_ID ? "chassis" : "port");
+            print_lldp_id(string, value + 1, tlv_len - 1, is_mac);
+        } else if (type == LLDP_TLV_TTL && tlv_len == 2) {
+            ds_put_format(string, ", ttl %d", (value[0] << 8) | value[1]);
+        } else if (type == LLDP_TLV_PORT_DESC
+                   || type == LLDP_TLV_SYSTEM_NAME) {
+            ds_put_format(string, ", %s ", (type == LLDP_TLV_PORT_DESC
+                                            ? "port description"
+                                            : "system name"));
+            print_lldp_id(string, value, tlv_len, false);
+        } else {
+            ds_put_format(string, ", tlv %u (%zu bytes)", type, tlv_len);
+        }
+
+        data += LLDP_TLV_HEADER_LEN + tlv_len;
+        len -= LLDP_TLV_HEADER_LEN + tlv_len;
+    }
+    ds_put_cstr(string, " [|lldp]");
+}
+
+static void
+print_arp(struct ds *string, const struct ofpbuf *packet)
+{
+    const struct arp_eth_header *arp = packet->l3;
+    size_t len = (uint8_t *) packet->data + packet->size - (uint8_t *) arp;
+
+    if (len < ARP_ETH_HEADER_LEN) {
+        ds_put_cstr(string, "[|arp]");
+        return;
+    }
+    if (arp->ar_hrd != htons(ARP_HRD_ETHERNET)
+        || arp->ar_pro != htons(ARP_PRO_IP)
+        || arp->ar_hln != ETH_ADDR_LEN || arp->ar_pln != IP_ADDR_LEN) {
+        ds_put_format(string, "ARP, hardware %"PRIu16", protocol 0x%04"PRIx16
+                      ", op %"PRIu16, ntohs(arp->ar_hrd), ntohs(arp->ar_pro),
+                      ntohs(arp->ar_op));
+    } else if (arp->ar_op == htons(ARP_OP_REQUEST)) {
+        ds_put_format(string, "Request who-has "IP_FMT" tell "IP_FMT,
+                      IP_ARGS(&arp->ar_tpa), IP_ARGS(&arp->ar_spa));
+    } else if (arp->ar_op == htons(ARP_OP_REPLY)) {
+        ds_put_format(string, "Reply "IP_FMT" is-at "ETH_ADDR_FMT,
+                      IP_ARGS(&arp->ar_spa), ETH_ADDR_ARGS(arp->ar_sha));
+    } else {
+        ds_put_format(string, "ARP, op %"PRIu16" "IP_FMT" > "IP_FMT,
+                      ntohs(arp->ar_op),
+                      IP_ARGS(&arp->ar_spa), IP_ARGS(&arp->ar_tpa));
+    }
+    ds_put_format(string, ", length %zu", len);
+}
+
+static void
+print_tcp_flags(struct ds *string, uint8_t flags)
+{
+    ds_put_cstr(string, "Flags [");
+    if (flags & TCP_FIN) {
+        ds_put_char(string, 'F');
+    }
+    if (flags & TCP_SYN) {
+        ds_put_char(string, 'S');
     }
+    if (flags & TCP_RST) {
+        ds_put_char(string, 'R');
+    }
+    if (flags & TCP_PSH) {
+        ds_put_char(string, 'P');
+    }
+    if (flags & TCP_URG) {
+        ds_put_char(string, 'U');
+    }
+    if (flags & TCP_ACK) {
+        ds_put_char(string, '.');
+    }
+    if (!flags) {
+        ds_put_cstr(string, "none");
+    }
+    ds_put_char(string, ']');
+}
+
+/* Appends to 'string' a summary of the IPv4 packet in 'packet', whose flow
+ * 'flow' was extracted by flow_extract(), which reported it as a fragment if
+ * 'is_fragment' is true. */
+static void
+print_ip(struct ds *string, const struct ofpbuf *packet,
+         const struct flow *flow, bool is_fragment)
+{
+    const struct ip_header *ip = packet->l3;
+    const uint8_t *end = (uint8_t *) packet->data + packet->size;
+    size_t ip_len, l4_len;
 
-    status = pclose(tcpdump);
-    if (WIFEXITED(status)) {
-        if (WEXITSTATUS(status))
-            ofp_error(0, "tcpdump exited with status %d", WEXITSTATUS(status));
-    } else if (WIFSIGNALED(status)) {
-        ofp_error(0, "tcpdump exited with signal %d", WTERMSIG(status)); 
+    if (!packet->l4) {
+        ds_put_cstr(string, "[|ip]");
+        return;
+    }
+    ip_len = ntohs(ip->ip_tot_len);
+    l4_len = ip_len - MIN(ip_len, (uint8_t *) packet->l4 - (uint8_t *) ip);
+
+    if (is_fragment) {
+        uint16_t frag_off = ntohs(ip->ip_frag_off);
+        ds_put_format(string, IP_FMT" > "IP_FMT": ip-proto-%"PRIu8" "
+                      "(frag %"PRIu16":%zu@%d%s)",
+                      IP_ARGS(&ip->ip_src), IP_ARGS(&ip->ip_dst),
+                      ip->ip_proto, ntohs(ip->ip_id), l4_len,
+                      (frag_off & IP_FRAG_OFF_MASK) * 8,
+                      frag_off & IP_MORE_FRAGMENTS ? "+" : "");
+    } else if (flow->nw_proto == IP_TYPE_TCP) {
+        const struct tcp_header *tcp = packet->l4;
+        size_t data_len = ip_len - MIN(ip_len, ((uint8_t *) packet->l7
+                                                - (uint8_t *) ip));
+        ds_put_format(string, IP_FMT".%"PRIu16" > "IP_FMT".%"PRIu16": ",
+                      IP_ARGS(&ip->ip_src), ntohs(tcp->tcp_src),
+                      IP_ARGS(&ip->ip_dst), ntohs(tcp->tcp_dst));
+        print_tcp_flags(string, TCP_FLAGS(tcp->tcp_ctl));
+        ds_put_format(string, ", seq %"PRIu32, ntohl(tcp->tcp_seq));
+        if (TCP_FLAGS(tcp->tcp_ctl) & TCP_ACK) {
+            ds_put_format(string, ", ack %"PRIu32, ntohl(tcp->tcp_ack));
+        }
+        ds_put_format(string, ", win %"PRIu16", length %zu",
+                      ntohs(tcp->tcp_winsz), data_len);
+    } else if (flow->nw_proto == IP_TYPE_UDP) {
+        const struct udp_header *udp = packet->l4;
+        ds_put_format(string, IP_FMT".%"PRIu16" > "IP_FMT".%"PRIu16": "
+                      "UDP, length %d",
+                      IP_ARGS(&ip->ip_src), ntohs(udp->udp_src),
+                      IP_ARGS(&ip->ip_dst), ntohs(udp->udp_dst),
+                      ntohs(udp->udp_len) - UDP_HEADER_LEN);
+    } else if (flow->nw_proto == IP_TYPE_ICMP) {
+        const struct icmp_header *icmp = packet->l4;
+        const uint8_t *rest = packet->l7;
+
+        ds_put_format(string, IP_FMT" > "IP_FMT": ICMP ",
+                      IP_ARGS(&ip->ip_src), IP_ARGS(&ip->ip_dst));
+        if ((icmp->icmp_type == 0 || icmp->icmp_type == 8)
+            && end - rest >= 4) {
+            ds_put_format(string, "echo %s, id %d, seq %d",
+                          icmp->icmp_type ? "request" : "reply",
+                          (rest[0] << 8) | rest[1], (rest[2] << 8) | rest[3]);
+        } else {
+            ds_put_format(string, "type %"PRIu8", code %"PRIu8,
+                          icmp->icmp_type, icmp->icmp_code);
+        }
+        ds_put_format(string, ", length %zu", l4_len);
+    } else if (flow->nw_proto != ip->ip_proto) {
+        /* flow_extract() found the transport header truncated. */
+        ds_put_format(string, IP_FMT" > "IP_FMT": [|ip-proto-%"PRIu8"]",
+                      IP_ARGS(&ip->ip_src), IP_ARGS(&ip->ip_dst),
+                      ip->ip_proto);
+    } else {
+        ds_put_format(string, IP_FMT" > "IP_FMT": ip-proto-%"PRIu8" %zu",
+                      IP_ARGS(&ip->ip_src), IP_ARGS(&ip->ip_dst),
+                      ip->ip_proto, l4_len);
     }
+}
+
+/* Returns a string that summarizes the contents of the Ethernet frame in the
+ * 'len' bytes starting at 'data', in a format similar to "tcpdump -e -n".
+ * 'total_len' specifies the full length of the Ethernet frame (of which 'len'
+ * bytes were captured).
+ *
+ * The packet is decoded in-process with flow_extract(), so this is cheap
+ * enough to use on every packet.  It understands Ethernet II and 802.2
+ * framing, VLAN tags, ARP, IPv4 with TCP, UDP, and ICMP, STP, and LLDP.
+ *
+ * The caller must free the returned string. */
+char *
+ofp_packet_to_string(const void *data, size_t len, size_t total_len)
+{
+    struct ds ds = DS_EMPTY_INITIALIZER;
+    const struct eth_header *eth = data;
+    struct ofpbuf packet;
+    struct flow flow;
+    bool is_fragment;
+    size_t l3_len;
+
+    packet.data = (void *) data;
+    packet.size = len;
+    is_fragment = flow_extract(&packet, 0, &flow);
+
+    if (len < ETH_HEADER_LEN) {
+        ds_put_format(&ds, "[|ether], length %zu\n", total_len);
+        return ds_cstr(&ds);
+    }
+    ds_put_format(&ds, ETH_ADDR_FMT" > "ETH_ADDR_FMT", ",
+                  ETH_ADDR_ARGS(eth->eth_src), ETH_ADDR_ARGS(eth->eth_dst));
+
+    if (ntohs(eth->eth_type) < OFP_DL_TYPE_ETH2_CUTOFF) {
+        const struct llc_header *llc = (const void *) (eth + 1);
+
+        ds_put_format(&ds, "802.3, length %zu: ", total_len);
+        if (!packet.l3) {
+            ds_put_cstr(&ds, "[|llc]\n");
+            return ds_cstr(&ds);
+        }
+        ds_put_format(&ds, "LLC, dsap 0x%02"PRIx8", ssap 0x%02"PRIx8", "
+                      "ctrl 0x%02"PRIx8": ",
+                      llc->llc_dsap, llc->llc_ssap, llc->llc_cntl);
+        if (flow.dl_type == htons(OFP_DL_TYPE_NOT_ETH_TYPE)) {
+            l3_len = (uint8_t *) data + len - (uint8_t *) packet.l3;
+            if (llc->llc_dsap == STP_LLC_DSAP
+                && llc->llc_ssap == STP_LLC_SSAP
+                && llc->llc_cntl == STP_LLC_CNTL) {
+                print_stp(&ds, packet.l3, l3_len);
+            } else {
+                ds_put_format(&ds, "length %zu", l3_len);
+            }
+            ds_put_char(&ds, '\n');
+            return ds_cstr(&ds);
+        }
+        ds_put_cstr(&ds, "SNAP, ");
+    }
+
+    if (flow.dl_vlan != htons(OFP_VLAN_NONE)) {
+        print_eth_type(&ds, ETH_TYPE_VLAN);
+        ds_put_format(&ds, ", length %zu: vlan %"PRIu16", p %"PRIu8", ",
+                      total_len, ntohs(flow.dl_vlan), flow.dl_vlan_pcp);
+        print_eth_type(&ds, ntohs(flow.dl_type));
+        ds_put_cstr(&ds, ", ");
+    } else {
+        print_eth_type(&ds, ntohs(flow.dl_type));
+        ds_put_format(&ds, ", length %zu: ", total_len);
+    }
+
+    l3_len = (uint8_t *) data + len - (uint8_t *) packet.l3;
+    if (flow.dl_type == htons(ETH_TYPE_IP)) {
+        print_ip(&ds, &packet, &flow, is_fragment);
+    } else if (flow.dl_type == htons(ETH_TYPE_ARP)) {
+        print_arp(&ds, &packet);
+    } else if (flow.dl_type == htons(ETH_TYPE_LLDP)) {
+        print_lldp(&ds, packet.l3, l3_len);
+    } else if (flow.dl_type == htons(ETH_TYPE_VLAN)) {
+        ds_put_cstr(&ds, "[|vlan]");
+    } else {
+        ds_put_format(&ds, "length %zu", l3_len);
+    }
+    ds_put_char(&ds, '\n');
     return ds_cstr(&ds);
 }
 
@@ -1168,6 +1485,171 @@ vendor_stat(struct ds *string, const void *body, size_t len,
                   len - sizeof(uint32_t));
 }
 
+static void
+ofp_ext_buffer_stats_reply(struct ds *string, const void *body, size_t len,
+                           int verbosity)
+{
+    const struct ofp_ext_buffer_stats *obs = body;
+
+    if (len != sizeof *obs) {
+        vendor_stat(string, body, len, verbosity);
+        return;
+    }
+    ds_put_format(string, " buffers=%"PRIu32", active=%"PRIu32"\n",
+                  ntohl(obs->n_buffers), ntohl(obs->n_active));
+    ds_put_format(string, "  saved=%"PRIu64", refused=%"PRIu64", "
+                  "expired=%"PRIu64"\n",
+                  ntohll(obs->saved_count), ntohll(obs->refused_count),
+                  ntohll(obs->expired_count));
+    ds_put_format(string, "  hit=%"PRIu64", miss=%"PRIu64", "
+                  "stale=%"PRIu64"\n",
+                  ntohll(obs->hit_count), ntohll(obs->miss_count),
+                  ntohll(obs->stale_count));
+}
+
+static void
+ofp_ext_flow_slab_stats_reply(struct ds *string, const void *body, size_t len,
+                              int verbosity)
+{
+    const struct ofp_ext_flow_slab_stats *ofs = body;
+
+    if (len != sizeof *ofs) {
+        vendor_stat(string, body, len, verbosity);
+        return;
+    }
+    ds_put_format(string, " flows=%"PRIu32", max=%"PRIu32", "
+                  "external actions=%"PRIu32"\n",
+                  ntohl(ofs->n_used), ntohl(ofs->max_used),
+                  ntohl(ofs->n_external));
+    ds_put_format(string, "  slots=%"PRIu32" of %"PRIu32" bytes "
+                  "in %"PRIu32" chunks\n",
+                  ntohl(ofs->n_slots), ntohl(ofs->slot_size),
+                  ntohl(ofs->n_chunks));
+}
+
+static void
+ofp_ext_port_outgoing_stats_reply(struct ds *string, const void *body,
+                                  size_t len, int verbosity)
+{
+    const struct ofp_ext_port_outgoing_stats *pos;
+    size_t n, i;
+
+    if ((len - sizeof(struct ofp_ext_stats_header)) % sizeof *pos) {
+        vendor_stat(string, body, len, verbosity);
+        return;
+    }
+    n = (len - sizeof(struct ofp_ext_stats_header)) / sizeof *pos;
+    pos = (const struct ofp_ext_port_outgoing_stats *)
+        ((const struct ofp_ext_stats_header *) body + 1);
+    ds_put_format(string, " %zu ports\n", n);
+    for (i = 0; i < n; i++, pos++) {
+        ds_put_format(string, "  port %2"PRIu16": outgoing copies "
+                      "filtered=%"PRIu64", dropped=%"PRIu64"\n",
+                      ntohs(pos->port_no), ntohll(pos->filtered_count),
+                      ntohll(pos->dropped_count));
+    }
+}
+
+static void
+ofp_ext_table_hash_stats_reply(struct ds *string, const void *body,
+                               size_t len, int verbosity)
+{
+    const struct ofp_ext_table_hash_stats *ths;
+    size_t n, i;
+
+    if ((len - sizeof(struct ofp_ext_stats_header)) % sizeof *ths) {
+        vendor_stat(string, body, len, verbosity);
+        return;
+    }
+    n = (len - sizeof(struct ofp_ext_stats_header)) / sizeof *ths;
+    ths = (const struct ofp_ext_table_hash_stats *)
+        ((const struct ofp_ext_stats_header *) body + 1);
+    ds_put_format(string, " %zu tables\n", n);
+    for (i = 0; i < n; i++, ths++) {
+        uint64_t lookups = ntohll(ths->lookup_count);
+        uint64_t probes = ntohll(ths->probe_count);
+
+        ds_put_format(string, "  %d: active=%"PRIu32", buckets=%"PRIu32", "
+                      "max chain=%"PRIu32"\n", ths->table_id,
+                      ntohl(ths->active_count), ntohl(ths->n_buckets),
+                      ntohl(ths->max_chain));
+        ds_put_format(string, "     lookup=%"PRIu64", probes=%"PRIu64,
+                      lookups, probes);
+        if (lookups && probes) {
+            ds_put_format(string, " (%.2f per lookup)",
+                          (double) probes / lookups);
+        }
+        ds_put_char(string, '\n');
+    }
+}
+
+static void
+ofp_ext_flow_delta_reply(struct ds *string, const void *body_, size_t len,
+                         int verbosity)
+{
+    const struct ofp_ext_flow_delta_reply *rpy = body_;
+    const struct ofp_ext_flow_delta_removed *removed;
+    size_t n_removed, i;
+
+    if (len < sizeof *rpy) {
+        vendor_stat(string, body_, len, verbosity);
+        return;
+    }
+    n_removed = ntohs(rpy->n_removed);
+    if (len < sizeof *rpy + n_removed * sizeof *removed) {
+        vendor_stat(string, body_, len, verbosity);
+        return;
+    }
+    ds_put_format(string, " generation=%"PRIu32"%s\n",
+                  ntohl(rpy->generation),
+                  ntohs(rpy->flags) & OFP_EXT_FLOW_DELTA_FULL ? " full" : "");
+
+    removed = (const struct ofp_ext_flow_delta_removed *) (rpy + 1);
+    for (i = 0; i < n_removed; i++, removed++) {
+        char *match = ofp_match_to_string(&removed->match, verbosity);
+        ds_put_format(string, "  removed: reason=%"PRIu8", priority=%"PRIu16
+                      ", cookie=0x%"PRIx64", n_packets=%"PRIu64
+                      ", n_bytes=%"PRIu64", %s",
+                      removed->reason, ntohs(removed->priority),
+                      ntohll(removed->cookie), ntohll(removed->packet_count),
+                      ntohll(removed->byte_count), match);
+        ds_chomp(string, ',');
+        ds_put_char(string, '\n');
+        free(match);
+    }
+    ofp_flow_stats_reply(string, removed,
+                         len - sizeof *rpy - n_removed * sizeof *removed,
+                         verbosity);
+}
+
+static void
+vendor_stat_reply(struct ds *string, const void *body, size_t len,
+                  int verbosity)
+{
+    const struct ofp_ext_stats_header *osh = body;
+
+    if (len >= sizeof *osh && ntohl(osh->vendor) == OPENFLOW_VENDOR_ID) {
+        switch (ntohl(osh->subtype)) {
+        case OFP_EXT_STATS_BUFFER:
+            ofp_ext_buffer_stats_reply(string, body, len, verbosity);
+            return;
+        case OFP_EXT_STATS_FLOW_DELTA:
+            ofp_ext_flow_delta_reply(string, body, len, verbosity);
+            return;
+        case OFP_EXT_STATS_FLOW_SLAB:
+            ofp_ext_flow_slab_stats_reply(string, body, len, verbosity);
+            return;
+        case OFP_EXT_STATS_PORT_OUTGOING:
+            ofp_ext_port_outgoing_stats_reply(string, body, len, verbosity);
+            return;
+        case OFP_EXT_STATS_TABLE_HASH:
+            ofp_ext_table_hash_stats_reply(string, body, len, verbosity);
+            return;
+        }
+    }
+    vendor_stat(string, body, len, verbosity);
+}
+
 enum stats_direction {
     REQUEST,
     REPLY
@@ -1236,7 +1718,7 @@ print_stats(struct ds *string, int type, const void *body, size_t body_len,
             OFPST_VENDOR,
             "vendor-specific",
             { sizeof(uint32_t), SIZE_MAX, vendor_stat },
-            { sizeof(uint32_t), SIZE_MAX, vendor_stat },
+            { sizeof(uint32_t), SIZE_MAX, vendor_stat_reply },
         },
         {
             -1,
@@ -1249,15 +1731,15 @@ print_stats(struct ds *string, int type, const void *body, size_t body_len,
     const struct stats_type *s;
     const struct stats_msg *m;
 
-    if (type >= ARRAY_SIZE(stats_types) || !stats_types[type].name) {
-        ds_put_format(string, " ***unknown type %d***", type);
-        return;
-    }
     for (s = stats_types; s->type >= 0; s++) {
         if (s->type == type) {
             break;
         }
     }
+    if (s->type < 0) {
+        ds_put_format(string, " ***unknown type %d***", type);
+        return;
+    }
     ds_put_format(string, " type=%d(%s)\n", type, s->name);
 
     m = direction == REQUEST ? &s->request : &s->reply;
@@ -1628,11 +2110,10 @@ ofp_print(FILE *stream, const void *oh, size_t len, int verbosity)
     print_and_free(stream, ofp_to_string(oh, len, verbosity));
 }
 
-/* Dumps the contents of the Ethernet frame in the 'len' bytes starting at
- * 'data' to 'stream' using tcpdump.  'total_len' specifies the full length of
- * the Ethernet frame (of which 'len' bytes were captured).
- *
- * This starts and kills a tcpdump subprocess so it's quite expensive. */
+/* Dumps a summary of the contents of the Ethernet frame in the 'len' bytes
+ * starting at 'data' to 'stream', as formatted by ofp_packet_to_string().
+ * 'total_len' specifies the full length of the Ethernet frame (of which 'len'
+ * bytes were captured). */
 void
 ofp_print_packet(FILE *stream, const void *data, size_t len, size_t total_len)
 {
@@ -50,12 +50,26 @@ ofpbuf_use(struct ofpbuf *b, void *base, size_t allocated)
 {
     b->base = b->data = base;
     b->allocated = allocated;
+    b->source = OFPBUF_MALLOC;
+    b->refcnt = NULL;
     b->size = 0;
     b->l2 = b->l3 = b->l4 = b->l7 = NULL;
     b->next = NULL;
     b->private = NULL;
 }
 
+/* Initializes 'b' as an empty ofpbuf that contains the 'allocated' bytes of
+ * memory starting at 'base', which is owned by someone other than 'b' and
+ * which must remain valid as long as 'b' refers to it.  'b' never frees
+ * 'base'.  If 'b' must be expanded, its data is copied into memory obtained
+ * from malloc(), after which 'b' no longer refers to 'base'. */
+void
+ofpbuf_use_foreign(struct ofpbuf *b, void *base, size_t allocated)
+{
+    ofpbuf_use(b, base, allocated);
+    b->source = OFPBUF_FOREIGN;
+}
+
 /* Initializes 'b' as an empty ofpbuf with an initial capacity of 'size'
  * bytes. */
 void
@@ -64,12 +78,20 @@ ofpbuf_init(struct ofpbuf *b, size_t size)
     ofpbuf_use(b, size ? xmalloc(size) : NULL, size);
 }
 
-/* Frees memory that 'b' points to. */
+/* Frees memory that 'b' points to, unless other ofpbufs still share it. */
 void
 ofpbuf_uninit(struct ofpbuf *b) 
 {
     if (b) {
-        free(b->base);
+        if (b->refcnt) {
+            if (--*b->refcnt) {
+                return;
+            }
+            free(b->refcnt);
+        }
+        if (b->source == OFPBUF_MALLOC) {
+            free(b->base);
+        }
     }
 }
 
@@ -105,6 +127,74 @@ ofpbuf_clone_data(const void *data, size_t size)
     return b;
 }
 
+/* Creates and returns a new ofpbuf that refers to the same data as 'b',
+ * without copying it.  The new ofpbuf has the same headroom, data, tailroom
+ * and l2...l7 pointers as 'b'.
+ *
+ * The data is freed only when every ofpbuf that shares it has been freed.
+ * Until then, a shared ofpbuf may be read and may have data pulled from its
+ * head or its 'size' reduced, but it must not be modified in place without
+ * first calling ofpbuf_unshare() on it. */
+struct ofpbuf *
+ofpbuf_share(struct ofpbuf *b)
+{
+    struct ofpbuf *share = xmemdup(b, sizeof *b);
+
+    if (!b->refcnt) {
+        b->refcnt = xmalloc(sizeof *b->refcnt);
+        *b->refcnt = 1;
+    }
+    (*b->refcnt)++;
+    share->refcnt = b->refcnt;
+    share->next = NULL;
+    share->private = NULL;
+    return share;
+}
+
+/* Moves 'b''s data into 'new_allocated' bytes of newly allocated memory,
+ * keeping its headroom, and releases the memory that 'b' used to refer to. */
+static void
+ofpbuf_realloc__(struct ofpbuf *b, size_t new_allocated)
+{
+    void *new_base = xmalloc(new_allocated);
+    uintptr_t base_delta = (char*)new_base - (char*)b->base;
+
+    memcpy(new_base, b->base, MIN(b->allocated, new_allocated));
+    ofpbuf_uninit(b);
+    b->base = new_base;
+    b->allocated = new_allocated;
+    b->source = OFPBUF_MALLOC;
+    b->refcnt = NULL;
+    b->data = (char*)b->data + base_delta;
+    if (b->l2) {
+        b->l2 = (char*)b->l2 + base_delta;
+    }
+    if (b->l3) {
+        b->l3 = (char*)b->l3 + base_delta;
+    }
+    if (b->l4) {
+        b->l4 = (char*)b->l4 + base_delta;
+    }
+    if (b->l7) {
+        b->l7 = (char*)b->l7 + base_delta;
+    }
+}
+
+/* Ensures that 'b' does not share its data with any other ofpbuf, copying the
+ * data if necessary, so that it may be modified in place. */
+void
+ofpbuf_unshare(struct ofpbuf *b)
+{
+    if (b->refcnt) {
+        if (*b->refcnt > 1) {
+            ofpbuf_realloc__(b, b->allocated);
+        } else {
+            free(b->refcnt);
+            b->refcnt = NULL;
+        }
+    }
+}
+
 /* Frees memory that 'b' points to, as well as 'b' itself. */
 void
 ofpbuf_delete(struct ofpbuf *b) 
@@ -134,31 +224,15 @@ ofpbuf_tailroom(struct ofpbuf *b)
 }
 
 /* Ensures that 'b' has room for at least 'size' bytes at its tail end,
- * reallocating and copying its data if necessary. */
+ * reallocating and copying its data if necessary.  Also ensures that 'b' does
+ * not share its data, since the caller presumably intends to write there. */
 void
 ofpbuf_prealloc_tailroom(struct ofpbuf *b, size_t size) 
 {
     if (size > ofpbuf_tailroom(b)) {
-        size_t new_allocated = b->allocated + MAX(size, 64);
-        void *new_base = xmalloc(new_allocated);
-        uintptr_t base_delta = (char*)new_base - (char*)b->base;
-        memcpy(new_base, b->base, b->allocated);
-        free(b->base);
-        b->base = new_base;
-        b->allocated = new_allocated;
-        b->data = (char*)b->data + base_delta;
-        if (b->l2) {
-            b->l2 = (char*)b->l2 + base_delta;
-        }
-        if (b->l3) {
-            b->l3 = (char*)b->l3 + base_delta;
-        }
-        if (b->l4) {
-            b->l4 = (char*)b->l4 + base_delta;
-        }
-        if (b->l7) {
-            b->l7 = (char*)b->l7 + base_delta;
-        }
+        ofpbuf_realloc__(b, b->allocated + MAX(size, 64));
+    } else {
+        ofpbuf_unshare(b);
     }
 }
 
@@ -166,6 +240,7 @@ void
 ofpbuf_prealloc_headroom(struct ofpbuf *b, size_t size) 
 {
     assert(size <= ofpbuf_headroom(b));
+    ofpbuf_unshare(b);
 }
 
 /* Appends 'size' bytes of data to the tail end of 'b', reallocating and
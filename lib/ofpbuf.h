@@ -34,13 +34,28 @@
 #ifndef OFPBUF_H
 #define OFPBUF_H 1
 
+#include <stdbool.h>
 #include <stddef.h>
 
+enum ofpbuf_source {
+    OFPBUF_MALLOC,              /* Obtained via malloc(). */
+    OFPBUF_FOREIGN              /* Owned by someone else, e.g. an mmap ring. */
+};
+
 /* Buffer for holding arbitrary data.  An ofpbuf is automatically reallocated
- * as necessary if it grows too large for the available memory. */
+ * as necessary if it grows too large for the available memory.
+ *
+ * Several ofpbufs may share the same data (see ofpbuf_share()).  Functions
+ * that add data to an ofpbuf take a private copy of shared data first.  Code
+ * that modifies the data in place must call ofpbuf_unshare() beforehand.
+ * The reference count is not atomic, so ofpbufs that share data must be used
+ * by only one thread. */
 struct ofpbuf {
     void *base;                 /* First byte of area malloc()'d area. */
     size_t allocated;           /* Number of bytes allocated. */
+    enum ofpbuf_source source;  /* Source of memory allocated as 'base'. */
+    unsigned int *refcnt;       /* Number of ofpbufs sharing 'base', if
+                                 * shared, otherwise null. */
 
     void *data;                 /* First byte actually in use. */
     size_t size;                /* Number of bytes in use. */
@@ -55,6 +70,7 @@ struct ofpbuf {
 };
 
 void ofpbuf_use(struct ofpbuf *, void *, size_t);
+void ofpbuf_use_foreign(struct ofpbuf *, void *, size_t);
 
 void ofpbuf_init(struct ofpbuf *, size_t);
 void ofpbuf_uninit(struct ofpbuf *);
@@ -63,6 +79,8 @@ void ofpbuf_reinit(struct ofpbuf *, size_t);
 struct ofpbuf *ofpbuf_new(size_t);
 struct ofpbuf *ofpbuf_clone(const struct ofpbuf *);
 struct ofpbuf *ofpbuf_clone_data(const void *, size_t);
+struct ofpbuf *ofpbuf_share(struct ofpbuf *);
+void ofpbuf_unshare(struct ofpbuf *);
 void ofpbuf_delete(struct ofpbuf *);
 
 void *ofpbuf_at(const struct ofpbuf *, size_t offset, size_t size);
@@ -109,6 +109,7 @@ static inline bool eth_addr_is_reserved(const uint8_t ea[ETH_ADDR_LEN])
 #define ETH_TYPE_IP            0x0800
 #define ETH_TYPE_ARP           0x0806
 #define ETH_TYPE_VLAN          0x8100
+#define ETH_TYPE_LLDP          0x88cc
 
 #define ETH_HEADER_LEN 14
 #define ETH_PAYLOAD_MIN 46
@@ -257,6 +258,22 @@ struct tcp_header {
 };
 BUILD_ASSERT_DECL(TCP_HEADER_LEN == sizeof(struct tcp_header));
 
+/* LLDP TLVs (IEEE 802.1AB) begin with a 16-bit header that holds a 7-bit
+ * type and a 9-bit length. */
+#define LLDP_TLV_HEADER_LEN 2
+#define LLDP_TLV_TYPE(hdr) ((hdr) >> 9)
+#define LLDP_TLV_LEN(hdr) ((hdr) & 0x1ff)
+
+#define LLDP_TLV_END 0
+#define LLDP_TLV_CHASSIS_ID 1
+#define LLDP_TLV_PORT_ID 2
+#define LLDP_TLV_TTL 3
+#define LLDP_TLV_PORT_DESC 4
+#define LLDP_TLV_SYSTEM_NAME 5
+
+#define LLDP_CHASSIS_ID_MAC 4
+#define LLDP_PORT_ID_MAC 3
+
 #define ARP_HRD_ETHERNET 1
 #define ARP_PRO_IP 0x0800
 #define ARP_OP_REQUEST 1
@@ -35,9 +35,14 @@
 #include "poll-loop.h"
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
 #include "backtrace.h"
 #include "dynamic-string.h"
 #include "list.h"
@@ -57,8 +62,9 @@ struct poll_waiter {
     struct backtrace *backtrace; /* Optionally, event that created waiter. */
 
     /* Set only when poll_block() is called. */
-    struct pollfd *pollfd;      /* Pointer to element of the pollfds array
-                                   (null if added from a callback). */
+    bool polled;                /* Included in the poll?  (False if added
+                                   from a callback.) */
+    short int revents;          /* Events that occurred, if 'polled'. */
 };
 
 /* All active poll waiters. */
@@ -81,6 +87,36 @@ static struct poll_waiter *running_cb;
 #endif
 
 static struct poll_waiter *new_waiter(int fd, short int events);
+static int poll_waiters(int timeout);
+#ifdef HAVE_EPOLL_CREATE1
+static int epoll_waiters(int timeout);
+static void epoll_destroy(void);
+
+/* The epoll backend keeps each file descriptor registered with the kernel for
+ * as long as it keeps being waited on, so that a wakeup costs time in
+ * proportion to the number of ready file descriptors rather than the number
+ * of waiters.  It calls epoll_ctl() only when the set of events waited for on
+ * a file descriptor changes. */
+struct epoll_fd {
+    short int registered;       /* Events registered with the kernel. */
+    short int wanted;           /* Events wanted in this poll_block(). */
+    short int revents;          /* Events that occurred. */
+    bool unpollable;            /* Not supported by epoll (always ready). */
+    unsigned int serial;        /* 'epoll_serial' when 'wanted' was set. */
+    int idx;                    /* Index in 'epoll_fd_list', or -1. */
+};
+
+/* The epoll event bits have the same values as the poll() ones on Linux. */
+BUILD_ASSERT_DECL(EPOLLIN == POLLIN && EPOLLOUT == POLLOUT);
+BUILD_ASSERT_DECL(EPOLLERR == POLLERR && EPOLLHUP == POLLHUP);
+
+static int epoll_fd = -1;       /* epoll instance, or -1 to use poll(). */
+static unsigned int epoll_serial; /* Incremented on each poll_block(). */
+static struct epoll_fd *epoll_fds; /* Indexed by file descriptor. */
+static int n_epoll_fds;         /* Number of elements in 'epoll_fds'. */
+static int *epoll_fd_list;      /* File descriptors registered or waited. */
+static int n_epoll_fd_list;     /* Number of elements in 'epoll_fd_list'. */
+#endif
 
 /* Registers 'fd' as waiting for the specified 'events' (which should be POLLIN
  * or POLLOUT or POLLIN | POLLOUT).  The following call to poll_block() will
@@ -153,30 +189,16 @@ log_wakeup(const struct backtrace *backtrace, const char *format, ...)
 void
 poll_block(void)
 {
-    static struct pollfd *pollfds;
-    static size_t max_pollfds;
-
     struct poll_waiter *pw;
     struct list *node;
-    int n_pollfds;
     int retval;
 
     assert(!running_cb);
-    if (max_pollfds < n_waiters) {
-        max_pollfds = n_waiters;
-        pollfds = xrealloc(pollfds, max_pollfds * sizeof *pollfds);
-    }
-
-    n_pollfds = 0;
-    LIST_FOR_EACH (pw, struct poll_waiter, node, &waiters) {
-        pw->pollfd = &pollfds[n_pollfds];
-        pollfds[n_pollfds].fd = pw->fd;
-        pollfds[n_pollfds].events = pw->events;
-        pollfds[n_pollfds].revents = 0;
-        n_pollfds++;
-    }
-
-    retval = time_poll(pollfds, n_pollfds, timeout);
+#ifdef HAVE_EPOLL_CREATE1
+    retval = epoll_fd >= 0 ? epoll_waiters(timeout) : poll_waiters(timeout);
+#else
+    retval = poll_waiters(timeout);
+#endif
     if (retval < 0) {
         static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(1, 5);
         VLOG_ERR_RL(&rl, "poll: %s", strerror(-retval));
@@ -186,7 +208,7 @@ poll_block(void)
 
     for (node = waiters.next; node != &waiters; ) {
         pw = CONTAINER_OF(node, struct poll_waiter, node);
-        if (!pw->pollfd || !pw->pollfd->revents) {
+        if (!pw->polled || !pw->revents) {
             if (pw->function) {
                 node = node->next;
                 continue;
@@ -194,11 +216,11 @@ poll_block(void)
         } else {
             if (VLOG_IS_DBG_ENABLED()) {
                 log_wakeup(pw->backtrace, "%s%s%s%s%s on fd %d",
-                           pw->pollfd->revents & POLLIN ? "[POLLIN]" : "",
-                           pw->pollfd->revents & POLLOUT ? "[POLLOUT]" : "",
-                           pw->pollfd->revents & POLLERR ? "[POLLERR]" : "",
-                           pw->pollfd->revents & POLLHUP ? "[POLLHUP]" : "",
-                           pw->pollfd->revents & POLLNVAL ? "[POLLNVAL]" : "",
+                           pw->revents & POLLIN ? "[POLLIN]" : "",
+                           pw->revents & POLLOUT ? "[POLLOUT]" : "",
+                           pw->revents & POLLERR ? "[POLLERR]" : "",
+                           pw->revents & POLLHUP ? "[POLLHUP]" : "",
+                           pw->revents & POLLNVAL ? "[POLLNVAL]" : "",
                            pw->fd);
             }
 
@@ -206,7 +228,7 @@ poll_block(void)
 #ifndef NDEBUG
                 running_cb = pw;
 #endif
-                pw->function(pw->fd, pw->pollfd->revents, pw->aux);
+                pw->function(pw->fd, pw->revents, pw->aux);
 #ifndef NDEBUG
                 running_cb = NULL;
 #endif
@@ -261,6 +283,246 @@ poll_cancel(struct poll_waiter *pw)
     }
 }
 
+/* Selects the system call that poll_block() uses to wait, by 'name': "poll"
+ * (the default) or "epoll".  Returns 0 if successful, ENOENT if 'name' is
+ * unknown, or another positive errno value if it cannot be used on this
+ * system.
+ *
+ * This should be called before any events are registered, e.g. while parsing
+ * command-line options. */
+int
+poll_backend_select(const char *name)
+{
+    if (!strcmp(name, "poll")) {
+#ifdef HAVE_EPOLL_CREATE1
+        epoll_destroy();
+#endif
+        return 0;
+    } else if (!strcmp(name, "epoll")) {
+#ifdef HAVE_EPOLL_CREATE1
+        if (epoll_fd < 0) {
+            epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd < 0) {
+                return errno;
+            }
+        }
+        return 0;
+#else
+        return EOPNOTSUPP;
+#endif
+    } else {
+        return ENOENT;
+    }
+}
+
+/* Returns the name of the backend in use, as accepted by
+ * poll_backend_select(). */
+const char *
+poll_backend_name(void)
+{
+#ifdef HAVE_EPOLL_CREATE1
+    return epoll_fd >= 0 ? "epoll" : "poll";
+#else
+    return "poll";
+#endif
+}
+
+/* Informs the poll loop that 'fd' is being closed.  Any code that closes a
+ * file descriptor that it has passed to poll_fd_wait() or poll_fd_callback()
+ * must call this, before or just after closing it, because the epoll backend
+ * would otherwise fail to notice that a later file descriptor with the same
+ * number is a different file. */
+void
+poll_fd_forget(int fd)
+{
+#ifdef HAVE_EPOLL_CREATE1
+    if (fd >= 0 && fd < n_epoll_fds && epoll_fds[fd].registered) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        epoll_fds[fd].registered = 0;
+    }
+#endif
+}
+
+/* Waits with poll() for the events in the 'waiters' list, for up to 'timeout'
+ * milliseconds, and stores the results in each waiter.  Returns the number of
+ * ready file descriptors or a negative errno value. */
+static int
+poll_waiters(int timeout)
+{
+    static struct pollfd *pollfds;
+    static size_t max_pollfds;
+
+    struct poll_waiter *pw;
+    int n_pollfds;
+    int retval;
+
+    if (max_pollfds < n_waiters) {
+        max_pollfds = n_waiters;
+        pollfds = xrealloc(pollfds, max_pollfds * sizeof *pollfds);
+    }
+
+    n_pollfds = 0;
+    LIST_FOR_EACH (pw, struct poll_waiter, node, &waiters) {
+        pollfds[n_pollfds].fd = pw->fd;
+        pollfds[n_pollfds].events = pw->events;
+        pollfds[n_pollfds].revents = 0;
+        n_pollfds++;
+    }
+
+    retval = time_poll(pollfds, n_pollfds, timeout);
+
+    n_pollfds = 0;
+    LIST_FOR_EACH (pw, struct poll_waiter, node, &waiters) {
+        pw->polled = true;
+        pw->revents = pollfds[n_pollfds++].revents;
+    }
+    return retval;
+}
+
+#ifdef HAVE_EPOLL_CREATE1
+static void
+epoll_destroy(void)
+{
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+        free(epoll_fds);
+        epoll_fds = NULL;
+        n_epoll_fds = 0;
+        free(epoll_fd_list);
+        epoll_fd_list = NULL;
+        n_epoll_fd_list = 0;
+    }
+}
+
+/* Returns the epoll_fd for 'fd', expanding 'epoll_fds' if necessary. */
+static struct epoll_fd *
+epoll_fd_get(int fd)
+{
+    if (fd >= n_epoll_fds) {
+        int new_n = MAX(fd + 1, n_epoll_fds * 2);
+        int i;
+
+        epoll_fds = xrealloc(epoll_fds, new_n * sizeof *epoll_fds);
+        epoll_fd_list = xrealloc(epoll_fd_list,
+                                 new_n * sizeof *epoll_fd_list);
+        for (i = n_epoll_fds; i < new_n; i++) {
+            struct epoll_fd *e = &epoll_fds[i];
+            memset(e, 0, sizeof *e);
+            e->idx = -1;
+        }
+        n_epoll_fds = new_n;
+    }
+    return &epoll_fds[fd];
+}
+
+/* Brings the kernel's registration of 'fd', described by 'e', up to date with
+ * 'e->wanted'. */
+static void
+epoll_fd_sync(int fd, struct epoll_fd *e)
+{
+    struct epoll_event event;
+    int op;
+
+    if (e->unpollable || e->registered == e->wanted) {
+        return;
+    }
+
+    memset(&event, 0, sizeof event);
+    event.events = e->wanted;
+    event.data.fd = fd;
+    op = e->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epoll_fd, op, fd, &event) < 0) {
+        if (errno == ENOENT) {
+            op = EPOLL_CTL_ADD;
+        } else if (errno == EEXIST) {
+            op = EPOLL_CTL_MOD;
+        } else {
+            op = -1;
+        }
+        if (op < 0 || epoll_ctl(epoll_fd, op, fd, &event) < 0) {
+            /* poll() reports regular files as always ready and invalid file
+             * descriptors as POLLNVAL, so do the same. */
+            e->unpollable = true;
+            e->registered = 0;
+            return;
+        }
+    }
+    e->registered = e->wanted;
+}
+
+/* Waits with epoll_wait() for the events in the 'waiters' list, for up to
+ * 'timeout' milliseconds, and stores the results in each waiter.  Returns the
+ * number of ready file descriptors or a negative errno value. */
+static int
+epoll_waiters(int timeout)
+{
+    static struct epoll_event *events;
+    static int max_events;
+
+    struct poll_waiter *pw;
+    int n_ready;
+    int retval;
+    int i;
+
+    /* Collect the events wanted on each file descriptor. */
+    epoll_serial++;
+    LIST_FOR_EACH (pw, struct poll_waiter, node, &waiters) {
+        struct epoll_fd *e = epoll_fd_get(pw->fd);
+        if (e->serial != epoll_serial) {
+            e->serial = epoll_serial;
+            e->wanted = 0;
+            e->revents = 0;
+            e->unpollable = false;
+            if (e->idx < 0) {
+                e->idx = n_epoll_fd_list;
+                epoll_fd_list[n_epoll_fd_list++] = pw->fd;
+            }
+        }
+        e->wanted |= pw->events;
+    }
+
+    /* Update the kernel's registrations, dropping file descriptors that are
+     * no longer waited on. */
+    n_ready = 0;
+    for (i = 0; i < n_epoll_fd_list; ) {
+        int fd = epoll_fd_list[i];
+        struct epoll_fd *e = &epoll_fds[fd];
+
+        if (e->serial != epoll_serial) {
+            poll_fd_forget(fd);
+            epoll_fd_list[i] = epoll_fd_list[--n_epoll_fd_list];
+            epoll_fds[epoll_fd_list[i]].idx = i;
+            e->idx = -1;
+            continue;
+        }
+        epoll_fd_sync(fd, e);
+        if (e->unpollable) {
+            e->revents = fcntl(fd, F_GETFD) < 0 ? POLLNVAL : e->wanted;
+            n_ready++;
+        }
+        i++;
+    }
+
+    if (max_events < n_epoll_fd_list) {
+        max_events = n_epoll_fd_list;
+        events = xrealloc(events, max_events * sizeof *events);
+    }
+    retval = time_epoll_wait(epoll_fd, events, MAX(max_events, 1),
+                             n_ready ? 0 : timeout);
+    for (i = 0; i < retval; i++) {
+        epoll_fds[events[i].data.fd].revents |= events[i].events;
+    }
+
+    LIST_FOR_EACH (pw, struct poll_waiter, node, &waiters) {
+        pw->polled = true;
+        pw->revents = (epoll_fds[pw->fd].revents
+                       & (pw->events | POLLERR | POLLHUP | POLLNVAL));
+    }
+    return retval < 0 ? retval : retval + n_ready;
+}
+#endif /* HAVE_EPOLL_CREATE1 */
+
 /* Creates and returns a new poll_waiter for 'fd' and 'events'. */
 static struct poll_waiter *
 new_waiter(int fd, short int events)
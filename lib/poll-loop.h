@@ -69,4 +69,9 @@ struct poll_waiter *poll_fd_callback(int fd, short int events,
 /* Cancel a file descriptor callback or event. */
 void poll_cancel(struct poll_waiter *);
 
+/* Choosing how to wait. */
+int poll_backend_select(const char *name);
+const char *poll_backend_name(void);
+void poll_fd_forget(int fd);
+
 #endif /* poll-loop.h */
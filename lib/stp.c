@@ -51,42 +51,6 @@
 const uint8_t stp_eth_addr[ETH_ADDR_LEN]
 = { 0x01, 0x80, 0xC2, 0x00, 0x00, 0x01 };
 
-#define STP_PROTOCOL_ID 0x0000
-#define STP_PROTOCOL_VERSION 0x00
-#define STP_TYPE_CONFIG 0x00
-#define STP_TYPE_TCN 0x80
-
-struct stp_bpdu_header {
-    uint16_t protocol_id;       /* STP_PROTOCOL_ID. */
-    uint8_t protocol_version;   /* STP_PROTOCOL_VERSION. */
-    uint8_t bpdu_type;          /* One of STP_TYPE_*. */
-} __attribute__((packed));
-BUILD_ASSERT_DECL(sizeof(struct stp_bpdu_header) == 4);
-
-enum stp_config_bpdu_flags {
-    STP_CONFIG_TOPOLOGY_CHANGE_ACK = 0x80,
-    STP_CONFIG_TOPOLOGY_CHANGE = 0x01
-};
-
-struct stp_config_bpdu {
-    struct stp_bpdu_header header; /* Type STP_TYPE_CONFIG. */
-    uint8_t flags;                 /* STP_CONFIG_* flags. */
-    uint64_t root_id;              /* 8.5.1.1: Bridge believed to be root. */
-    uint32_t root_path_cost;       /* 8.5.1.2: Cost of path to root. */
-    uint64_t bridge_id;            /* 8.5.1.3: ID of transmitting bridge. */
-    uint16_t port_id;              /* 8.5.1.4: Port transmitting the BPDU. */
-    uint16_t message_age;          /* 8.5.1.5: Age of BPDU at tx time. */
-    uint16_t max_age;              /* 8.5.1.6: Timeout for received data. */
-    uint16_t hello_time;           /* 8.5.1.7: Time between BPDU generation. */
-    uint16_t forward_delay;        /* 8.5.1.8: State progression delay. */
-} __attribute__((packed));
-BUILD_ASSERT_DECL(sizeof(struct stp_config_bpdu) == 35);
-
-struct stp_tcn_bpdu {
-    struct stp_bpdu_header header; /* Type STP_TYPE_TCN. */
-} __attribute__((packed));
-BUILD_ASSERT_DECL(sizeof(struct stp_tcn_bpdu) == 4);
-
 struct stp_timer {
     bool active;                 /* Timer in use? */
     int value;                   /* Current value of timer, counting up. */
@@ -52,6 +52,43 @@ extern const uint8_t stp_eth_addr[6];
 #define STP_LLC_DSAP 0x42
 #define STP_LLC_CNTL 0x03
 
+/* BPDU wire format (clause 9). */
+#define STP_PROTOCOL_ID 0x0000
+#define STP_PROTOCOL_VERSION 0x00
+#define STP_TYPE_CONFIG 0x00
+#define STP_TYPE_TCN 0x80
+
+struct stp_bpdu_header {
+    uint16_t protocol_id;       /* STP_PROTOCOL_ID. */
+    uint8_t protocol_version;   /* STP_PROTOCOL_VERSION. */
+    uint8_t bpdu_type;          /* One of STP_TYPE_*. */
+} __attribute__((packed));
+BUILD_ASSERT_DECL(sizeof(struct stp_bpdu_header) == 4);
+
+enum stp_config_bpdu_flags {
+    STP_CONFIG_TOPOLOGY_CHANGE_ACK = 0x80,
+    STP_CONFIG_TOPOLOGY_CHANGE = 0x01
+};
+
+struct stp_config_bpdu {
+    struct stp_bpdu_header header; /* Type STP_TYPE_CONFIG. */
+    uint8_t flags;                 /* STP_CONFIG_* flags. */
+    uint64_t root_id;              /* 8.5.1.1: Bridge believed to be root. */
+    uint32_t root_path_cost;       /* 8.5.1.2: Cost of path to root. */
+    uint64_t bridge_id;            /* 8.5.1.3: ID of transmitting bridge. */
+    uint16_t port_id;              /* 8.5.1.4: Port transmitting the BPDU. */
+    uint16_t message_age;          /* 8.5.1.5: Age of BPDU at tx time. */
+    uint16_t max_age;              /* 8.5.1.6: Timeout for received data. */
+    uint16_t hello_time;           /* 8.5.1.7: Time between BPDU generation. */
+    uint16_t forward_delay;        /* 8.5.1.8: State progression delay. */
+} __attribute__((packed));
+BUILD_ASSERT_DECL(sizeof(struct stp_config_bpdu) == 35);
+
+struct stp_tcn_bpdu {
+    struct stp_bpdu_header header; /* Type STP_TYPE_TCN. */
+} __attribute__((packed));
+BUILD_ASSERT_DECL(sizeof(struct stp_tcn_bpdu) == 4);
+
 /* Bridge and port priorities that should be used by default. */
 #define STP_DEFAULT_BRIDGE_PRIORITY 32768
 #define STP_DEFAULT_PORT_PRIORITY 128
@@ -33,90 +33,84 @@
 
 #include <config.h>
 #include "timeval.h"
-#include <assert.h>
 #include <errno.h>
 #include <poll.h>
 #include <signal.h>
 #include <string.h>
-#include <sys/time.h>
+#ifdef HAVE_EPOLL_CREATE1
+#include <sys/epoll.h>
+#endif
+#include <unistd.h>
 #include "fatal-signal.h"
 #include "util.h"
 
 /* Initialized? */
 static bool inited;
 
-/* Has a timer tick occurred? */
-static volatile sig_atomic_t tick;
+/* Clock read by time_refresh().  time_init() switches to a coarse clock, if
+ * one is available, because the kernel can report it without a system call
+ * and the extra precision of CLOCK_MONOTONIC is not useful to us. */
+static clockid_t monotonic_clock = CLOCK_MONOTONIC;
 
-/* The current time, as of the last refresh. */
-static struct timeval now;
-
-/* Time at which to die with SIGALRM (if not TIME_MIN). */
-static time_t deadline = TIME_MIN;
+/* The current monotonic time, in ms, as of the last refresh.  Several threads
+ * may refresh and read it at once, so it is only accessed atomically. */
+long long int time_cached_msec;
 
 static void sigalrm_handler(int);
-static void refresh_if_ticked(void);
-static time_t time_add(time_t, time_t);
-static void block_sigalrm(sigset_t *);
-static void unblock_sigalrm(const sigset_t *);
 
 /* Initializes the timetracking module. */
 void
 time_init(void)
 {
-    struct sigaction sa;
-    struct itimerval itimer;
-
     if (inited) {
         return;
     }
 
     inited = true;
-    gettimeofday(&now, NULL);
-    tick = false;
-
-    /* Set up signal handler. */
-    memset(&sa, 0, sizeof sa);
-    sa.sa_handler = sigalrm_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
-    if (sigaction(SIGALRM, &sa, NULL)) {
-        ofp_fatal(errno, "sigaction(SIGALRM) failed");
-    }
-
-    /* Set up periodic timer. */
-    itimer.it_interval.tv_sec = 0;
-    itimer.it_interval.tv_usec = TIME_UPDATE_INTERVAL * 1000;
-    itimer.it_value = itimer.it_interval;
-    if (setitimer(ITIMER_REAL, &itimer, NULL)) {
-        ofp_fatal(errno, "setitimer failed");
+#ifdef CLOCK_MONOTONIC_COARSE
+    {
+        struct timespec res;
+        if (!clock_getres(CLOCK_MONOTONIC_COARSE, &res)
+            && !res.tv_sec && res.tv_nsec <= 10 * 1000 * 1000) {
+            monotonic_clock = CLOCK_MONOTONIC_COARSE;
+        }
     }
+#endif
+    time_refresh();
 }
 
-/* Forces a refresh of the current time from the kernel.  It is not usually
- * necessary to call this function, since the time will be refreshed
- * automatically at least every TIME_UPDATE_INTERVAL milliseconds. */
+/* Refreshes the time reported by time_now() and time_msec() from the kernel.
+ * time_poll() does this before and after it waits, so that code running
+ * between calls to poll_block() sees the time at which it woke up.  Code that
+ * runs for a long time without blocking, or in a thread that does not use
+ * poll_block(), should call this itself. */
 void
 time_refresh(void)
 {
-    gettimeofday(&now, NULL);
-    tick = false;
+    struct timespec ts;
+    long long int msec, old;
+
+    clock_gettime(monotonic_clock, &ts);
+    msec = (long long int) ts.tv_sec * 1000 + ts.tv_nsec / (1000 * 1000);
+
+    /* Another thread may be refreshing the time too, with a clock reading
+     * taken before or after ours.  Keep whichever is later. */
+    old = __atomic_load_n(&time_cached_msec, __ATOMIC_RELAXED);
+    while (msec > old
+           && !__atomic_compare_exchange_n(&time_cached_msec, &old, msec,
+                                           false, __ATOMIC_RELAXED,
+                                           __ATOMIC_RELAXED)) {
+        continue;
+    }
 }
 
-/* Returns the current time, in seconds. */
+/* Returns the current wall-clock time, in seconds since the epoch.  Use this
+ * only for times that are shown to people or other systems: unlike
+ * time_now(), it can jump when the system clock is set. */
 time_t
-time_now(void)
+time_wall(void)
 {
-    refresh_if_ticked();
-    return now.tv_sec;
-}
-
-/* Returns the current time, in ms (within TIME_UPDATE_INTERVAL ms). */
-long long int
-time_msec(void)
-{
-    refresh_if_ticked();
-    return (long long int) now.tv_sec * 1000 + now.tv_usec / 1000;
+    return time(NULL);
 }
 
 /* Configures the program to die with SIGALRM 'secs' seconds from now, if
@@ -124,35 +118,41 @@ time_msec(void)
 void
 time_alarm(unsigned int secs)
 {
-    sigset_t oldsigs;
+    static bool installed;
 
     time_init();
-    block_sigalrm(&oldsigs);
-    deadline = secs ? time_add(time_now(), secs) : TIME_MIN;
-    unblock_sigalrm(&oldsigs);
+    if (secs && !installed) {
+        struct sigaction sa;
+
+        memset(&sa, 0, sizeof sa);
+        sa.sa_handler = sigalrm_handler;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART;
+        if (sigaction(SIGALRM, &sa, NULL)) {
+            ofp_fatal(errno, "sigaction(SIGALRM) failed");
+        }
+        installed = true;
+    }
+    alarm(secs);
 }
 
-/* Like poll(), except:
- *
- *      - On error, returns a negative error code (instead of setting errno).
- *
- *      - If interrupted by a signal, retries automatically until the original
- *        'timeout' expires.  (Because of this property, this function will
- *        never return -EINTR.)
- *
- *      - As a side effect, refreshes the current time (like time_refresh()).
- */
-int
-time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
+static int
+poll_cb(void *pollfds, int n_pollfds, int timeout, int aux UNUSED)
+{
+    return poll(pollfds, n_pollfds, timeout);
+}
+
+/* Calls 'wait_cb' to wait on 'n' items in 'items' for up to 'timeout'
+ * milliseconds, as described for time_poll(). */
+static int
+time_wait(int (*wait_cb)(void *items, int n, int timeout, int aux),
+          void *items, int n, int timeout, int aux)
 {
     long long int start;
-    sigset_t oldsigs;
-    bool blocked;
     int retval;
 
     time_refresh();
     start = time_msec();
-    blocked = false;
     for (;;) {
         int time_left;
         if (timeout > 0) {
@@ -162,68 +162,53 @@ time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
             time_left = timeout;
         }
 
-        retval = poll(pollfds, n_pollfds, time_left);
+        retval = wait_cb(items, n, time_left, aux);
         if (retval < 0) {
             retval = -errno;
         }
+        time_refresh();
         if (retval != -EINTR) {
             break;
         }
-
-        if (!blocked && deadline == TIME_MIN) {
-            block_sigalrm(&oldsigs);
-            blocked = true;
-        }
-        time_refresh();
-    }
-    if (blocked) {
-        unblock_sigalrm(&oldsigs);
     }
     return retval;
 }
 
-/* Returns the sum of 'a' and 'b', with saturation on overflow or underflow. */
-static time_t
-time_add(time_t a, time_t b)
-{
-    return (a >= 0
-            ? (b > TIME_MAX - a ? TIME_MAX : a + b)
-            : (b < TIME_MIN - a ? TIME_MIN : a + b));
-}
-
-static void
-sigalrm_handler(int sig_nr)
+/* Like poll(), except:
+ *
+ *      - On error, returns a negative error code (instead of setting errno).
+ *
+ *      - If interrupted by a signal, retries automatically until the original
+ *        'timeout' expires.  (Because of this property, this function will
+ *        never return -EINTR.)
+ *
+ *      - As a side effect, refreshes the current time (like time_refresh())
+ *        before and after waiting.
+ */
+int
+time_poll(struct pollfd *pollfds, int n_pollfds, int timeout)
 {
-    tick = true;
-    if (deadline != TIME_MIN && time(0) > deadline) {
-        fatal_signal_handler(sig_nr);
-    }
+    return time_wait(poll_cb, pollfds, n_pollfds, timeout, 0);
 }
 
-static void
-refresh_if_ticked(void)
+#ifdef HAVE_EPOLL_CREATE1
+static int
+epoll_wait_cb(void *events, int max_events, int timeout, int epfd)
 {
-    assert(inited);
-    if (tick) {
-        time_refresh();
-    }
+    return epoll_wait(epfd, events, max_events, timeout);
 }
 
-static void
-block_sigalrm(sigset_t *oldsigs)
+/* Like epoll_wait(), with the same differences as time_poll(). */
+int
+time_epoll_wait(int epfd, struct epoll_event *events, int max_events,
+                int timeout)
 {
-    sigset_t sigalrm;
-    sigemptyset(&sigalrm);
-    sigaddset(&sigalrm, SIGALRM);
-    if (sigprocmask(SIG_BLOCK, &sigalrm, oldsigs)) {
-        ofp_fatal(errno, "sigprocmask");
-    }
+    return time_wait(epoll_wait_cb, events, max_events, timeout, epfd);
 }
+#endif
 
 static void
-unblock_sigalrm(const sigset_t *oldsigs)
+sigalrm_handler(int sig_nr)
 {
-    if (sigprocmask(SIG_SETMASK, oldsigs, NULL)) {
-        ofp_fatal(errno, "sigprocmask");
-    }
+    fatal_signal_handler(sig_nr);
 }
@@ -50,17 +50,40 @@ BUILD_ASSERT_DECL(TYPE_IS_SIGNED(time_t));
 #define TIME_MAX TYPE_MAXIMUM(time_t)
 #define TIME_MIN TYPE_MINIMUM(time_t)
 
-/* Interval between updates to the time reported by time_gettimeofday(), in ms.
- * This should not be adjusted much below 10 ms or so with the current
- * implementation, or too much time will be wasted in signal handlers and calls
- * to time(0). */
+/* Code that waits for time to pass, without any other event to wake it up,
+ * should not wait for less than this many ms at a time. */
 #define TIME_UPDATE_INTERVAL 100
 
 void time_init(void);
 void time_refresh(void);
-time_t time_now(void);
-long long int time_msec(void);
+time_t time_wall(void);
 void time_alarm(unsigned int secs);
+
+/* Monotonic time in ms as of the last time_refresh().  Use time_msec() or
+ * time_now() instead of reading this directly. */
+extern long long int time_cached_msec;
+
+/* Returns a monotonic time, in ms, as of the last time the poll loop woke up
+ * (or time_refresh() was called).  The starting point is arbitrary, so it is
+ * only useful for measuring intervals.  Cheap enough to call per packet. */
+static inline long long int
+time_msec(void)
+{
+    return __atomic_load_n(&time_cached_msec, __ATOMIC_RELAXED);
+}
+
+/* Returns the same time as time_msec(), in seconds. */
+static inline time_t
+time_now(void)
+{
+    return time_msec() / 1000;
+}
+
 int time_poll(struct pollfd *, int n_pollfds, int timeout);
+#ifdef HAVE_EPOLL_CREATE1
+struct epoll_event;
+int time_epoll_wait(int epfd, struct epoll_event *, int max_events,
+                    int timeout);
+#endif
 
 #endif /* timeval.h */
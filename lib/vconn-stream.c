@@ -39,11 +39,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include "leak-checker.h"
 #include "ofpbuf.h"
 #include "openflow/openflow.h"
 #include "poll-loop.h"
+#include "queue.h"
 #include "socket-util.h"
 #include "util.h"
 #include "vconn-provider.h"
@@ -54,20 +56,41 @@
 
 /* Active stream socket vconn. */
 
+/* stream_send() queues messages rather than writing them one at a time.  The
+ * queue is written with writev() when the socket becomes writable, so a burst
+ * of small messages costs one system call.  Once STREAM_TX_MAX bytes are
+ * queued, stream_send() returns EAGAIN until the queue drains.  A single
+ * message larger than that is accepted when the queue is empty. */
+#define STREAM_TX_MAX (64 * 1024)
+
+/* Maximum number of messages passed to a single writev() call. */
+#define STREAM_TX_IOV 64
+
+/* stream_recv() reads as much as STREAM_RX_SIZE bytes at a time into a
+ * read-ahead buffer, then slices complete messages out of it, so that a
+ * controller that pipelines many messages costs one read() per buffer-full
+ * instead of two per message.  A message too big for the buffer is moved to
+ * a buffer of its own and the rest of it is read directly there. */
+#define STREAM_RX_SIZE (64 * 1024)
+
 struct stream_vconn
 {
     struct vconn vconn;
     int fd;
-    struct ofpbuf *rxbuf;
-    struct ofpbuf *txbuf;
+    struct ofpbuf *rxbuf;       /* Read-ahead buffer. */
+    struct ofpbuf *rxmsg;       /* Partial message too big for 'rxbuf'. */
+    struct ofp_queue txq;       /* Messages not yet fully written. */
+    size_t tx_bytes;            /* Number of bytes of data in 'txq'. */
     struct poll_waiter *tx_waiter;
+    int tx_error;               /* Error writing 'txq', if nonzero. */
 };
 
 static struct vconn_class stream_vconn_class;
 
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(10, 25);
 
-static void stream_clear_txbuf(struct stream_vconn *);
+static int stream_flush(struct stream_vconn *);
+static void stream_clear_txq(struct stream_vconn *);
 
 int
 new_stream_vconn(const char *name, int fd, int connect_status,
@@ -79,9 +102,12 @@ new_stream_vconn(const char *name, int fd, int connect_status,
     vconn_init(&s->vconn, &stream_vconn_class, connect_status, ip, name,
                reconnectable);
     s->fd = fd;
-    s->txbuf = NULL;
+    queue_init(&s->txq);
+    s->tx_bytes = 0;
     s->tx_waiter = NULL;
+    s->tx_error = 0;
     s->rxbuf = NULL;
+    s->rxmsg = NULL;
     *vconnp = &s->vconn;
     return 0;
 }
@@ -98,8 +124,11 @@ stream_close(struct vconn *vconn)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
     poll_cancel(s->tx_waiter);
-    stream_clear_txbuf(s);
+    stream_flush(s);            /* Best effort: don't drop queued messages. */
+    stream_clear_txq(s);
     ofpbuf_delete(s->rxbuf);
+    ofpbuf_delete(s->rxmsg);
+    poll_fd_forget(s->fd);
     close(s->fd);
     free(s);
 }
@@ -111,140 +140,244 @@ stream_connect(struct vconn *vconn)
     return check_connection_completion(s->fd);
 }
 
+/* Returns the length claimed by the OpenFlow header at the head of 'rx', or
+ * 0 if 'rx' does not yet hold a complete header. */
+static size_t
+stream_rx_length(const struct ofpbuf *rx)
+{
+    const struct ofp_header *oh = rx->data;
+    return rx->size >= sizeof *oh ? ntohs(oh->length) : 0;
+}
+
+/* Returns true if stream_recv() can return without reading from the socket,
+ * because 'rx' holds a complete message or an invalid header. */
+static bool
+stream_rx_ready(const struct ofpbuf *rx)
+{
+    size_t length = stream_rx_length(rx);
+    return (length && (length < sizeof(struct ofp_header)
+                       || rx->size >= length));
+}
+
+/* Reads into the tailroom of 'rx' from 's'.  Returns 0 if some data was read,
+ * otherwise EAGAIN, EOF, or another positive errno value. */
+static int
+stream_rx_read(struct stream_vconn *s, struct ofpbuf *rx)
+{
+    ssize_t retval = read(s->fd, ofpbuf_tail(rx), ofpbuf_tailroom(rx));
+    if (retval > 0) {
+        rx->size += retval;
+        return 0;
+    } else if (retval == 0) {
+        if (s->rxmsg || s->rxbuf->size) {
+            VLOG_ERR_RL(&rl, "connection dropped mid-packet");
+            return EPROTO;
+        }
+        return EOF;
+    } else {
+        return errno;
+    }
+}
+
 static int
 stream_recv(struct vconn *vconn, struct ofpbuf **bufferp)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
     struct ofpbuf *rx;
-    size_t want_bytes;
-    ssize_t retval;
+    size_t length;
+    int error;
 
+    if (s->tx_error) {
+        return s->tx_error;
+    }
     if (s->rxbuf == NULL) {
-        s->rxbuf = ofpbuf_new(1564);
+        s->rxbuf = ofpbuf_new(STREAM_RX_SIZE);
     }
     rx = s->rxbuf;
 
-again:
-    if (sizeof(struct ofp_header) > rx->size) {
-        want_bytes = sizeof(struct ofp_header) - rx->size;
-    } else {
-        struct ofp_header *oh = rx->data;
-        size_t length = ntohs(oh->length);
-        if (length < sizeof(struct ofp_header)) {
+    if (s->rxmsg) {
+        /* Continue reading a message too big for the read-ahead buffer. */
+        error = stream_rx_read(s, s->rxmsg);
+        if (error) {
+            return error;
+        }
+        if (ofpbuf_tailroom(s->rxmsg)) {
+            return EAGAIN;
+        }
+        *bufferp = s->rxmsg;
+        s->rxmsg = NULL;
+        return 0;
+    }
+
+    for (;;) {
+        length = stream_rx_length(rx);
+        if (length && length < sizeof(struct ofp_header)) {
             VLOG_ERR_RL(&rl, "received too-short ofp_header (%zu bytes)",
                         length);
             return EPROTO;
-        }
-        want_bytes = length - rx->size;
-        if (!want_bytes) {
-            *bufferp = rx;
-            s->rxbuf = NULL;
+        } else if (length && rx->size >= length) {
+            *bufferp = ofpbuf_clone_data(rx->data, length);
+            ofpbuf_pull(rx, length);
+            if (!rx->size) {
+                ofpbuf_clear(rx);
+            }
             return 0;
+        } else if (length > rx->allocated) {
+            /* Move what we have of the message into a buffer of its own and
+             * read the rest directly into it. */
+            s->rxmsg = ofpbuf_new(length);
+            ofpbuf_put(s->rxmsg, rx->data, rx->size);
+            ofpbuf_clear(rx);
+            return stream_recv(vconn, bufferp);
         }
-    }
-    ofpbuf_prealloc_tailroom(rx, want_bytes);
 
-    retval = read(s->fd, ofpbuf_tail(rx), want_bytes);
-    if (retval > 0) {
-        rx->size += retval;
-        if (retval == want_bytes) {
-            if (rx->size > sizeof(struct ofp_header)) {
-                *bufferp = rx;
-                s->rxbuf = NULL;
-                return 0;
-            } else {
-                goto again;
-            }
+        /* Make room for the rest of a partial message, then read. */
+        if (rx->size && (char *) rx->data + MAX(length, sizeof(struct ofp_header))
+                        > (char *) ofpbuf_end(rx)) {
+            memmove(rx->base, rx->data, rx->size);
+            rx->data = rx->base;
         }
-        return EAGAIN;
-    } else if (retval == 0) {
-        if (rx->size) {
-            VLOG_ERR_RL(&rl, "connection dropped mid-packet");
-            return EPROTO;
-        } else {
-            return EOF;
+        error = stream_rx_read(s, rx);
+        if (error) {
+            return error;
         }
-    } else {
-        return errno;
     }
 }
 
 static void
-stream_clear_txbuf(struct stream_vconn *s)
+stream_clear_txq(struct stream_vconn *s)
 {
-    ofpbuf_delete(s->txbuf);
-    s->txbuf = NULL;
+    queue_clear(&s->txq);
+    s->tx_bytes = 0;
     s->tx_waiter = NULL;
 }
 
+/* Writes as much of 's''s transmit queue as the socket will accept, up to
+ * STREAM_TX_IOV messages per writev() call.  Returns 0 if the queue was
+ * emptied or the socket's buffer filled up, otherwise a positive errno
+ * value. */
+static int
+stream_flush(struct stream_vconn *s)
+{
+    while (s->txq.n) {
+        struct iovec iov[STREAM_TX_IOV];
+        struct ofpbuf *b;
+        size_t total = 0;
+        ssize_t n;
+        int n_iov;
+
+        n_iov = 0;
+        for (b = s->txq.head; b && n_iov < STREAM_TX_IOV; b = b->next) {
+            iov[n_iov].iov_base = b->data;
+            iov[n_iov].iov_len = b->size;
+            total += b->size;
+            n_iov++;
+        }
+
+        n = writev(s->fd, iov, n_iov);
+        if (n < 0) {
+            return errno == EAGAIN || errno == EINTR ? 0 : errno;
+        }
+
+        s->tx_bytes -= n;
+        while (n > 0) {
+            b = s->txq.head;
+            if (n < b->size) {
+                ofpbuf_pull(b, n);
+                break;
+            }
+            n -= b->size;
+            ofpbuf_delete(queue_pop_head(&s->txq));
+        }
+        if (n < total) {
+            /* Short write: the socket buffer is full. */
+            return 0;
+        }
+    }
+    return 0;
+}
+
 static void
 stream_do_tx(int fd UNUSED, short int revents UNUSED, void *vconn_)
 {
     struct vconn *vconn = vconn_;
     struct stream_vconn *s = stream_vconn_cast(vconn);
-    ssize_t n = write(s->fd, s->txbuf->data, s->txbuf->size);
-    if (n < 0) {
-        if (errno != EAGAIN) {
-            VLOG_ERR_RL(&rl, "send: %s", strerror(errno));
-            stream_clear_txbuf(s);
-            return;
-        }
-    } else if (n > 0) {
-        ofpbuf_pull(s->txbuf, n);
-        if (!s->txbuf->size) {
-            stream_clear_txbuf(s);
-            return;
-        }
+    int error;
+
+    s->tx_waiter = NULL;
+    error = stream_flush(s);
+    if (error) {
+        /* The queued messages are lost.  Report the error from the next
+         * stream_send() or stream_recv(), so that the connection is
+         * dropped. */
+        VLOG_ERR_RL(&rl, "send: %s", strerror(error));
+        stream_clear_txq(s);
+        s->tx_error = error;
+    } else if (s->txq.n) {
+        s->tx_waiter = poll_fd_callback(s->fd, POLLOUT, stream_do_tx, vconn);
     }
-    s->tx_waiter = poll_fd_callback(s->fd, POLLOUT, stream_do_tx, vconn);
 }
 
 static int
 stream_send(struct vconn *vconn, struct ofpbuf *buffer)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
-    ssize_t retval;
 
-    if (s->txbuf) {
-        return EAGAIN;
+    if (s->tx_error) {
+        return s->tx_error;
     }
-
-    retval = write(s->fd, buffer->data, buffer->size);
-    if (retval == buffer->size) {
-        ofpbuf_delete(buffer);
-        return 0;
-    } else if (retval >= 0 || errno == EAGAIN) {
-        leak_checker_claim(buffer);
-        s->txbuf = buffer;
-        if (retval > 0) {
-            ofpbuf_pull(buffer, retval);
+    if (s->txq.n && s->tx_bytes + buffer->size > STREAM_TX_MAX) {
+        /* Make room, if the socket will take some of the queue now. */
+        int error = stream_flush(s);
+        if (error) {
+            poll_cancel(s->tx_waiter);
+            stream_clear_txq(s);
+            s->tx_error = error;
+            return error;
         }
+        if (s->txq.n && s->tx_bytes + buffer->size > STREAM_TX_MAX) {
+            return EAGAIN;
+        }
+    }
+
+    queue_push_tail(&s->txq, buffer);
+    s->tx_bytes += buffer->size;
+    if (!s->tx_waiter) {
         s->tx_waiter = poll_fd_callback(s->fd, POLLOUT, stream_do_tx, vconn);
-        return 0;
-    } else {
-        return errno;
     }
+    return 0;
 }
 
 static void
 stream_wait(struct vconn *vconn, enum vconn_wait_type wait)
 {
     struct stream_vconn *s = stream_vconn_cast(vconn);
+
+    if (s->tx_error && wait != WAIT_CONNECT) {
+        /* stream_send() and stream_recv() will report the error at once. */
+        poll_immediate_wake();
+        return;
+    }
     switch (wait) {
     case WAIT_CONNECT:
         poll_fd_wait(s->fd, POLLOUT);
         break;
 
     case WAIT_SEND:
-        if (!s->txbuf) {
+        if (s->tx_bytes < STREAM_TX_MAX) {
             poll_fd_wait(s->fd, POLLOUT);
         } else {
-            /* Nothing to do: need to drain txbuf first. */
+            /* Nothing to do: need to drain txq first. */
         }
         break;
 
     case WAIT_RECV:
-        poll_fd_wait(s->fd, POLLIN);
+        if (s->rxbuf && stream_rx_ready(s->rxbuf)) {
+            /* A message is already buffered. */
+            poll_immediate_wake();
+        } else {
+            poll_fd_wait(s->fd, POLLIN);
+        }
         break;
 
     default:
@@ -315,6 +448,7 @@ static void
 pstream_close(struct pvconn *pvconn)
 {
     struct pstream_pvconn *ps = pstream_pvconn_cast(pvconn);
+    poll_fd_forget(ps->fd);
     close(ps->fd);
     free(ps);
 }
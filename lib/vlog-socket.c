@@ -125,6 +125,7 @@ vlog_server_close(struct vlog_server *server)
 {
     if (server) {
         poll_cancel(server->waiter);
+        poll_fd_forget(server->fd);
         close(server->fd);
         unlink(server->path);
         fatal_signal_remove_file_to_unlink(server->path);
@@ -96,6 +96,11 @@ AC_DEFUN([OFP_CHECK_FAULT_LIBS],
   [AC_CHECK_LIB([dl], [dladdr], [FAULT_LIBS=-ldl])
    AC_SUBST([FAULT_LIBS])])
 
+dnl Checks for libraries needed by the udatapath worker threads.
+AC_DEFUN([OFP_CHECK_PTHREAD_LIBS],
+  [AC_CHECK_LIB([pthread], [pthread_create], [PTHREAD_LIBS=-lpthread])
+   AC_SUBST([PTHREAD_LIBS])])
+
 dnl Checks for libraries needed by lib/socket-util.c.
 AC_DEFUN([OFP_CHECK_SOCKET_LIBS],
   [AC_CHECK_LIB([socket], [connect])
@@ -159,6 +164,7 @@ AC_DEFUN([OFP_CHECK_LIBOPENFLOW],
    AC_REQUIRE([OFP_CHECK_NETLINK])
    AC_REQUIRE([OFP_CHECK_OPENSSL])
    AC_REQUIRE([OFP_CHECK_FAULT_LIBS])
+   AC_REQUIRE([OFP_CHECK_PTHREAD_LIBS])
    AC_REQUIRE([OFP_CHECK_SOCKET_LIBS])
    AC_REQUIRE([OFP_CHECK_PKIDIR])
    AC_REQUIRE([OFP_CHECK_RUNDIR])
@@ -589,6 +589,7 @@ parse_options(int argc, char *argv[], struct settings *s)
         OPT_OUT_OF_BAND,
         OPT_IN_BAND,
         OPT_EMERG_FLOW,
+        OPT_POLL_BACKEND,
         VLOG_OPTION_ENUMS,
         LEAK_CHECKER_OPTION_ENUMS
     };
@@ -608,6 +609,7 @@ parse_options(int argc, char *argv[], struct settings *s)
         {"out-of-band", no_argument, 0, OPT_OUT_OF_BAND},
         {"in-band",     no_argument, 0, OPT_IN_BAND},
         {"emerg-flow",  no_argument, 0, OPT_EMERG_FLOW},
+        {"poll-backend", required_argument, 0, OPT_POLL_BACKEND},
         {"verbose",     optional_argument, 0, 'v'},
         {"help",        no_argument, 0, 'h'},
         {"version",     no_argument, 0, 'V'},
@@ -731,6 +733,17 @@ parse_options(int argc, char *argv[], struct settings *s)
             s->emerg_flow = true;
             break;
 
+        case OPT_POLL_BACKEND: {
+            int error = poll_backend_select(optarg);
+            if (error == ENOENT) {
+                ofp_fatal(0, "unknown poll backend \"%s\"", optarg);
+            } else if (error) {
+                ofp_fatal(error, "poll backend \"%s\" is not available",
+                          optarg);
+            }
+            break;
+        }
+
         case 'l':
             if (s->n_listeners >= MAX_MGMT) {
                 ofp_fatal(0,
@@ -875,6 +888,8 @@ usage(void)
     daemon_usage();
     vlog_usage();
     printf("\nOther options:\n"
+           "  --poll-backend=BACKEND  wait for events with BACKEND (poll or\n"
+           "                          epoll)\n"
            "  -h, --help              display this help message\n"
            "  -V, --version           display version information\n");
     leak_checker_usage();
@@ -158,10 +158,8 @@ static void
 switch_status_cb(struct status_reply *sr, void *ss_)
 {
     struct switch_status *ss = ss_;
-    time_t now = time_now();
-
-    status_reply_put(sr, "now=%ld", (long int) now);
-    status_reply_put(sr, "uptime=%ld", (long int) (now - ss->booted));
+    status_reply_put(sr, "now=%ld", (long int) time_wall());
+    status_reply_put(sr, "uptime=%ld", (long int) (time_now() - ss->booted));
     status_reply_put(sr, "pid=%ld", (long int) getpid());
 }
 
@@ -1,3 +1,26 @@
+TESTS += tests/test-aggregate-stats
+noinst_PROGRAMS += tests/test-aggregate-stats
+tests_test_aggregate_stats_SOURCES = \
+	tests/test-aggregate-stats.c \
+	udatapath/chain.c \
+	udatapath/crc32.c \
+	udatapath/datapath.c \
+	udatapath/dp_act.c \
+	udatapath/flow-hash.c \
+	udatapath/flow-index.c \
+	udatapath/flow-wheel.c \
+	udatapath/of_ext_msg.c \
+	udatapath/pkt-buffer.c \
+	udatapath/private-msg.c \
+	udatapath/switch-flow.c \
+	udatapath/table-hash.c \
+	udatapath/table-hmap.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_test_aggregate_stats_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_test_aggregate_stats_LDADD = lib/libopenflow.a $(SSL_LIBS) \
+	$(FAULT_LIBS) $(PTHREAD_LIBS)
+
 TESTS += tests/test-flows.sh
 noinst_PROGRAMS += tests/test-flows
 tests_test_flows_SOURCES = tests/test-flows.c
@@ -14,6 +37,30 @@ noinst_PROGRAMS += tests/test-list
 tests_test_list_SOURCES = tests/test-list.c
 tests_test_list_LDADD = lib/libopenflow.a
 
+TESTS += tests/test-ofp-print
+noinst_PROGRAMS += tests/test-ofp-print
+tests_test_ofp_print_SOURCES = tests/test-ofp-print.c
+tests_test_ofp_print_LDADD = lib/libopenflow.a
+
+TESTS += tests/test-vconn-stream
+noinst_PROGRAMS += tests/test-vconn-stream
+tests_test_vconn_stream_SOURCES = tests/test-vconn-stream.c
+tests_test_vconn_stream_LDADD = lib/libopenflow.a $(SSL_LIBS)
+
+TESTS += tests/test-table-tss
+noinst_PROGRAMS += tests/test-table-tss
+tests_test_table_tss_SOURCES = \
+	tests/test-table-tss.c \
+	udatapath/crc32.c \
+	udatapath/flow-hash.c \
+	udatapath/flow-index.c \
+	udatapath/flow-wheel.c \
+	udatapath/switch-flow.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_test_table_tss_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_test_table_tss_LDADD = lib/libopenflow.a
+
 TESTS += tests/test-type-props
 noinst_PROGRAMS += tests/test-type-props
 tests_test_type_props_SOURCES = tests/test-type-props.c
@@ -44,3 +91,63 @@ stp_files = \
 TESTS_ENVIRONMENT += stp_files='$(stp_files)'
 
 EXTRA_DIST += $(stp_files)
+
+noinst_PROGRAMS += tests/bench-flow-hash
+tests_bench_flow_hash_SOURCES = \
+	tests/bench-flow-hash.c \
+	udatapath/crc32.c \
+	udatapath/flow-hash.c
+tests_bench_flow_hash_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_bench_flow_hash_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-flow-match
+tests_bench_flow_match_SOURCES = \
+	tests/bench-flow-match.c \
+	udatapath/switch-flow.c
+tests_bench_flow_match_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_bench_flow_match_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-flow-mod
+tests_bench_flow_mod_SOURCES = \
+	tests/bench-flow-mod.c \
+	udatapath/chain.c \
+	udatapath/crc32.c \
+	udatapath/flow-hash.c \
+	udatapath/flow-index.c \
+	udatapath/flow-wheel.c \
+	udatapath/switch-flow.c \
+	udatapath/table-hmap.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_bench_flow_mod_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_bench_flow_mod_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-flow-extract
+tests_bench_flow_extract_SOURCES = tests/bench-flow-extract.c
+tests_bench_flow_extract_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-poll-loop
+tests_bench_poll_loop_SOURCES = tests/bench-poll-loop.c
+tests_bench_poll_loop_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-flow-dump
+tests_bench_flow_dump_SOURCES = \
+	tests/bench-flow-dump.c \
+	udatapath/chain.c \
+	udatapath/crc32.c \
+	udatapath/datapath.c \
+	udatapath/dp_act.c \
+	udatapath/flow-hash.c \
+	udatapath/flow-index.c \
+	udatapath/flow-wheel.c \
+	udatapath/of_ext_msg.c \
+	udatapath/pkt-buffer.c \
+	udatapath/private-msg.c \
+	udatapath/switch-flow.c \
+	udatapath/table-hash.c \
+	udatapath/table-hmap.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_bench_flow_dump_CPPFLAGS = $(AM_CPPFLAGS) -I $(top_srcdir)/udatapath
+tests_bench_flow_dump_LDADD = lib/libopenflow.a $(SSL_LIBS) $(FAULT_LIBS) \
+	$(PTHREAD_LIBS)
@@ -0,0 +1,266 @@
+/* Measures how long the datapath takes to dump its entire flow table with
+ * 10,000 and with 100,000 flows installed.  For each table size the benchmark
+ * forks a datapath, inserts exact-match flows directly into its chain, and
+ * then times full-table OFPST_FLOW requests sent to it over a Unix domain
+ * socket.  The datapath runs in its own process so that the reply sizing in
+ * stats_dump() sees a controller that reads concurrently.
+ *
+ * Usage: bench-flow-dump [N_DUMPS] */
+
+#include <config.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include "chain.h"
+#include "datapath.h"
+#include "ofpbuf.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "poll-loop.h"
+#include "switch-flow.h"
+#include "timeval.h"
+#include "util.h"
+#include "vconn.h"
+#include "vlog.h"
+
+/* datapath.c reports these in OFPST_DESC replies.  ofdatapath defines them
+ * in udatapath.c, which this benchmark does not link. */
+char mfr_desc[DESC_STR_LEN] = "Stanford University";
+char hw_desc[DESC_STR_LEN] = "Reference Userspace Switch";
+char sw_desc[DESC_STR_LEN] = VERSION BUILDNR;
+char dp_desc[DESC_STR_LEN] = "bench-flow-dump";
+char serial_num[SERIAL_NUM_LEN] = "None";
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Inserts 'n_flows' exact-match flows into 'dp'. */
+static void
+add_flows(struct datapath *dp, unsigned int n_flows)
+{
+    unsigned int i;
+
+    for (i = 0; i < n_flows; i++) {
+        struct ofp_action_output action;
+        struct sw_flow *flow;
+        struct flow *f;
+
+        flow = flow_alloc(sizeof action);
+        f = &flow->key.flow;
+        f->in_port = htons(1);
+        f->dl_vlan = htons(OFP_VLAN_NONE);
+        f->dl_type = htons(ETH_TYPE_IP);
+        f->nw_src = htonl(0x0a000001);
+        f->nw_dst = htonl(0x0b000000 | i);
+        f->nw_proto = IP_TYPE_UDP;
+        f->tp_src = htons(1000);
+        f->tp_dst = htons(2000);
+        flow->key.wildcards = 0;
+        flow->priority = OFP_DEFAULT_PRIORITY;
+        flow_key_set_mask(&flow->key);
+
+        memset(&action, 0, sizeof action);
+        action.type = htons(OFPAT_OUTPUT);
+        action.len = htons(sizeof action);
+        action.port = htons(OFPP_CONTROLLER);
+        flow_setup_actions(flow, (struct ofp_action_header *) &action,
+                           sizeof action);
+        if (chain_insert(dp->chain, flow, 0)) {
+            ofp_fatal(0, "failed to insert flow %u", i);
+        }
+    }
+}
+
+/* Creates a datapath with 'n_flows' flows that listens on 'name', writes a
+ * byte to 'ready_fd' once it is listening, and then runs it until killed. */
+static void NO_RETURN
+run_datapath(const char *name, unsigned int n_flows, int ready_fd)
+{
+    struct pvconn *pvconn;
+    struct datapath *dp;
+    int error;
+
+    error = dp_new(&dp, UINT64_MAX);
+    if (error) {
+        ofp_fatal(error, "could not create datapath");
+    }
+    error = pvconn_open(name, &pvconn);
+    if (error) {
+        ofp_fatal(error, "%s: listen failed", name);
+    }
+    dp_add_pvconn(dp, pvconn);
+    add_flows(dp, n_flows);
+
+    if (write(ready_fd, "", 1) != 1) {
+        ofp_fatal(errno, "write to parent failed");
+    }
+    close(ready_fd);
+
+    for (;;) {
+        dp_run(dp);
+        dp_wait(dp);
+        poll_block();
+    }
+}
+
+/* Forks a datapath with 'n_flows' flows that listens on 'name' and waits
+ * until it is ready.  Returns its process ID. */
+static pid_t
+start_datapath(const char *name, unsigned int n_flows)
+{
+    int fds[2];
+    pid_t pid;
+    char c;
+
+    if (pipe(fds)) {
+        ofp_fatal(errno, "pipe failed");
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        ofp_fatal(errno, "fork failed");
+    } else if (!pid) {
+        close(fds[0]);
+        run_datapath(name, n_flows, fds[1]);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], &c, 1) != 1) {
+        ofp_fatal(0, "datapath exited before it was ready");
+    }
+    close(fds[0]);
+    return pid;
+}
+
+static void
+stop_datapath(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+static void
+send_or_die(struct vconn *vconn, struct ofpbuf *buffer)
+{
+    int error = vconn_send_block(vconn, buffer);
+    if (error) {
+        ofp_fatal(error, "%s: send failed", vconn_get_name(vconn));
+    }
+}
+
+/* Dumps every flow and reports how long it took. */
+static void
+dump_flows(struct vconn *vconn, unsigned int n_flows)
+{
+    struct ofp_flow_stats_request *fsr;
+    struct ofp_stats_request *osr;
+    unsigned long long int n_bytes = 0;
+    unsigned int n_replies = 0;
+    unsigned int n_entries = 0;
+    struct ofpbuf *request;
+    uint32_t xid;
+    double start;
+    bool more;
+
+    osr = make_openflow(sizeof *osr + sizeof *fsr, OFPT_STATS_REQUEST,
+                        &request);
+    osr->type = htons(OFPST_FLOW);
+    fsr = (struct ofp_flow_stats_request *) osr->body;
+    fsr->match.wildcards = htonl(OFPFW_ALL);
+    fsr->table_id = 0xff;
+    fsr->out_port = htons(OFPP_NONE);
+    xid = osr->header.xid;
+
+    start = now();
+    send_or_die(vconn, request);
+    do {
+        struct flow_stats_iterator iter;
+        const struct ofp_flow_stats *fs;
+        struct ofp_stats_reply *rpy;
+        struct ofpbuf *reply;
+        int error;
+
+        error = vconn_recv_xid(vconn, xid, &reply);
+        if (error) {
+            ofp_fatal(error, "%s: receive failed", vconn_get_name(vconn));
+        }
+        rpy = reply->data;
+        if (reply->size < sizeof *rpy || rpy->header.type != OFPT_STATS_REPLY) {
+            ofp_fatal(0, "%s: unexpected reply", vconn_get_name(vconn));
+        }
+        for (fs = flow_stats_first(&iter, rpy); fs;
+             fs = flow_stats_next(&iter)) {
+            n_entries++;
+        }
+        more = (ntohs(rpy->flags) & OFPSF_REPLY_MORE) != 0;
+        n_replies++;
+        n_bytes += reply->size;
+        ofpbuf_delete(reply);
+    } while (more);
+
+    if (n_entries != n_flows) {
+        ofp_fatal(0, "dumped %u flows, expected %u", n_entries, n_flows);
+    }
+    printf("%-8u %12.1f %10u %14.0f\n", n_flows, (now() - start) * 1e3,
+           n_replies, (double) n_bytes / n_replies);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const unsigned int sizes[] = { 10000, 100000 };
+    char dir[] = "/tmp/bench-flow-dump.XXXXXX";
+    char *sock_name, *listen_name, *connect_name;
+    int n_dumps;
+    size_t i;
+
+    set_program_name(argv[0]);
+    time_init();
+    vlog_init();
+    n_dumps = argc > 1 ? atoi(argv[1]) : 3;
+
+    if (!mkdtemp(dir)) {
+        ofp_fatal(errno, "%s: mkdtemp failed", dir);
+    }
+    sock_name = xasprintf("%s/sock", dir);
+    listen_name = xasprintf("punix:%s", sock_name);
+    connect_name = xasprintf("unix:%s", sock_name);
+
+    printf("%-8s %12s %10s %14s\n", "flows", "dump ms", "replies",
+           "bytes/reply");
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        struct vconn *vconn;
+        pid_t pid;
+        int error;
+        int j;
+
+        pid = start_datapath(listen_name, sizes[i]);
+        error = vconn_open_block(connect_name, OFP_VERSION, &vconn);
+        if (error) {
+            ofp_fatal(error, "%s: connection failed", connect_name);
+        }
+        for (j = 0; j < n_dumps; j++) {
+            dump_flows(vconn, sizes[i]);
+        }
+        vconn_close(vconn);
+        stop_datapath(pid);
+    }
+
+    unlink(sock_name);
+    rmdir(dir);
+    free(connect_name);
+    free(listen_name);
+    free(sock_name);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* Measures the speed of flow_extract() in lib/flow.c on a synthetic mix of
+ * frames.
+ *
+ * Usage: bench-flow-extract [N_ITERATIONS] */
+
+#include <config.h>
+#include "flow.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "ofpbuf.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "util.h"
+
+enum frame_type {
+    FRAME_ARP,
+    FRAME_TCP,
+    FRAME_UDP,
+    FRAME_ICMP,
+    FRAME_VLAN_TCP,
+    FRAME_FRAGMENT,
+    N_FRAME_TYPES
+};
+
+static const char *const frame_names[N_FRAME_TYPES] = {
+    "arp", "tcp", "udp", "icmp", "vlan-tcp", "fragment"
+};
+
+#define N_PACKETS (N_FRAME_TYPES * 64) /* Number of distinct frames. */
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+put_ip(struct ofpbuf *b, uint8_t proto, uint16_t frag_off)
+{
+    struct ip_header *ip = ofpbuf_put_zeros(b, sizeof *ip);
+    ip->ip_ihl_ver = IP_IHL_VER(5, IP_VERSION);
+    ip->ip_tot_len = htons(64);
+    ip->ip_frag_off = htons(frag_off);
+    ip->ip_ttl = 64;
+    ip->ip_proto = proto;
+    ip->ip_src = htonl(0x0a000000 | random());
+    ip->ip_dst = htonl(0x0a000000 | random());
+}
+
+static void
+put_tcp(struct ofpbuf *b)
+{
+    struct tcp_header *tcp = ofpbuf_put_zeros(b, sizeof *tcp);
+    tcp->tcp_src = htons(random());
+    tcp->tcp_dst = htons(80);
+    tcp->tcp_ctl = htons((5 << 12) | TCP_ACK);
+}
+
+static struct ofpbuf *
+make_frame(enum frame_type type)
+{
+    struct ofpbuf *b = ofpbuf_new(128);
+    struct eth_header *eth = ofpbuf_put_zeros(b, sizeof *eth);
+
+    eth->eth_src[5] = random();
+    eth->eth_dst[5] = random();
+    eth->eth_type = htons(ETH_TYPE_IP);
+    switch (type) {
+    case FRAME_ARP: {
+        struct arp_eth_header *arp = ofpbuf_put_zeros(b, sizeof *arp);
+        eth->eth_type = htons(ETH_TYPE_ARP);
+        arp->ar_hrd = htons(ARP_HRD_ETHERNET);
+        arp->ar_pro = htons(ARP_PRO_IP);
+        arp->ar_hln = ETH_ADDR_LEN;
+        arp->ar_pln = IP_ADDR_LEN;
+        arp->ar_op = htons(ARP_OP_REQUEST);
+        arp->ar_spa = htonl(0x0a000000 | random());
+        arp->ar_tpa = htonl(0x0a000000 | random());
+        break;
+    }
+    case FRAME_TCP:
+        put_ip(b, IP_TYPE_TCP, 0);
+        put_tcp(b);
+        break;
+    case FRAME_UDP: {
+        struct udp_header *udp;
+        put_ip(b, IP_TYPE_UDP, 0);
+        udp = ofpbuf_put_zeros(b, sizeof *udp);
+        udp->udp_src = htons(random());
+        udp->udp_dst = htons(53);
+        break;
+    }
+    case FRAME_ICMP: {
+        struct icmp_header *icmp;
+        put_ip(b, IP_TYPE_ICMP, 0);
+        icmp = ofpbuf_put_zeros(b, sizeof *icmp);
+        icmp->icmp_type = 8;
+        break;
+    }
+    case FRAME_VLAN_TCP: {
+        struct vlan_header *vh;
+        eth->eth_type = htons(ETH_TYPE_VLAN);
+        vh = ofpbuf_put_zeros(b, sizeof *vh);
+        vh->vlan_tci = htons(random() & VLAN_VID_MASK);
+        vh->vlan_next_type = htons(ETH_TYPE_IP);
+        put_ip(b, IP_TYPE_TCP, 0);
+        put_tcp(b);
+        break;
+    }
+    case FRAME_FRAGMENT:
+        put_ip(b, IP_TYPE_UDP, IP_MORE_FRAGMENTS | (random() & 0xff));
+        break;
+    case N_FRAME_TYPES:
+        NOT_REACHED();
+    }
+    ofpbuf_put_zeros(b, 64 - b->size % 64);
+    return b;
+}
+
+/* Extracts flows from the 'n' packets in 'packets', 'n_iter' times in total,
+ * and returns the average time taken per packet, in nanoseconds. */
+static double
+time_extract(struct ofpbuf *packets[], size_t n, unsigned long n_iter,
+             uint32_t *sum)
+{
+    double start = now();
+    unsigned long i;
+
+    for (i = 0; i < n_iter; i++) {
+        struct flow flow;
+        *sum += flow_extract(packets[i % n], 1, &flow);
+        *sum += flow.nw_src ^ flow.tp_src ^ flow.dl_type;
+    }
+    return (now() - start) * 1e9 / n_iter;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct ofpbuf *packets[N_PACKETS];
+    unsigned long n_iter;
+    uint32_t sum = 0;
+    double ns;
+    int i;
+
+    set_program_name(argv[0]);
+    n_iter = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    /* packets[] interleaves the frame types, so each type's frames are at
+     * indexes congruent modulo N_FRAME_TYPES. */
+    for (i = 0; i < N_PACKETS; i++) {
+        packets[i] = make_frame(i % N_FRAME_TYPES);
+    }
+
+    printf("%-10s %12s\n", "frames", "ns/packet");
+    for (i = 0; i < N_FRAME_TYPES; i++) {
+        struct ofpbuf *same[N_PACKETS / N_FRAME_TYPES];
+        int j;
+
+        for (j = 0; j < ARRAY_SIZE(same); j++) {
+            same[j] = packets[j * N_FRAME_TYPES + i];
+        }
+        ns = time_extract(same, ARRAY_SIZE(same), n_iter, &sum);
+        printf("%-10s %12.2f\n", frame_names[i], ns);
+    }
+    ns = time_extract(packets, N_PACKETS, n_iter, &sum);
+    printf("%-10s %12.2f  (%08"PRIx32")\n", "mix", ns, sum);
+
+    for (i = 0; i < N_PACKETS; i++) {
+        ofpbuf_delete(packets[i]);
+    }
+    return 0;
+}
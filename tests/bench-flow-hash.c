@@ -0,0 +1,88 @@
+/* Measures the speed of each flow hash implementation in udatapath/flow-hash.c.
+ *
+ * Usage: bench-flow-hash [N_ITERATIONS] */
+
+#include <config.h>
+#include "flow-hash.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "flow.h"
+#include "util.h"
+
+#define N_FLOWS 1024            /* Number of distinct keys to hash. */
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+make_flows(struct flow flows[], size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        struct flow *f = &flows[i];
+        memset(f, 0, sizeof *f);
+        f->nw_src = htonl(0x0a000000 | random());
+        f->nw_dst = htonl(0x0a000000 | random());
+        f->in_port = htons(random() % 48);
+        f->dl_type = htons(0x0800);
+        f->nw_proto = 6;
+        f->tp_src = htons(random());
+        f->tp_dst = htons(80);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct flow_hash_impl *const *impl;
+    struct flow *flows;
+    unsigned long n_iter;
+
+    set_program_name(argv[0]);
+    n_iter = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    flows = xmalloc(N_FLOWS * sizeof *flows);
+    make_flows(flows, N_FLOWS);
+
+    printf("%-10s %12s %12s\n", "hash", "ns/hash", "ns/hash2");
+    for (impl = flow_hash_impls; *impl; impl++) {
+        uint32_t sum = 0;
+        double start, t1, t2;
+        unsigned long i;
+
+        if (!(*impl)->available()) {
+            printf("%-10s %12s %12s\n", (*impl)->name, "n/a", "n/a");
+            continue;
+        }
+        flow_hash_select((*impl)->name);
+
+        start = now();
+        for (i = 0; i < n_iter; i++) {
+            sum += flow_hash_key(&flows[i % N_FLOWS]);
+        }
+        t1 = now() - start;
+
+        start = now();
+        for (i = 0; i < n_iter; i++) {
+            uint32_t hashes[2];
+            flow_hash_key2(&flows[i % N_FLOWS], hashes);
+            sum += hashes[0] ^ hashes[1];
+        }
+        t2 = now() - start;
+
+        printf("%-10s %12.2f %12.2f  (%08"PRIx32")\n", (*impl)->name,
+               t1 * 1e9 / n_iter, t2 * 1e9 / n_iter, sum);
+    }
+    free(flows);
+    return 0;
+}
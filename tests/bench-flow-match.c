@@ -0,0 +1,141 @@
+/* Measures the speed of wildcard flow matching in udatapath/switch-flow.c,
+ * against a field-by-field comparison like the one it replaced.
+ *
+ * Usage: bench-flow-match [N_ITERATIONS] */
+
+#include <config.h>
+#include "switch-flow.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "flow.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "util.h"
+
+#define N_KEYS 1024             /* Number of distinct keys to compare. */
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Compares 'a' with 'b' modulo the wildcards in 'b', one field at a time. */
+static int
+match_by_field(const struct sw_flow_key *a, const struct sw_flow_key *b)
+{
+    const struct flow *fa = &a->flow, *fb = &b->flow;
+    uint32_t w = b->wildcards;
+
+    return ((w & OFPFW_IN_PORT || fa->in_port == fb->in_port)
+            && (w & OFPFW_DL_VLAN || fa->dl_vlan == fb->dl_vlan)
+            && (w & OFPFW_DL_VLAN_PCP || fa->dl_vlan_pcp == fb->dl_vlan_pcp)
+            && (w & OFPFW_DL_SRC || eth_addr_equals(fa->dl_src, fb->dl_src))
+            && (w & OFPFW_DL_DST || eth_addr_equals(fa->dl_dst, fb->dl_dst))
+            && (w & OFPFW_DL_TYPE || fa->dl_type == fb->dl_type)
+            && (w & OFPFW_NW_TOS || fa->nw_tos == fb->nw_tos)
+            && (w & OFPFW_NW_PROTO || fa->nw_proto == fb->nw_proto)
+            && !((fa->nw_src ^ fb->nw_src) & b->mask.nw_src)
+            && !((fa->nw_dst ^ fb->nw_dst) & b->mask.nw_dst)
+            && (w & OFPFW_TP_SRC || fa->tp_src == fb->tp_src)
+            && (w & OFPFW_TP_DST || fa->tp_dst == fb->tp_dst));
+}
+
+/* Fills 'packets' with packet keys and 'rules' with wildcarded keys, each
+ * rule taken from a packet, so that about half of the comparisons between
+ * packets[i] and rules[i] succeed and the rest fail at varying fields. */
+static void
+make_keys(struct sw_flow_key packets[], struct sw_flow_key rules[], size_t n)
+{
+    static const uint32_t shapes[] = {
+        OFPFW_ALL & ~OFPFW_IN_PORT,
+        OFPFW_ALL & ~(OFPFW_DL_TYPE | OFPFW_NW_DST_MASK),
+        OFPFW_ALL & ~(OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_TP_DST),
+        OFPFW_ALL & ~(OFPFW_DL_SRC | OFPFW_DL_DST),
+        OFPFW_NW_TOS | OFPFW_DL_VLAN_PCP,
+    };
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        struct sw_flow_key *p = &packets[i];
+        struct sw_flow_key *r = &rules[i];
+        struct flow *f = &p->flow;
+        struct ofp_match match;
+        uint32_t w;
+
+        memset(p, 0, sizeof *p);
+        f->nw_src = htonl(0x0a000000 | random());
+        f->nw_dst = htonl(0x0a000000 | random());
+        f->in_port = htons(random() % 48);
+        f->dl_vlan = htons(OFP_VLAN_NONE);
+        f->dl_type = htons(ETH_TYPE_IP);
+        f->nw_proto = IP_TYPE_TCP;
+        f->tp_src = htons(random());
+        f->tp_dst = htons(80);
+        f->dl_src[5] = random();
+        f->dl_dst[5] = random();
+
+        w = shapes[i % ARRAY_SIZE(shapes)];
+        if ((w & OFPFW_NW_DST_MASK) != OFPFW_NW_DST_MASK) {
+            w = (w & ~OFPFW_NW_DST_MASK) | (8 << OFPFW_NW_DST_SHIFT);
+        }
+        flow_fill_match(&match, f, w);
+        flow_extract_match(r, &match);
+        if (random() & 1) {
+            /* Make the packet differ from the rule in a significant bit. */
+            r->flow.tp_dst = htons(81);
+            r->flow.nw_dst ^= htonl(0x100);
+            r->flow.in_port ^= htons(1);
+            r->flow.dl_src[5] ^= 1;
+        }
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct sw_flow_key *packets, *rules;
+    unsigned long n_iter, i;
+    unsigned int n1 = 0, n2 = 0;
+    double start, t1, t2;
+
+    set_program_name(argv[0]);
+    n_iter = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    packets = xmalloc(N_KEYS * sizeof *packets);
+    rules = xmalloc(N_KEYS * sizeof *rules);
+    make_keys(packets, rules, N_KEYS);
+
+    for (i = 0; i < N_KEYS; i++) {
+        if (!match_by_field(&packets[i], &rules[i])
+            != !flow_matches_1wild(&packets[i], &rules[i])) {
+            ofp_fatal(0, "key %lu: matchers disagree", i);
+        }
+    }
+
+    start = now();
+    for (i = 0; i < n_iter; i++) {
+        n1 += match_by_field(&packets[i % N_KEYS], &rules[i % N_KEYS]);
+    }
+    t1 = now() - start;
+
+    start = now();
+    for (i = 0; i < n_iter; i++) {
+        n2 += flow_matches_1wild(&packets[i % N_KEYS], &rules[i % N_KEYS]);
+    }
+    t2 = now() - start;
+
+    printf("%-10s %12s %10s\n", "match", "ns/compare", "matches");
+    printf("%-10s %12.2f %10u\n", "by-field", t1 * 1e9 / n_iter, n1);
+    printf("%-10s %12.2f %10u\n", "masked", t2 * 1e9 / n_iter, n2);
+
+    free(packets);
+    free(rules);
+    return 0;
+}
@@ -0,0 +1,267 @@
+/* Measures the time taken by wildcarded flow_mod requests (non-strict
+ * delete, non-strict modify, and the overlap check) as the flow tables grow,
+ * with and without the indexes in udatapath/flow-index.c.
+ *
+ * Usage: bench-flow-mod [N_REQUESTS] */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include "chain.h"
+#include "datapath.h"
+#include "flow-index.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "switch-flow.h"
+#include "timeval.h"
+#include "util.h"
+
+#define N_PORTS 48              /* Number of distinct switch ports. */
+
+/* Odd-numbered flows match on these fields and wildcard the rest. */
+#define PARTIAL_WILDCARDS (OFPFW_ALL & ~(OFPFW_IN_PORT | OFPFW_DL_DST     \
+                                         | OFPFW_DL_TYPE                  \
+                                         | OFPFW_NW_DST_MASK))
+
+/* The tables report deleted flows to the datapath, which this benchmark
+ * does not have. */
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+}
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint16_t
+flow_in_port(unsigned int i)
+{
+    return 1 + i % N_PORTS;
+}
+
+static uint16_t
+flow_out_port(unsigned int i)
+{
+    return 1 + (i / N_PORTS) % N_PORTS;
+}
+
+static void
+flow_dl_dst(unsigned int i, uint8_t dl_dst[ETH_ADDR_LEN])
+{
+    dl_dst[0] = 0x02;
+    dl_dst[1] = 0x00;
+    dl_dst[2] = i >> 24;
+    dl_dst[3] = i >> 16;
+    dl_dst[4] = i >> 8;
+    dl_dst[5] = i;
+}
+
+/* Returns flow number 'i': an exact-match flow if 'i' is even, otherwise one
+ * that wildcards everything but its input port, Ethernet destination, and
+ * IP destination. */
+static struct sw_flow *
+make_flow(unsigned int i)
+{
+    struct ofp_action_output action;
+    struct sw_flow *flow;
+    struct flow *f;
+
+    flow = flow_alloc(sizeof action);
+    f = &flow->key.flow;
+    f->in_port = htons(flow_in_port(i));
+    flow_dl_dst(i, f->dl_dst);
+    f->dl_type = htons(ETH_TYPE_IP);
+    f->nw_dst = htonl(0x0a000000 | i);
+    if (i % 2) {
+        flow->key.wildcards = PARTIAL_WILDCARDS;
+        flow->priority = OFP_DEFAULT_PRIORITY;
+    } else {
+        f->dl_vlan = htons(OFP_VLAN_NONE);
+        f->dl_src[0] = 0x02;
+        f->nw_src = htonl(0x0a000001);
+        f->nw_proto = IP_TYPE_UDP;
+        f->tp_src = htons(1000);
+        f->tp_dst = htons(2000);
+        flow->key.wildcards = 0;
+        flow->priority = OFP_DEFAULT_PRIORITY;
+    }
+    flow_key_set_mask(&flow->key);
+
+    memset(&action, 0, sizeof action);
+    action.type = htons(OFPAT_OUTPUT);
+    action.len = htons(sizeof action);
+    action.port = htons(flow_out_port(i));
+    flow_setup_actions(flow, (struct ofp_action_header *) &action,
+                       sizeof action);
+    return flow;
+}
+
+static void
+insert_flow(struct sw_chain *chain, unsigned int i)
+{
+    if (chain_insert(chain, make_flow(i), 0)) {
+        ofp_fatal(0, "failed to insert flow %u", i);
+    }
+}
+
+/* Initializes 'key' to wildcard everything, then sets the fields in
+ * 'wildcards' that are not wildcarded from flow number 'i'. */
+static void
+make_key(struct sw_flow_key *key, uint32_t wildcards, unsigned int i)
+{
+    memset(key, 0, sizeof *key);
+    key->wildcards = wildcards;
+    key->flow.in_port = htons(flow_in_port(i));
+    flow_dl_dst(i, key->flow.dl_dst);
+    flow_key_set_mask(key);
+}
+
+struct result {
+    double delete_dst;          /* Delete by in_port and dl_dst. */
+    double delete_port;         /* Delete by out_port. */
+    double modify;              /* Modify by dl_dst. */
+    double conflict;            /* Overlap check by in_port and dl_dst. */
+};
+
+static void
+run(unsigned int n_flows, unsigned long n_requests, struct result *r)
+{
+    const uint32_t dst_wildcards = OFPFW_ALL & ~(OFPFW_IN_PORT
+                                                 | OFPFW_DL_DST);
+    struct ofp_action_output action;
+    struct sw_chain *chain;
+    struct sw_flow_key key;
+    double start, elapsed;
+    unsigned long int i;
+    int n_deleted;
+
+    chain = chain_create(NULL);
+    if (!chain) {
+        ofp_fatal(0, "failed to create chain");
+    }
+    for (i = 0; i < n_flows; i++) {
+        insert_flow(chain, i);
+    }
+
+    /* Each request deletes one flow, which is then put back. */
+    elapsed = 0;
+    for (i = 0; i < n_requests; i++) {
+        unsigned int target = random() % n_flows;
+
+        make_key(&key, dst_wildcards, target);
+        start = now();
+        n_deleted = chain_delete(chain, &key, htons(OFPP_NONE), 0, 0, 0);
+        elapsed += now() - start;
+        if (n_deleted != 1) {
+            ofp_fatal(0, "deleted %d flows, expected 1", n_deleted);
+        }
+        insert_flow(chain, target);
+    }
+    r->delete_dst = elapsed / n_requests;
+
+    /* Each request deletes the 1/N_PORTS of the flows that output to one
+     * port, which are then put back. */
+    elapsed = 0;
+    for (i = 0; i < n_requests; i++) {
+        uint16_t port = flow_out_port(random() % n_flows);
+        unsigned int j;
+
+        make_key(&key, OFPFW_ALL, 0);
+        start = now();
+        n_deleted = chain_delete(chain, &key, htons(port), 0, 0, 0);
+        elapsed += now() - start;
+        for (j = 0; j < n_flows; j++) {
+            if (flow_out_port(j) == port) {
+                insert_flow(chain, j);
+                n_deleted--;
+            }
+        }
+        if (n_deleted) {
+            ofp_fatal(0, "deleted the wrong number of flows");
+        }
+    }
+    r->delete_port = elapsed / n_requests;
+
+    /* Each request rewrites the actions of the flow with one destination. */
+    memset(&action, 0, sizeof action);
+    action.type = htons(OFPAT_OUTPUT);
+    action.len = htons(sizeof action);
+    action.port = htons(OFPP_FLOOD);
+    elapsed = 0;
+    for (i = 0; i < n_requests; i++) {
+        make_key(&key, OFPFW_ALL & ~OFPFW_DL_DST, random() % n_flows);
+        start = now();
+        chain_modify(chain, &key, 0, 0,
+                     (struct ofp_action_header *) &action, sizeof action, 0);
+        elapsed += now() - start;
+    }
+    r->modify = elapsed / n_requests;
+
+    /* Each request checks for an overlapping flow at a priority that no flow
+     * has, so it never stops early. */
+    elapsed = 0;
+    for (i = 0; i < n_requests; i++) {
+        make_key(&key, dst_wildcards, random() % n_flows);
+        start = now();
+        if (chain_has_conflict(chain, &key, 1, 0)) {
+            ofp_fatal(0, "unexpected conflict");
+        }
+        elapsed += now() - start;
+    }
+    r->conflict = elapsed / n_requests;
+
+    chain_destroy(chain);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const unsigned int sizes[] = { 1000, 10000, 100000 };
+    struct result indexed[ARRAY_SIZE(sizes)];
+    struct result scanned[ARRAY_SIZE(sizes)];
+    unsigned long n_requests;
+    size_t i;
+
+    set_program_name(argv[0]);
+    time_init();
+    n_requests = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        srandom(1);
+        run(sizes[i], n_requests, &indexed[i]);
+    }
+    flow_index_disable();
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        srandom(1);
+        run(sizes[i], n_requests, &scanned[i]);
+    }
+
+    printf("%-8s %-22s %12s %12s\n",
+           "flows", "request", "indexed us", "scan us");
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        const struct result *a = &indexed[i];
+        const struct result *b = &scanned[i];
+
+        printf("%-8u %-22s %12.2f %12.2f\n", sizes[i],
+               "delete in_port,dl_dst", a->delete_dst * 1e6,
+               b->delete_dst * 1e6);
+        printf("%-8u %-22s %12.2f %12.2f\n", sizes[i],
+               "delete out_port", a->delete_port * 1e6,
+               b->delete_port * 1e6);
+        printf("%-8u %-22s %12.2f %12.2f\n", sizes[i],
+               "modify dl_dst", a->modify * 1e6, b->modify * 1e6);
+        printf("%-8u %-22s %12.2f %12.2f\n", sizes[i],
+               "overlap in_port,dl_dst", a->conflict * 1e6,
+               b->conflict * 1e6);
+    }
+    return 0;
+}
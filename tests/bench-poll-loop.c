@@ -0,0 +1,114 @@
+/* Measures the cost of one poll_block() call with each poll loop backend, as
+ * the number of file descriptors being waited on grows.  Each iteration waits
+ * for input on every descriptor, makes one of them readable, and blocks.
+ *
+ * Usage: bench-poll-loop [N_ITERATIONS] */
+
+#include <config.h>
+#include "poll-loop.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "timeval.h"
+#include "util.h"
+
+static double
+now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Makes sure that at least 'n' file descriptors may be open at once. */
+static void
+raise_fd_limit(rlim_t n)
+{
+    struct rlimit rl;
+
+    if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < n) {
+        rl.rlim_cur = rl.rlim_max < n ? rl.rlim_max : n;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+/* Runs 'n_iter' iterations over 'n_fds' socket pairs and returns the average
+ * time per iteration in seconds. */
+static double
+run(int n_fds, unsigned long n_iter)
+{
+    int (*fds)[2] = xmalloc(n_fds * sizeof *fds);
+    unsigned long i;
+    double start;
+    int j;
+
+    for (j = 0; j < n_fds; j++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds[j])) {
+            ofp_fatal(errno, "socketpair");
+        }
+    }
+
+    start = now();
+    for (i = 0; i < n_iter; i++) {
+        int k = random() % n_fds;
+        char c = 0;
+
+        for (j = 0; j < n_fds; j++) {
+            poll_fd_wait(fds[j][0], POLLIN);
+        }
+        if (write(fds[k][1], &c, 1) != 1) {
+            ofp_fatal(errno, "write failed");
+        }
+        poll_block();
+        if (read(fds[k][0], &c, 1) != 1) {
+            ofp_fatal(errno, "read failed");
+        }
+    }
+    start = now() - start;
+
+    for (j = 0; j < n_fds; j++) {
+        poll_fd_forget(fds[j][0]);
+        close(fds[j][0]);
+        close(fds[j][1]);
+    }
+    free(fds);
+    return start / n_iter;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const char *backends[] = { "poll", "epoll" };
+    static const int sizes[] = { 10, 100, 1000 };
+    unsigned long n_iter;
+    size_t i, j;
+
+    set_program_name(argv[0]);
+    time_init();
+    n_iter = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    raise_fd_limit(2 * 1000 + 64);
+
+    printf("%-8s", "backend");
+    for (j = 0; j < ARRAY_SIZE(sizes); j++) {
+        printf(" %8d fds", sizes[j]);
+    }
+    printf("   (ns/iteration)\n");
+
+    for (i = 0; i < ARRAY_SIZE(backends); i++) {
+        printf("%-8s", backends[i]);
+        if (poll_backend_select(backends[i])) {
+            printf(" %12s\n", "n/a");
+            continue;
+        }
+        for (j = 0; j < ARRAY_SIZE(sizes); j++) {
+            printf(" %12.0f", run(sizes[j], n_iter) * 1e9);
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+    return 0;
+}
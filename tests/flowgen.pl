@@ -18,19 +18,19 @@ print PACKETS pack('NnnNNNN',
 
 output(DL_HEADER => '802.2');
 
-for my $dl_header qw(802.2+SNAP Ethernet) {
+for my $dl_header (qw(802.2+SNAP Ethernet)) {
     my %a = (DL_HEADER => $dl_header);
-    for my $dl_vlan qw(none zero nonzero) {
+    for my $dl_vlan (qw(none zero nonzero)) {
         my %b = (%a, DL_VLAN => $dl_vlan);
 
         # Non-IP case.
         output(%b, DL_TYPE => 'non-ip');
 
-        for my $ip_options qw(no yes) {
+        for my $ip_options (qw(no yes)) {
             my %c = (%b, DL_TYPE => 'ip', IP_OPTIONS => $ip_options);
-            for my $ip_fragment qw(no first middle last) {
+            for my $ip_fragment (qw(no first middle last)) {
                 my %d = (%c, IP_FRAGMENT => $ip_fragment);
-                for my $tp_proto qw(TCP TCP+options UDP ICMP other) {
+                for my $tp_proto (qw(TCP TCP+options UDP ICMP other)) {
                     output(%d, TP_PROTO => $tp_proto);
                 }
             }
@@ -189,9 +189,11 @@ sub output {
                      0);        # in_port
     print FLOWS pack_ethaddr($flow{DL_SRC});
     print FLOWS pack_ethaddr($flow{DL_DST});
-    print FLOWS pack('nnCxNNnn',
+    print FLOWS pack('nCxnCCxxNNnn',
                      $flow{DL_VLAN},
+                     0,         # dl_vlan_pcp
                      $flow{DL_TYPE},
+                     0,         # nw_tos
                      $flow{NW_PROTO},
                      inet_aton($flow{NW_SRC}),
                      inet_aton($flow{NW_DST}),
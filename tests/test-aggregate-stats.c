@@ -0,0 +1,215 @@
+/* Tests that the datapath adds up aggregate flow statistics over several trips
+ * through its main loop, however many of the flows the request selects.  The
+ * test runs a datapath in-process with a large flow table, sends it aggregate
+ * requests over a Unix domain socket, and counts the trips through the main
+ * loop that each reply takes. */
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "chain.h"
+#include "datapath.h"
+#include "ofpbuf.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "poll-loop.h"
+#include "switch-flow.h"
+#include "timeval.h"
+#include "util.h"
+#include "vconn.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define N_FLOWS 50000           /* Flows in the datapath's table. */
+
+/* Fewest trips through the main loop that adding up N_FLOWS flows should
+ * take.  Walking the whole table in one trip takes one or two. */
+#define MIN_PASSES 5
+
+/* datapath.c reports these in OFPST_DESC replies.  ofdatapath defines them
+ * in udatapath.c, which this test does not link. */
+char mfr_desc[DESC_STR_LEN] = "Stanford University";
+char hw_desc[DESC_STR_LEN] = "Reference Userspace Switch";
+char sw_desc[DESC_STR_LEN] = VERSION BUILDNR;
+char dp_desc[DESC_STR_LEN] = "test-aggregate-stats";
+char serial_num[SERIAL_NUM_LEN] = "None";
+
+static struct datapath *dp;
+static struct vconn *vconn;
+
+/* Inserts N_FLOWS exact-match UDP flows that output to port 1 into 'dp'. */
+static void
+add_flows(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < N_FLOWS; i++) {
+        struct ofp_action_output action;
+        struct sw_flow *flow;
+        struct flow *f;
+
+        flow = flow_alloc(sizeof action);
+        assert(flow);
+        f = &flow->key.flow;
+        f->in_port = htons(1);
+        f->dl_vlan = htons(OFP_VLAN_NONE);
+        f->dl_type = htons(ETH_TYPE_IP);
+        f->nw_src = htonl(0x0a000001);
+        f->nw_dst = htonl(0x0b000000 | i);
+        f->nw_proto = IP_TYPE_UDP;
+        f->tp_src = htons(1000);
+        f->tp_dst = htons(2000);
+        flow->key.wildcards = 0;
+        flow->priority = OFP_DEFAULT_PRIORITY;
+        flow_key_set_mask(&flow->key);
+
+        memset(&action, 0, sizeof action);
+        action.type = htons(OFPAT_OUTPUT);
+        action.len = htons(sizeof action);
+        action.port = htons(1);
+        flow_setup_actions(flow, (struct ofp_action_header *) &action,
+                           sizeof action);
+        assert(!chain_insert(dp->chain, flow, 0));
+    }
+}
+
+/* Sends an aggregate stats request for 'wildcards', 'dl_type', and
+ * 'out_port' to 'dp', runs 'dp' until it replies, and checks that the reply
+ * counts 'n_flows' flows.  Returns the number of trips through the main loop
+ * that the reply took. */
+static int
+aggregate(uint32_t wildcards, uint16_t dl_type, uint16_t out_port,
+          unsigned int n_flows)
+{
+    struct ofp_aggregate_stats_request *asr;
+    struct ofp_aggregate_stats_reply *asp;
+    struct ofp_stats_request *osr;
+    struct ofp_stats_reply *rpy;
+    struct ofpbuf *request, *reply;
+    int n_passes;
+    uint32_t xid;
+    int error;
+
+    osr = make_openflow(sizeof *osr + sizeof *asr, OFPT_STATS_REQUEST,
+                        &request);
+    osr->type = htons(OFPST_AGGREGATE);
+    asr = (struct ofp_aggregate_stats_request *) osr->body;
+    asr->match.wildcards = htonl(wildcards);
+    asr->match.dl_type = htons(dl_type);
+    asr->table_id = 0xff;
+    asr->out_port = htons(out_port);
+    xid = osr->header.xid;
+    assert(!vconn_send_block(vconn, request));
+
+    n_passes = 0;
+    for (;;) {
+        assert(n_passes++ < 10000);
+        dp_run(dp);
+        error = vconn_recv(vconn, &reply);
+        if (error != EAGAIN) {
+            break;
+        }
+        dp_wait(dp);
+        vconn_recv_wait(vconn);
+        poll_block();
+    }
+    assert(!error);
+
+    rpy = reply->data;
+    assert(reply->size == sizeof *rpy + sizeof *asp);
+    assert(rpy->header.type == OFPT_STATS_REPLY);
+    assert(rpy->header.xid == xid);
+    assert(!(ntohs(rpy->flags) & OFPSF_REPLY_MORE));
+    asp = (struct ofp_aggregate_stats_reply *) rpy->body;
+    assert(ntohl(asp->flow_count) == n_flows);
+    ofpbuf_delete(reply);
+
+    return n_passes;
+}
+
+/* Tests a request that matches every flow. */
+static void
+test_all_flows(void)
+{
+    assert(aggregate(OFPFW_ALL, 0, OFPP_NONE, N_FLOWS) >= MIN_PASSES);
+}
+
+/* Tests a request whose match selects none of the flows. */
+static void
+test_no_match(void)
+{
+    assert(aggregate(OFPFW_ALL & ~OFPFW_DL_TYPE, ETH_TYPE_ARP, OFPP_NONE, 0)
+           >= MIN_PASSES);
+}
+
+/* Tests a request whose output port selects none of the flows. */
+static void
+test_no_out_port(void)
+{
+    assert(aggregate(OFPFW_ALL, 0, 2, 0) >= MIN_PASSES);
+}
+
+static void
+run_test(void (*function)(void))
+{
+    function();
+    printf(".");
+    fflush(stdout);
+}
+
+int
+main(int argc UNUSED, char *argv[])
+{
+    char dir[] = "/tmp/test-aggregate-stats.XXXXXX";
+    char *sock_name, *listen_name, *connect_name;
+    struct pvconn *pvconn;
+    int n_passes;
+    int error;
+
+    set_program_name(argv[0]);
+    time_init();
+
+    assert(mkdtemp(dir));
+    sock_name = xasprintf("%s/sock", dir);
+    listen_name = xasprintf("punix:%s", sock_name);
+    connect_name = xasprintf("unix:%s", sock_name);
+
+    assert(!dp_new(&dp, UINT64_MAX));
+    assert(!pvconn_open(listen_name, &pvconn));
+    dp_add_pvconn(dp, pvconn);
+    add_flows();
+
+    /* The datapath has to run for the connection to complete. */
+    assert(!vconn_open(connect_name, OFP_VERSION, &vconn));
+    n_passes = 0;
+    for (;;) {
+        assert(n_passes++ < 1000);
+        dp_run(dp);
+        error = vconn_connect(vconn);
+        if (error != EAGAIN) {
+            break;
+        }
+        dp_wait(dp);
+        vconn_connect_wait(vconn);
+        poll_block();
+    }
+    assert(!error);
+
+    run_test(test_all_flows);
+    run_test(test_no_match);
+    run_test(test_no_out_port);
+    printf("\n");
+
+    vconn_close(vconn);
+    unlink(sock_name);
+    rmdir(dir);
+    free(connect_name);
+    free(listen_name);
+    free(sock_name);
+    return 0;
+}
@@ -52,6 +52,7 @@ main(int argc UNUSED, char *argv[])
         }
 
         flow_extract(packet, 0, &flow);
+        memset(&extracted_match, 0, sizeof extracted_match);
         flow_fill_match(&extracted_match, &flow, 0);
 
         if (memcmp(&expected_match, &extracted_match, sizeof expected_match)) {
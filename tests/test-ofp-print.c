@@ -0,0 +1,162 @@
+/* Tests the packet summaries produced by ofp_packet_to_string(). */
+
+#include <config.h>
+#include "ofp-print.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* Ethernet, 802.2, and VLAN headers used to build the test frames. */
+#define ETH_UDP    "000000000002 000000000001 0800"
+#define ETH_BCAST  "ffffffffffff 000000000001"
+#define ETH_LLDP   "0180c200000e 000000000001 88cc"
+#define ETH_802_3  "000000000002 000000000001 003e"
+#define LLC_SNAP   "aaaa03 000000"
+
+/* IPv4 headers from 10.0.0.1 to 10.0.0.2. */
+#define IP_UDP     "4500001c 00010000 4011 0000 0a000001 0a000002"
+#define IP_TCP     "45000028 00010000 4006 0000 0a000001 0a000002"
+
+/* LLDP TLVs: a MAC chassis ID, an interface name port ID, and a TTL. */
+#define LLDP_CHASSIS "0207 04 000000000001"
+#define LLDP_PORT    "0403 05 7031"
+#define LLDP_TTL     "0602 0078"
+
+struct test_case {
+    const char *name;           /* Describes the test case. */
+    const char *hex;            /* Frame, in hex, with optional spaces. */
+    size_t total_len;           /* Original frame length, if nonzero. */
+    const char *expected;       /* Expected ofp_packet_to_string() output. */
+};
+
+static const struct test_case test_cases[] = {
+    { "udp",
+      ETH_UDP IP_UDP "04d2 0050 0008 0000", 60,
+      "00:00:00:00:00:01 > 00:00:00:00:00:02, ethertype IPv4 (0x0800), "
+      "length 60: 10.0.0.1.1234 > 10.0.0.2.80: UDP, length 0\n" },
+
+    { "vlan arp",
+      ETH_BCAST "8100 a00a 0806"
+      "0001 0800 06 04 0001 000000000001 0a000001 000000000000 0a000002", 0,
+      "00:00:00:00:00:01 > ff:ff:ff:ff:ff:ff, ethertype 802.1Q (0x8100), "
+      "length 46: vlan 10, p 5, ethertype ARP (0x0806), "
+      "Request who-has 10.0.0.2 tell 10.0.0.1, length 28\n" },
+
+    { "snap tcp",
+      ETH_802_3 LLC_SNAP "0800" IP_TCP
+      "1f90 0016 00000001 00000000 5002 2000 0000 0000", 0,
+      "00:00:00:00:00:01 > 00:00:00:00:00:02, 802.3, length 62: "
+      "LLC, dsap 0xaa, ssap 0xaa, ctrl 0x03: SNAP, "
+      "ethertype IPv4 (0x0800), length 62: "
+      "10.0.0.1.8080 > 10.0.0.2.22: Flags [S], seq 1, win 8192, length 0\n" },
+
+    { "llc",
+      ETH_802_3 "424203 0000", 0,
+      "00:00:00:00:00:01 > 00:00:00:00:00:02, 802.3, length 19: "
+      "LLC, dsap 0x42, ssap 0x42, ctrl 0x03: [|stp]\n" },
+
+    { "lldp",
+      ETH_LLDP LLDP_CHASSIS LLDP_PORT LLDP_TTL "0000", 0,
+      "00:00:00:00:00:01 > 01:80:c2:00:00:0e, ethertype LLDP (0x88cc), "
+      "length 34: LLDP, chassis id 00:00:00:00:00:01, port id \"p1\", "
+      "ttl 120\n" },
+
+    /* Each of the following is captured only in part. */
+    { "truncated ethernet",
+      "000000000002 000000000001", 60,
+      "[|ether], length 60\n" },
+
+    { "truncated llc",
+      ETH_802_3 "aa", 60,
+      "00:00:00:00:00:01 > 00:00:00:00:00:02, 802.3, length 60: [|llc]\n" },
+
+    { "truncated vlan",
+      ETH_BCAST "8100 a0", 60,
+      "00:00:00:00:00:01 > ff:ff:ff:ff:ff:ff, ethertype 802.1Q (0x8100), "
+      "length 60: [|vlan]\n" },
+
+    { "truncated ip",
+      ETH_UDP "4500001c 00010000 4011", 60,
+      "00:00:00:00:00:01 > 00:00:00:00:00:02, ethertype IPv4 (0x0800), "
+      "length 60: [|ip]\n" },
+
+    { "truncated tcp",
+      ETH_802_3 LLC_SNAP "0800" IP_TCP "1f90 0016 00000001", 62,
+      "00:00:00:00:00:01 > 00:00:00:00:00:02, 802.3, length 62: "
+      "LLC, dsap 0xaa, ssap 0xaa, ctrl 0x03: SNAP, "
+      "ethertype IPv4 (0x0800), length 62: "
+      "10.0.0.1 > 10.0.0.2: [|ip-proto-6]\n" },
+
+    { "truncated lldp",
+      ETH_LLDP LLDP_CHASSIS "0403 05", 34,
+      "00:00:00:00:00:01 > 01:80:c2:00:00:0e, ethertype LLDP (0x88cc), "
+      "length 34: LLDP, chassis id 00:00:00:00:00:01 [|lldp]\n" },
+};
+
+/* Converts the hex digits in 'hex', ignoring white space, into bytes in
+ * 'data', which must have room for them.  Returns the number of bytes. */
+static size_t
+parse_hex(const char *hex, uint8_t *data)
+{
+    size_t n = 0;
+    int nibble = -1;
+
+    for (; *hex; hex++) {
+        int value;
+
+        if (isspace((unsigned char) *hex)) {
+            continue;
+        }
+        assert(isxdigit((unsigned char) *hex));
+        value = (isdigit((unsigned char) *hex) ? *hex - '0'
+                 : tolower((unsigned char) *hex) - 'a' + 10);
+        if (nibble < 0) {
+            nibble = value;
+        } else {
+            data[n++] = (nibble << 4) | value;
+            nibble = -1;
+        }
+    }
+    assert(nibble < 0);
+    return n;
+}
+
+static bool
+run_test(const struct test_case *tc)
+{
+    uint8_t data[128];
+    size_t len;
+    char *s;
+    bool ok;
+
+    assert(strlen(tc->hex) / 2 <= sizeof data);
+    len = parse_hex(tc->hex, data);
+    s = ofp_packet_to_string(data, len, tc->total_len ? tc->total_len : len);
+    ok = !strcmp(s, tc->expected);
+    if (!ok) {
+        printf("\n%s: mismatch\nexpected: %sactual:   %s",
+               tc->name, tc->expected, s);
+    } else {
+        printf(".");
+    }
+    free(s);
+    return ok;
+}
+
+int
+main(void)
+{
+    bool ok = true;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(test_cases); i++) {
+        ok = run_test(&test_cases[i]) && ok;
+    }
+    printf("\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+/* Tests the tuple space search table in udatapath/table-tss.c against the
+ * linear table in udatapath/table-linear.c, which implements the same lookup
+ * and flow_mod semantics by brute force.  Both tables are given the same
+ * random flows and requests and must give the same results.  The test runs
+ * once with the flow_mod indexes in udatapath/flow-index.c and once
+ * without. */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "datapath.h"
+#include "flow-index.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "switch-flow.h"
+#include "table.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define N_ROUNDS 20             /* Number of pairs of tables to test. */
+#define N_FLOWS 200             /* Flows initially added to each pair. */
+#define N_REQUESTS 100          /* Requests made of each pair. */
+#define N_LOOKUPS 50            /* Lookups after each request. */
+#define MAX_FLOWS 1000          /* Capacity of each table. */
+
+/* Tables under test. */
+struct tables {
+    struct sw_table *linear;
+    struct sw_table *tss;
+};
+
+/* A flow as it appears in a table, for comparing tables. */
+struct flow_summary {
+    uint64_t cookie;            /* Identifies the flow. */
+    uint16_t priority;
+    uint16_t out_port;          /* Port that the flow outputs to. */
+    uint32_t changed;           /* flow_generation when last changed. */
+};
+
+struct snapshot {
+    struct flow_summary flows[MAX_FLOWS];
+    size_t n_flows;
+};
+
+/* Number of calls to dp_send_flow_end(). */
+static unsigned int n_flow_ends;
+
+/* The tables report deleted flows to the datapath, which this test does not
+ * have, so it counts them instead. */
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+    n_flow_ends++;
+}
+
+static uint32_t
+pick(uint32_t n)
+{
+    return random() % n;
+}
+
+static uint16_t
+pick_priority(void)
+{
+    static const uint16_t priorities[] = { 100, 200, OFP_DEFAULT_PRIORITY };
+    return priorities[pick(ARRAY_SIZE(priorities))];
+}
+
+/* Initializes 'key' with random field values drawn from small sets, so that
+ * random keys often overlap.  One key in ten is an exact match.  The rest
+ * wildcard a random subset of a few fields, a random number of bits of the
+ * IP source, and every other field. */
+static void
+random_key(struct sw_flow_key *key)
+{
+    static const uint32_t optional[] = {
+        OFPFW_IN_PORT, OFPFW_DL_DST, OFPFW_DL_TYPE, OFPFW_NW_PROTO,
+        OFPFW_TP_DST,
+    };
+    static const int nw_src_bits[] = { 0, 8, 24, 32 };
+    struct flow *f = &key->flow;
+    size_t i;
+
+    memset(key, 0, sizeof *key);
+    f->in_port = htons(1 + pick(3));
+    f->dl_vlan = htons(OFP_VLAN_NONE);
+    f->dl_dst[5] = pick(3);
+    f->dl_type = htons(pick(4) ? ETH_TYPE_IP : ETH_TYPE_ARP);
+    f->nw_src = htonl(0x0a000000 | pick(2) << 16 | pick(2));
+    f->nw_proto = pick(2) ? IP_TYPE_TCP : IP_TYPE_UDP;
+    f->tp_dst = htons(pick(2) ? 80 : 443);
+
+    if (pick(10)) {
+        key->wildcards = OFPFW_ALL & ~OFPFW_NW_SRC_MASK;
+        for (i = 0; i < ARRAY_SIZE(optional); i++) {
+            if (pick(2)) {
+                key->wildcards &= ~optional[i];
+            }
+        }
+        key->wildcards |= (nw_src_bits[pick(ARRAY_SIZE(nw_src_bits))]
+                           << OFPFW_NW_SRC_SHIFT);
+    }
+    flow_key_set_mask(key);
+}
+
+/* Initializes 'key' as the exact match for a random packet. */
+static void
+random_packet(struct sw_flow_key *key)
+{
+    random_key(key);
+    key->wildcards = 0;
+    flow_key_set_mask(key);
+}
+
+static void
+make_output_action(struct ofp_action_output *action, uint16_t port)
+{
+    memset(action, 0, sizeof *action);
+    action->type = htons(OFPAT_OUTPUT);
+    action->len = htons(sizeof *action);
+    action->port = htons(port);
+}
+
+static struct sw_flow *
+make_flow(const struct sw_flow_key *key, uint16_t priority,
+          uint16_t out_port, uint64_t cookie)
+{
+    struct ofp_action_output action;
+    struct sw_flow *flow;
+
+    flow = flow_alloc(sizeof action);
+    assert(flow);
+    flow->key = *key;
+    flow->priority = priority;
+    flow->cookie = cookie;
+    make_output_action(&action, out_port);
+    flow_setup_actions(flow, (struct ofp_action_header *) &action,
+                       sizeof action);
+    return flow;
+}
+
+static int
+snapshot_cb(struct sw_flow *flow, void *s_)
+{
+    struct snapshot *s = s_;
+    struct flow_summary *fs;
+
+    assert(s->n_flows < MAX_FLOWS);
+    fs = &s->flows[s->n_flows++];
+    memset(fs, 0, sizeof *fs);
+    fs->cookie = flow->cookie;
+    fs->priority = flow->priority;
+    fs->out_port = flow->sf_acts->out_port;
+    fs->changed = flow->changed;
+    return 0;
+}
+
+static int
+compare_summaries(const void *a_, const void *b_)
+{
+    const struct flow_summary *a = a_;
+    const struct flow_summary *b = b_;
+    return a->cookie < b->cookie ? -1 : a->cookie > b->cookie;
+}
+
+/* Stores a summary of every flow in 'table' into 's', in order of cookie. */
+static void
+take_snapshot(struct sw_table *table, struct snapshot *s)
+{
+    struct sw_table_position position;
+    struct sw_flow_key all;
+
+    memset(&all, 0, sizeof all);
+    all.wildcards = OFPFW_ALL;
+    flow_key_set_mask(&all);
+    memset(&position, 0, sizeof position);
+
+    s->n_flows = 0;
+    assert(!table->iterate(table, &all, htons(OFPP_NONE), &position,
+                           snapshot_cb, s));
+    qsort(s->flows, s->n_flows, sizeof *s->flows, compare_summaries);
+}
+
+/* Checks that 't''s tables hold the same flows and give the same results for
+ * some random packets. */
+static void
+check_tables(struct tables *t)
+{
+    static struct snapshot a, b;
+    struct sw_table_stats stats;
+    int i;
+
+    take_snapshot(t->linear, &a);
+    take_snapshot(t->tss, &b);
+    assert(a.n_flows == b.n_flows);
+    assert(!memcmp(a.flows, b.flows, a.n_flows * sizeof *a.flows));
+
+    memset(&stats, 0, sizeof stats);
+    t->tss->stats(t->tss, &stats);
+    assert(stats.n_flows == b.n_flows);
+
+    for (i = 0; i < N_LOOKUPS; i++) {
+        struct sw_flow *fa, *fb;
+        struct sw_flow_key key;
+
+        random_packet(&key);
+        fa = t->linear->lookup(t->linear, &key);
+        fb = t->tss->lookup(t->tss, &key);
+        assert((fa ? fa->cookie : 0) == (fb ? fb->cookie : 0));
+    }
+}
+
+static void
+do_insert(struct tables *t)
+{
+    static uint64_t next_cookie = 1;
+    struct sw_flow_key key;
+    uint16_t priority = pick_priority();
+    uint16_t out_port = 1 + pick(3);
+    uint64_t cookie = next_cookie++;
+
+    random_key(&key);
+    assert(t->linear->insert(t->linear,
+                             make_flow(&key, priority, out_port, cookie)));
+    assert(t->tss->insert(t->tss,
+                          make_flow(&key, priority, out_port, cookie)));
+}
+
+/* Counts the flows in 'table' that changed in generation 'generation'. */
+static size_t
+count_changed(struct sw_table *table, uint32_t generation)
+{
+    static struct snapshot s;
+    size_t n = 0;
+    size_t i;
+
+    take_snapshot(table, &s);
+    for (i = 0; i < s.n_flows; i++) {
+        n += s.flows[i].changed == generation;
+    }
+    return n;
+}
+
+static void
+do_modify(struct tables *t)
+{
+    struct ofp_action_output action;
+    uint16_t priority = pick_priority();
+    int strict = pick(2);
+    struct sw_flow_key key;
+    uint32_t generation;
+    int na, nb;
+
+    random_key(&key);
+    make_output_action(&action, 4);
+    generation = flow_next_generation();
+    na = t->linear->modify(t->linear, &key, priority, strict,
+                           (struct ofp_action_header *) &action,
+                           sizeof action);
+    nb = t->tss->modify(t->tss, &key, priority, strict,
+                        (struct ofp_action_header *) &action, sizeof action);
+    assert(na == nb);
+    assert(!strict || na <= 1);
+
+    /* Modified flows, and only those, are stamped with the generation. */
+    assert(count_changed(t->linear, generation) == na);
+    assert(count_changed(t->tss, generation) == nb);
+}
+
+static void
+do_delete(struct tables *t)
+{
+    uint16_t out_port = pick(5);
+    uint16_t priority = pick_priority();
+    int strict = pick(2);
+    struct sw_flow_key key;
+    unsigned int ends;
+    int na, nb;
+
+    random_key(&key);
+    if (!out_port) {
+        out_port = OFPP_NONE;
+    }
+
+    n_flow_ends = 0;
+    na = t->linear->delete(NULL, t->linear, &key, htons(out_port),
+                           priority, strict);
+    ends = n_flow_ends;
+    nb = t->tss->delete(NULL, t->tss, &key, htons(out_port),
+                        priority, strict);
+    assert(na == nb);
+    assert(!strict || na <= 1);
+    assert(ends == na);
+    assert(n_flow_ends == na + nb);
+}
+
+static void
+do_has_conflict(struct tables *t)
+{
+    uint16_t priority = pick_priority();
+    int strict = pick(2);
+    struct sw_flow_key key;
+
+    random_key(&key);
+    assert(!t->linear->has_conflict(t->linear, &key, priority, strict)
+           == !t->tss->has_conflict(t->tss, &key, priority, strict));
+}
+
+static void
+test_table_tss(void)
+{
+    int round;
+
+    for (round = 0; round < N_ROUNDS; round++) {
+        struct tables t;
+        int i;
+
+        t.linear = table_linear_create(MAX_FLOWS);
+        t.tss = table_tss_create(MAX_FLOWS);
+        for (i = 0; i < N_FLOWS; i++) {
+            do_insert(&t);
+        }
+        check_tables(&t);
+
+        for (i = 0; i < N_REQUESTS; i++) {
+            switch (pick(4)) {
+            case 0:
+                do_insert(&t);
+                break;
+            case 1:
+                do_modify(&t);
+                break;
+            case 2:
+                do_delete(&t);
+                break;
+            case 3:
+                do_has_conflict(&t);
+                break;
+            }
+            check_tables(&t);
+        }
+
+        t.linear->destroy(t.linear);
+        t.tss->destroy(t.tss);
+    }
+}
+
+static void
+run_test(void (*function)(void))
+{
+    function();
+    printf(".");
+    fflush(stdout);
+}
+
+int
+main(void)
+{
+    srandom(1);
+    run_test(test_table_tss);
+    flow_index_disable();
+    run_test(test_table_tss);
+    printf("\n");
+    return 0;
+}
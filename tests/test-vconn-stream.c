@@ -0,0 +1,300 @@
+/* Tests that the stream vconn reassembles messages correctly however the byte
+ * stream is split across reads, and that it reports malformed and truncated
+ * streams and failed writes as errors. */
+
+#include <config.h>
+#include "vconn-stream.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "ofpbuf.h"
+#include "openflow/openflow.h"
+#include "poll-loop.h"
+#include "socket-util.h"
+#include "util.h"
+#include "vconn.h"
+#include "vconn-provider.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* Body lengths of the messages in the test stream.  Together they are more
+ * than a read-ahead buffer's worth, so that some messages straddle the end
+ * of the buffer. */
+static const size_t body_lens[] = {
+    0, 1, 7, 8, 9, 100, 1000, 4000, 65535 - sizeof(struct ofp_header),
+    0, 3, 16384, 65535 - sizeof(struct ofp_header), 2, 500,
+};
+
+/* Appends to 'stream' an OpenFlow message of the given 'type' with 'body_len'
+ * bytes of body, which are derived from 'xid'. */
+static void
+put_message(struct ofpbuf *stream, uint8_t type, uint32_t xid,
+            size_t body_len)
+{
+    struct ofp_header *oh;
+    uint8_t *body;
+    size_t i;
+
+    oh = ofpbuf_put_uninit(stream, sizeof *oh);
+    oh->version = OFP_VERSION;
+    oh->type = type;
+    oh->length = htons(sizeof *oh + body_len);
+    oh->xid = htonl(xid);
+    body = ofpbuf_put_uninit(stream, body_len);
+    for (i = 0; i < body_len; i++) {
+        body[i] = xid + i;
+    }
+}
+
+/* Returns a byte stream that begins with an OFPT_HELLO, as the peer of a new
+ * connection sends, followed by a message for each of 'body_lens'. */
+static struct ofpbuf *
+make_stream(void)
+{
+    struct ofpbuf *stream = ofpbuf_new(0);
+    size_t i;
+
+    put_message(stream, OFPT_HELLO, 0, 0);
+    for (i = 0; i < ARRAY_SIZE(body_lens); i++) {
+        put_message(stream, OFPT_ECHO_REQUEST, i + 1, body_lens[i]);
+    }
+    return stream;
+}
+
+/* Creates a connected stream vconn in '*vconnp' and returns the file
+ * descriptor for the other end of its connection.  The vconn is set up as
+ * vconn_open() would, to negotiate OFP_VERSION. */
+static int
+open_vconn(struct vconn **vconnp)
+{
+    int fds[2];
+
+    assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    assert(!set_nonblocking(fds[0]));
+    assert(!new_stream_vconn("test", fds[0], 0, 0, false, vconnp));
+    (*vconnp)->min_version = OFP_VERSION;
+    return fds[1];
+}
+
+static void
+write_fully(int fd, const void *data, size_t size)
+{
+    assert(write(fd, data, size) == size);
+}
+
+/* Receives messages from 'vconn' until it would block, checking that each one
+ * is the next message in 'stream', and advances '*ofs' past them. */
+static void
+recv_messages(struct vconn *vconn, const struct ofpbuf *stream, size_t *ofs)
+{
+    for (;;) {
+        const struct ofp_header *oh;
+        struct ofpbuf *msg;
+        int error;
+
+        error = vconn_recv(vconn, &msg);
+        if (error == EAGAIN) {
+            return;
+        }
+        assert(!error);
+
+        oh = (const struct ofp_header *) ((const char *) stream->data + *ofs);
+        assert(*ofs + msg->size <= stream->size);
+        assert(msg->size == ntohs(oh->length));
+        assert(!memcmp(msg->data, oh, msg->size));
+        *ofs += msg->size;
+        ofpbuf_delete(msg);
+    }
+}
+
+/* Writes 'stream' to a vconn in pieces whose sizes 'next_chunk' chooses,
+ * receiving after each piece, and checks that every message arrives
+ * intact. */
+static void
+test_reassembly(size_t (*next_chunk)(void))
+{
+    struct ofpbuf *stream = make_stream();
+    struct vconn *vconn;
+    struct ofpbuf *msg;
+    size_t written, ofs;
+    int peer;
+
+    /* The connection handshake consumes the hello at the start of 'stream',
+     * so the first message received follows it. */
+    peer = open_vconn(&vconn);
+    written = 0;
+    ofs = sizeof(struct ofp_header);
+    while (written < stream->size) {
+        size_t chunk = next_chunk();
+
+        chunk = MIN(chunk, stream->size - written);
+        write_fully(peer, (char *) stream->data + written, chunk);
+        written += chunk;
+        recv_messages(vconn, stream, &ofs);
+    }
+    assert(ofs == stream->size);
+
+    /* Closing the connection between messages is a clean EOF. */
+    close(peer);
+    assert(vconn_recv(vconn, &msg) == EOF);
+
+    vconn_close(vconn);
+    ofpbuf_delete(stream);
+}
+
+static size_t
+chunk_1(void)
+{
+    return 1;
+}
+
+static size_t
+chunk_7(void)
+{
+    return 7;
+}
+
+static size_t
+chunk_header(void)
+{
+    return sizeof(struct ofp_header);
+}
+
+static size_t
+chunk_4093(void)
+{
+    return 4093;
+}
+
+static size_t
+chunk_65536(void)
+{
+    return 65536;
+}
+
+static size_t
+chunk_random(void)
+{
+    return 1 + random() % 20000;
+}
+
+/* Tests that a connection closed partway through a message is an error. */
+static void
+test_eof_mid_message(void)
+{
+    struct ofpbuf *stream = ofpbuf_new(0);
+    struct vconn *vconn;
+    struct ofpbuf *msg;
+    int peer;
+
+    put_message(stream, OFPT_HELLO, 0, 0);
+    put_message(stream, OFPT_ECHO_REQUEST, 1, 100);
+
+    peer = open_vconn(&vconn);
+    write_fully(peer, stream->data, stream->size - 50);
+    close(peer);
+    assert(vconn_recv(vconn, &msg) == EPROTO);
+
+    vconn_close(vconn);
+    ofpbuf_delete(stream);
+}
+
+/* Tests that a header whose length is too short to be valid is an error. */
+static void
+test_short_length(void)
+{
+    struct ofpbuf *stream = ofpbuf_new(0);
+    struct ofp_header *oh;
+    struct vconn *vconn;
+    struct ofpbuf *msg;
+    int peer;
+
+    put_message(stream, OFPT_HELLO, 0, 0);
+    put_message(stream, OFPT_ECHO_REQUEST, 1, 0);
+    oh = ofpbuf_at_assert(stream, sizeof *oh, sizeof *oh);
+    oh->length = htons(sizeof *oh - 1);
+
+    peer = open_vconn(&vconn);
+    write_fully(peer, stream->data, stream->size);
+    assert(vconn_recv(vconn, &msg) == EPROTO);
+
+    close(peer);
+    vconn_close(vconn);
+    ofpbuf_delete(stream);
+}
+
+/* Tests that once writing to the connection fails, sending and receiving
+ * report the error instead of succeeding. */
+static void
+test_send_error(void)
+{
+    struct ofpbuf *stream = ofpbuf_new(0);
+    struct vconn *vconn;
+    struct ofpbuf *msg;
+    int peer;
+    int error;
+
+    put_message(stream, OFPT_HELLO, 0, 0);
+    peer = open_vconn(&vconn);
+    write_fully(peer, stream->data, stream->size);
+    assert(vconn_recv(vconn, &msg) == EAGAIN);
+    assert(!vconn_connect(vconn));
+    close(peer);
+
+    /* The send is queued, and fails when the queue is written. */
+    msg = ofpbuf_new(0);
+    put_message(msg, OFPT_ECHO_REQUEST, 1, 0);
+    assert(!vconn_send(vconn, msg));
+    poll_block();
+
+    msg = ofpbuf_new(0);
+    put_message(msg, OFPT_ECHO_REQUEST, 2, 0);
+    error = vconn_send(vconn, msg);
+    assert(error == EPIPE || error == ECONNRESET);
+    ofpbuf_delete(msg);
+    assert(vconn_recv(vconn, &msg) == error);
+
+    vconn_close(vconn);
+    ofpbuf_delete(stream);
+}
+
+static void
+run_reassembly_test(size_t (*next_chunk)(void))
+{
+    test_reassembly(next_chunk);
+    printf(".");
+    fflush(stdout);
+}
+
+static void
+run_test(void (*function)(void))
+{
+    function();
+    printf(".");
+    fflush(stdout);
+}
+
+int
+main(void)
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    run_reassembly_test(chunk_1);
+    run_reassembly_test(chunk_7);
+    run_reassembly_test(chunk_header);
+    run_reassembly_test(chunk_4093);
+    run_reassembly_test(chunk_65536);
+    srandom(1);
+    run_reassembly_test(chunk_random);
+    run_test(test_eof_mid_message);
+    run_test(test_short_length);
+    run_test(test_send_error);
+    printf("\n");
+    return 0;
+}
@@ -12,6 +12,14 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/crc32.h \
 	udatapath/datapath.c \
 	udatapath/datapath.h \
+	udatapath/flow-hash.c \
+	udatapath/flow-hash.h \
+	udatapath/flow-index.c \
+	udatapath/flow-index.h \
+	udatapath/flow-wheel.c \
+	udatapath/flow-wheel.h \
+	udatapath/pkt-buffer.c \
+	udatapath/pkt-buffer.h \
 	udatapath/dp_act.c \
 	udatapath/dp_act.h \
 	udatapath/of_ext_msg.c \
@@ -23,9 +31,12 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/switch-flow.h \
 	udatapath/table.h \
 	udatapath/table-hash.c \
-	udatapath/table-linear.c
+	udatapath/table-hmap.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
 
-udatapath_ofdatapath_LDADD = lib/libopenflow.a $(SSL_LIBS) $(FAULT_LIBS)
+udatapath_ofdatapath_LDADD = lib/libopenflow.a $(SSL_LIBS) $(FAULT_LIBS) \
+	$(PTHREAD_LIBS)
 udatapath_ofdatapath_CPPFLAGS = $(AM_CPPFLAGS)
 
 EXTRA_DIST += udatapath/ofdatapath.8.in
@@ -56,6 +67,14 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/crc32.h \
 	udatapath/datapath.c \
 	udatapath/datapath.h \
+	udatapath/flow-hash.c \
+	udatapath/flow-hash.h \
+	udatapath/flow-index.c \
+	udatapath/flow-index.h \
+	udatapath/flow-wheel.c \
+	udatapath/flow-wheel.h \
+	udatapath/pkt-buffer.c \
+	udatapath/pkt-buffer.h \
 	udatapath/dp_act.c \
 	udatapath/dp_act.h \
 	udatapath/of_ext_msg.c \
@@ -67,7 +86,9 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/switch-flow.h \
 	udatapath/table.h \
 	udatapath/table-hash.c \
-	udatapath/table-linear.c
+	udatapath/table-hmap.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
 
 udatapath_libudatapath_a_CPPFLAGS = $(AM_CPPFLAGS)
 udatapath_libudatapath_a_CPPFLAGS += -DOF_HW_PLAT -DUDATAPATH_AS_LIB -g
@@ -36,6 +36,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include "flow-hash.h"
+#include "list.h"
 #include "switch-flow.h"
 #include "table.h"
 #include "datapath.h"
@@ -75,6 +78,7 @@ struct sw_chain *chain_create(struct datapath *dp)
         return NULL;
 
     chain->dp = dp;
+    chain->generation = 1;
 #if defined(OF_HW_PLAT)
     if (dp && dp->hw_drv) {
         if (add_table(chain, (struct sw_table *)dp->hw_drv, 0) != 0) {
@@ -82,10 +86,8 @@ struct sw_chain *chain_create(struct datapath *dp)
         }
     }
 #endif
-    if (add_table(chain, table_hash2_create(0x1EDC6F41, TABLE_HASH_MAX_FLOWS,
-                                            0x741B8CD7, TABLE_HASH_MAX_FLOWS),
-                                            0)
-        || add_table(chain, table_linear_create(TABLE_LINEAR_MAX_FLOWS), 0)
+    if (add_table(chain, table_hmap_create(TABLE_HMAP_MAX_FLOWS), 0)
+        || add_table(chain, table_tss_create(TABLE_TSS_MAX_FLOWS), 0)
         || add_table(chain, table_linear_create(TABLE_LINEAR_MAX_FLOWS), 1)) {
         chain_destroy(chain);
         return NULL;
@@ -94,13 +96,30 @@ struct sw_chain *chain_create(struct datapath *dp)
     return chain;
 }
 
+/* Invalidates every entry in 'chain''s microflow caches.  Must be called
+ * whenever a flow is added to, modified in, or removed from one of 'chain''s
+ * working tables. */
+static void
+chain_cache_flush(struct sw_chain *chain)
+{
+    chain->generation++;
+}
+
+/* Initializes 'cache' as an empty microflow cache. */
+void
+chain_cache_init(struct chain_cache *cache)
+{
+    memset(cache, 0, sizeof *cache);
+}
+
 /* Searches 'chain' for a flow matching 'key', which must not have any wildcard
- * fields.  Returns the flow if successful, otherwise a null pointer. */
+ * fields.  Returns the flow if successful, otherwise a null pointer.
+ *
+ * Successful lookups in the working tables are remembered in the microflow
+ * cache, so that later packets in the same microflow skip the tables. */
 struct sw_flow *
 chain_lookup(struct sw_chain *chain, const struct sw_flow_key *key, int emerg)
 {
-    int i;
-
     assert(!key->wildcards);
 
     if (emerg) {
@@ -111,15 +130,45 @@ chain_lookup(struct sw_chain *chain, const struct sw_flow_key *key, int emerg)
             t->n_matched++;
             return flow;
         }
-    } else {
-        for (i = 0; i < chain->n_tables; i++) {
-            struct sw_table *t = chain->tables[i];
-            struct sw_flow *flow = t->lookup(t, key);
-            t->n_lookup++;
-            if (flow) {
-                t->n_matched++;
-                return flow;
-            }
+        return NULL;
+    }
+    return chain_lookup_cache(chain, &chain->cache, key);
+}
+
+/* Searches the working tables in 'chain' for a flow matching 'key', which must
+ * not have any wildcard fields, using 'cache' as the microflow cache.  Returns
+ * the flow if successful, otherwise a null pointer. */
+struct sw_flow *
+chain_lookup_cache(struct sw_chain *chain, struct chain_cache *cache,
+                   const struct sw_flow_key *key)
+{
+    struct chain_cache_entry *e;
+    int i;
+
+    cache->n_lookup++;
+    e = &cache->entries[flow_hash_key(&key->flow) & (CHAIN_CACHE_SIZE - 1)];
+    if (e->generation == chain->generation
+        && flow_equal(&e->key, &key->flow)) {
+        /* Count the lookup as if the tables had been searched. */
+        cache->n_hit++;
+        for (i = 0; i <= e->table_idx; i++) {
+            cache->n_table_lookup[i]++;
+        }
+        cache->n_table_matched[e->table_idx]++;
+        return e->flow;
+    }
+
+    for (i = 0; i < chain->n_tables; i++) {
+        struct sw_table *t = chain->tables[i];
+        struct sw_flow *flow = t->lookup(t, key);
+        cache->n_table_lookup[i]++;
+        if (flow) {
+            cache->n_table_matched[i]++;
+            e->key = key->flow;
+            e->generation = chain->generation;
+            e->table_idx = i;
+            e->flow = flow;
+            return flow;
         }
     }
 
@@ -143,8 +192,10 @@ chain_insert(struct sw_chain *chain, struct sw_flow *flow, int emerg)
     } else {
         for (i = 0; i < chain->n_tables; i++) {
             struct sw_table *t = chain->tables[i];
-            if (t->insert(t, flow))
+            if (t->insert(t, flow)) {
+                chain_cache_flush(chain);
                 return 0;
+            }
         }
     }
 
@@ -174,6 +225,9 @@ chain_modify(struct sw_chain *chain, const struct sw_flow_key *key,
             struct sw_table *t = chain->tables[i];
             count += t->modify(t, key, priority, strict, actions, actions_len);
         }
+        if (count) {
+            chain_cache_flush(chain);
+        }
     }
 
     return count;
@@ -223,6 +277,9 @@ chain_delete(struct sw_chain *chain, const struct sw_flow_key *key,
             struct sw_table *t = chain->tables[i];
             count += t->delete(chain->dp, t, key, out_port, priority, strict);
         }
+        if (count) {
+            chain_cache_flush(chain);
+        }
     }
 
     return count;
@@ -231,17 +288,57 @@ chain_delete(struct sw_chain *chain, const struct sw_flow_key *key,
 /* Deletes timed-out flow entries from all the tables in 'chain' and appends
  * the deleted flows to 'deleted'.
  *
- * Expensive as currently implemented, since it iterates through the entire
- * contents of each table. */
+ * The hash and tuple space search tables keep their flows in a timing wheel,
+ * so that they only examine flows that are probably due to expire.  Other
+ * tables iterate through their entire contents. */
 void
 chain_timeout(struct sw_chain *chain, struct list *deleted)
 {
+    struct list *last = deleted->prev;
     int i;
 
     for (i = 0; i < chain->n_tables; i++) {
         struct sw_table *t = chain->tables[i];
         t->timeout(t, deleted);
     }
+    if (deleted->prev != last) {
+        chain_cache_flush(chain);
+    }
+}
+
+/* Adds the statistics for 'cache', a microflow cache used with 'chain', to
+ * 'stats', presenting the cache as a table: 'n_flows' is the number of valid
+ * entries, 'n_lookup' the number of lookups and 'n_matched' the number of
+ * cache hits.  'stats' should be zeroed before the first call. */
+void
+chain_cache_stats(const struct sw_chain *chain,
+                  const struct chain_cache *cache,
+                  struct sw_table_stats *stats)
+{
+    size_t i;
+
+    for (i = 0; i < CHAIN_CACHE_SIZE; i++) {
+        stats->n_flows += cache->entries[i].generation == chain->generation;
+    }
+
+    stats->name = "microflow";
+    stats->wildcards = 0;
+    stats->max_flows += CHAIN_CACHE_SIZE;
+    stats->n_lookup += cache->n_lookup;
+    stats->n_matched += cache->n_hit;
+    stats->n_buckets += CHAIN_CACHE_SIZE;
+    stats->max_chain = 1;
+}
+
+/* Adds the lookups in 'chain''s working table 'table_idx' that went through
+ * 'cache' to 'stats', which should already hold the table's own
+ * statistics. */
+void
+chain_cache_table_stats(const struct chain_cache *cache, int table_idx,
+                        struct sw_table_stats *stats)
+{
+    stats->n_lookup += cache->n_table_lookup[table_idx];
+    stats->n_matched += cache->n_table_matched[table_idx];
 }
 
 /* Destroys 'chain', which must not have any users. */
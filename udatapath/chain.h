@@ -36,20 +36,52 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "flow.h"
 
 struct sw_flow;
 struct sw_flow_key;
 struct ofp_action_header;
 struct list;
 struct datapath;
+struct sw_table_stats;
 
 #define TABLE_LINEAR_MAX_FLOWS  100
+#define TABLE_TSS_MAX_FLOWS     65536
 #define TABLE_HASH_MAX_FLOWS    65536
+#define TABLE_HMAP_MAX_FLOWS    131072
 #define TABLE_MAC_MAX_FLOWS      1024
 #define TABLE_MAC_NUM_BUCKETS   1024
 
-/* Set of tables chained together in sequence from cheap to expensive. */
+/* Microflow cache: a direct-mapped cache of chain_lookup() results, indexed
+ * by a hash of the looked-up flow.  An entry is valid only while its
+ * 'generation' equals the chain's, which changes whenever a flow is added to,
+ * modified in, or removed from one of the chain's working tables.
+ *
+ * A chain has a cache of its own.  Threads that look up flows concurrently
+ * each need a separate cache, for use with chain_lookup_cache(). */
+#define CHAIN_CACHE_SIZE 1024   /* Number of entries.  Must be a power of 2. */
+struct chain_cache_entry {
+    struct flow key;            /* Flow that was looked up. */
+    uint64_t generation;        /* Chain generation when filled in. */
+    int table_idx;              /* Index of the table that holds 'flow'. */
+    struct sw_flow *flow;       /* Flow that matched 'key'. */
+};
+
 #define CHAIN_MAX_TABLES 4
+struct chain_cache {
+    unsigned long long n_lookup; /* Number of lookups. */
+    unsigned long long n_hit;    /* Number of lookups satisfied by cache. */
+
+    /* Lookups and matches in each working table, counted here rather than in
+     * the table so that threads with separate caches do not share counters.
+     * chain_cache_table_stats() reports them. */
+    unsigned long long n_table_lookup[CHAIN_MAX_TABLES];
+    unsigned long long n_table_matched[CHAIN_MAX_TABLES];
+
+    struct chain_cache_entry entries[CHAIN_CACHE_SIZE];
+};
+
+/* Set of tables chained together in sequence from cheap to expensive. */
 struct sw_chain {
     int n_tables;                /* Number of working tables, not includes
                                   * protection (emergency) table. */
@@ -57,10 +89,16 @@ struct sw_chain {
     struct sw_table *emerg_table;
 
     struct datapath *dp;
+
+    /* Microflow cache for the working tables. */
+    uint64_t generation;        /* Never wraps around. */
+    struct chain_cache cache;
 };
 
 struct sw_chain *chain_create(struct datapath *);
 struct sw_flow *chain_lookup(struct sw_chain *, const struct sw_flow_key *, int);
+struct sw_flow *chain_lookup_cache(struct sw_chain *, struct chain_cache *,
+                                   const struct sw_flow_key *);
 int chain_insert(struct sw_chain *, struct sw_flow *, int);
 int chain_modify(struct sw_chain *, const struct sw_flow_key *,
                  uint16_t, int, const struct ofp_action_header *, size_t, int);
@@ -69,6 +107,11 @@ int chain_has_conflict(struct sw_chain *, const struct sw_flow_key *,
 int chain_delete(struct sw_chain *, const struct sw_flow_key *, uint16_t,
                  uint16_t, int, int);
 void chain_timeout(struct sw_chain *, struct list *deleted);
+void chain_cache_init(struct chain_cache *);
+void chain_cache_stats(const struct sw_chain *, const struct chain_cache *,
+                       struct sw_table_stats *);
+void chain_cache_table_stats(const struct chain_cache *, int table_idx,
+                             struct sw_table_stats *);
 void chain_destroy(struct sw_chain *);
 
 #endif /* chain.h */
@@ -36,6 +36,9 @@
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -48,11 +51,14 @@
 #include "openflow/private-ext.h"
 #include "openflow/openflow-ext.h"
 #include "packets.h"
+#include "pkt-buffer.h"
 #include "poll-loop.h"
 #include "rconn.h"
+#include "socket-util.h"
 #include "stp.h"
 #include "switch-flow.h"
 #include "table.h"
+#include "timeval.h"
 #include "vconn.h"
 #include "xtoxll.h"
 #include "private-msg.h"
@@ -64,7 +70,6 @@
 
 #if defined(OF_HW_PLAT)
 #include <openflow/of_hw_api.h>
-#include <pthread.h>
 #endif
 
 #if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
@@ -180,6 +185,69 @@ struct remote {
 
 static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
 
+/* Multi-threaded forwarding.
+ *
+ * dp_start_workers() divides the ports among worker threads, each of which
+ * receives packets from its own ports and forwards them through the chain.
+ * The main thread keeps everything else: flow setup, timeouts, statistics
+ * and all communication with controllers.
+ *
+ * The flow tables are not safe for lookups concurrent with changes, so each
+ * worker holds 'rwlock' for reading while it forwards a batch of packets.
+ * Only the main thread changes the tables, port configuration and queues,
+ * and it takes 'rwlock' for writing, through dp_lock_tables(), just for the
+ * time that it takes to make a change: expiring flows, or handling a message
+ * from a controller that can change them.  Everything else that the main
+ * thread does, including stats dumps and all controller I/O, runs alongside
+ * the workers, since reading the tables from several threads at once is
+ * safe.  The lock prefers writers, so a busy worker delays a change by at
+ * most one batch.  A flow is freed only after it has been removed from the
+ * tables under the lock, so a worker never sees a flow disappear in the
+ * middle of a batch.
+ *
+ * Workers keep their own microflow caches, lookup counters and receive
+ * buffers.  Every thread serializes transmission on each port with the
+ * port's 'tx_mutex'.  Workers update flow counters atomically and hand
+ * packets for the controller to the main thread through 'pktin_queue'. */
+struct dp_worker {
+    struct datapath *dp;
+    pthread_t thread;
+    struct sw_port **ports;     /* Ports that this worker receives from. */
+    size_t n_ports;
+    struct ofpbuf *rx_ring[DP_RX_BATCH]; /* Buffers ready for reception. */
+    struct chain_cache cache;   /* Microflow cache. */
+};
+
+/* A packet queued by a worker for dp_output_control() in the main thread. */
+struct dp_pktin {
+    struct list node;           /* Element in dp_threads.pktin_queue. */
+    struct ofpbuf *buffer;
+    int in_port;
+    size_t max_len;
+    int reason;
+};
+
+/* Maximum number of packets in dp_threads.pktin_queue.  Packets for the
+ * controller beyond this are dropped, so that a slow controller cannot make
+ * the queue grow without bound. */
+#define DP_PKTIN_QUEUE_MAX 1024
+
+struct dp_threads {
+    pthread_rwlock_t rwlock;    /* Held for writing by dp_lock_tables(). */
+    struct dp_worker *workers;
+    int n_workers;
+
+    pthread_mutex_t pktin_mutex; /* Protects the following members. */
+    struct list pktin_queue;    /* Contains "struct dp_pktin"s. */
+    unsigned int n_pktin;       /* Number of packets in 'pktin_queue'. */
+    unsigned long long n_pktin_dropped;
+
+    int wake_fds[2];            /* Pipe to wake up the main thread. */
+};
+
+/* The worker that is running in this thread, or null in the main thread. */
+static __thread struct dp_worker *cur_worker;
+
 static struct remote *remote_create(struct datapath *, struct rconn *);
 static void remote_run(struct datapath *, struct remote *);
 static void remote_wait(struct remote *);
@@ -188,27 +256,12 @@ static void remote_destroy(struct remote *);
 static void update_port_flags(struct datapath *, const struct ofp_port_mod *);
 static void send_port_status(struct sw_port *p, uint8_t status);
 
-/* Buffers are identified by a 31-bit opaque ID.  We divide the ID
- * into a buffer number (low bits) and a cookie (high bits).  The buffer number
- * is an index into an array of buffers.  The cookie distinguishes between
- * different packets that have occupied a single buffer.  Thus, the more
- * buffers we have, the lower-quality the cookie... */
-#define PKT_BUFFER_BITS 8
-#define N_PKT_BUFFERS (1 << PKT_BUFFER_BITS)
-#define PKT_BUFFER_MASK (N_PKT_BUFFERS - 1)
-
-#define PKT_COOKIE_BITS (32 - PKT_BUFFER_BITS)
-
 int run_flow_through_tables(struct datapath *, struct ofpbuf *,
                             struct sw_port *);
 void fwd_port_input(struct datapath *, struct ofpbuf *, struct sw_port *);
 int fwd_control_input(struct datapath *, const struct sender *,
                       const void *, size_t);
 
-uint32_t save_buffer(struct ofpbuf *);
-static struct ofpbuf *retrieve_buffer(uint32_t id);
-static void discard_buffer(uint32_t id);
-
 struct sw_port *
 dp_lookup_port(struct datapath *dp, uint16_t port_no)
 {
@@ -351,7 +404,10 @@ dp_new(struct datapath **dp_, uint64_t dpid)
         return ENOMEM;
     }
 
+    dp->buffers = pkt_buffers_create(DP_N_BUFFERS_DEFAULT);
+
     list_init(&dp->port_list);
+    dp->rx_budget = DP_RX_BUDGET_DEFAULT;
     dp->flags = 0;
     dp->miss_send_len = OFP_DEFAULT_MISS_SEND_LEN;
 
@@ -524,25 +580,435 @@ dp_add_pvconn(struct datapath *dp, struct pvconn *pvconn)
     dp->listeners[dp->n_listeners++] = pvconn;
 }
 
+/* Sets the maximum number of packets that dp_run() receives from any one port
+ * to 'budget'. */
+void
+dp_set_rx_budget(struct datapath *dp, unsigned int budget)
+{
+    dp->rx_budget = budget ? budget : 1;
+}
+
+/* Replaces 'dp''s packet buffers by room for 'n_buffers' packets, rounded up
+ * to a power of 2.  Any packets already buffered are dropped, so this should
+ * be called before 'dp' starts to send packet-ins. */
+void
+dp_set_n_buffers(struct datapath *dp, unsigned int n_buffers)
+{
+    pkt_buffers_destroy(dp->buffers);
+    dp->buffers = pkt_buffers_create(n_buffers);
+}
+
+/* Receives up to dp->rx_budget packets from 'p''s packet ring, without
+ * copying them, and passes each of them to fwd_port_input().  Packets are
+ * processed in batches of up to DP_RX_BATCH, after which the ring space that
+ * they occupied goes back to the kernel.  Returns the number of packets
+ * received. */
+static unsigned int
+port_recv_ring(struct datapath *dp, struct sw_port *p)
+{
+    unsigned int budget = dp->rx_budget;
+
+    while (budget > 0) {
+        struct ofpbuf *buffers[DP_RX_BATCH];
+        size_t n = MIN(budget, DP_RX_BATCH);
+        size_t n_recv, i;
+        int error;
+
+        error = netdev_recv_ring(p->netdev, buffers, n, &n_recv);
+        if (error) {
+            if (error != EAGAIN) {
+                VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
+                            netdev_get_name(p->netdev), strerror(error));
+            }
+            break;
+        }
+
+        for (i = 0; i < n_recv; i++) {
+            p->rx_packets++;
+            p->rx_bytes += buffers[i]->size;
+            fwd_port_input(dp, buffers[i], p);
+        }
+        netdev_release_ring(p->netdev);
+
+        budget -= n_recv;
+        if (n_recv < n) {
+            break;
+        }
+    }
+    return dp->rx_budget - budget;
+}
+
+/* Receives up to dp->rx_budget packets from 'p', DP_RX_BATCH at a time, and
+ * passes each of them to fwd_port_input().  Buffers that do not receive a
+ * packet stay in 'rx_ring', which has DP_RX_BATCH elements, for the next
+ * call.  Returns the number of packets received. */
+static unsigned int
+port_recv(struct datapath *dp, struct sw_port *p, struct ofpbuf **rx_ring)
+{
+    /* Allocate buffers with some headroom to add headers in forwarding to the
+     * controller or adding a vlan tag, plus an extra 2 bytes to allow IP
+     * headers to be aligned on a 4-byte boundary.  */
+    const int headroom = 128 + 2;
+    const int hard_header = VLAN_ETH_HEADER_LEN;
+    const int mtu = netdev_get_mtu(p->netdev);
+    unsigned int budget = dp->rx_budget;
+
+    if (netdev_has_ring(p->netdev)) {
+        return port_recv_ring(dp, p);
+    }
+
+    while (budget > 0) {
+        size_t n = MIN(budget, DP_RX_BATCH);
+        size_t n_recv, i;
+        int error;
+
+        for (i = 0; i < n; i++) {
+            struct ofpbuf *buffer = rx_ring[i];
+            if (!buffer) {
+                buffer = ofpbuf_new(headroom + hard_header + mtu);
+                ofpbuf_reserve(buffer, headroom);
+                rx_ring[i] = buffer;
+            } else {
+                ofpbuf_prealloc_tailroom(buffer, hard_header + mtu);
+            }
+        }
+
+        error = netdev_recv_batch(p->netdev, rx_ring, n, &n_recv);
+        if (error) {
+            if (error != EAGAIN) {
+                VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
+                            netdev_get_name(p->netdev), strerror(error));
+            }
+            break;
+        }
+
+        for (i = 0; i < n_recv; i++) {
+            struct ofpbuf *buffer = rx_ring[i];
+            rx_ring[i] = NULL;
+            p->rx_packets++;
+            p->rx_bytes += buffer->size;
+            fwd_port_input(dp, buffer, p);
+        }
+        budget -= n_recv;
+        if (n_recv < n) {
+            break;
+        }
+    }
+    return dp->rx_budget - budget;
+}
+
+/* Transmits the packets that output_packet() has queued on 'p'.  Packets
+ * that turn out not to be transmittable were counted as transmitted when
+ * they were queued, so they are moved to 'tx_dropped'.  The caller must hold
+ * 'p''s tx_mutex if 'dp' has worker threads. */
+static void
+flush_port(struct sw_port *p)
+{
+    struct netdev_send_drops drops;
+
+    p->tx_blocked = netdev_send_flush(p->netdev, &drops) != 0;
+    if (drops.n_packets) {
+        p->tx_packets -= drops.n_packets;
+        p->tx_bytes -= drops.n_bytes;
+        p->tx_dropped += drops.n_packets;
+    }
+}
+
+/* Transmits the packets that output_packet() has queued on 'dp''s ports.
+ * Returns true if the kernel had no room for some of them, which then stay
+ * queued until the next call. */
+static bool
+flush_ports(struct datapath *dp)
+{
+    struct sw_port *p;
+    bool blocked = false;
+
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        if (IS_HW_PORT(p)) {
+            continue;
+        }
+        if (dp->threads) {
+            pthread_mutex_lock(&p->tx_mutex);
+            flush_port(p);
+            pthread_mutex_unlock(&p->tx_mutex);
+        } else {
+            flush_port(p);
+        }
+        blocked |= p->tx_blocked;
+    }
+    return blocked;
+}
+
+static void *
+worker_main(void *worker_)
+{
+    struct dp_worker *w = worker_;
+    struct datapath *dp = w->dp;
+    struct dp_threads *threads = dp->threads;
+    struct pollfd *pollfds;
+    bool tx_blocked = false;
+    bool *ready;
+
+    cur_worker = w;
+    pollfds = xmalloc(w->n_ports * sizeof *pollfds);
+    ready = xmalloc(w->n_ports * sizeof *ready);
+    for (;;) {
+        /* Packets that we could not transmit last time are retried as soon
+         * as possible, instead of after the next packet arrives. */
+        bool busy = tx_blocked;
+        size_t i;
+
+        for (i = 0; i < w->n_ports; i++) {
+            ready[i] = netdev_recv_pollfd(w->ports[i]->netdev, &pollfds[i]);
+            busy |= ready[i];
+        }
+        if (poll(pollfds, w->n_ports, busy ? 0 : 1000) < 0
+            && errno != EINTR) {
+            VLOG_ERR_RL(&rl, "poll failed (%s)", strerror(errno));
+        }
+        time_refresh();
+
+        pthread_rwlock_rdlock(&threads->rwlock);
+        for (i = 0; i < w->n_ports; i++) {
+            if (ready[i] || pollfds[i].revents) {
+                port_recv(dp, w->ports[i], w->rx_ring);
+            }
+        }
+        tx_blocked = flush_ports(dp);
+        pthread_rwlock_unlock(&threads->rwlock);
+    }
+    return NULL;
+}
+
+/* Starts 'n_workers' threads to receive and forward packets on 'dp''s ports,
+ * which are divided among them by port number.  From then on, dp_run() does
+ * not receive packets itself.  Must be called after all of 'dp''s ports have
+ * been added, and after daemonizing, since fork() does not copy threads.
+ *
+ * Returns 0 if successful, otherwise a positive errno value. */
+int
+dp_start_workers(struct datapath *dp, int n_workers)
+{
+    struct dp_threads *threads;
+    pthread_rwlockattr_t attr;
+    sigset_t sigs, oldsigs;
+    struct sw_port *p;
+    size_t n_ports;
+    int error;
+    int i;
+
+    n_ports = 0;
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        if (!IS_HW_PORT(p)) {
+            pthread_mutex_init(&p->tx_mutex, NULL);
+            n_ports++;
+        }
+    }
+    n_workers = MIN(n_workers, n_ports);
+    if (n_workers <= 0 || dp->threads) {
+        return 0;
+    }
+
+    threads = xcalloc(1, sizeof *threads);
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(
+        &attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&threads->rwlock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&threads->pktin_mutex, NULL);
+    list_init(&threads->pktin_queue);
+    if (pipe(threads->wake_fds)) {
+        error = errno;
+        VLOG_ERR("pipe failed: %s", strerror(error));
+        free(threads);
+        return error;
+    }
+    set_nonblocking(threads->wake_fds[0]);
+    set_nonblocking(threads->wake_fds[1]);
+
+    threads->n_workers = n_workers;
+    threads->workers = xcalloc(n_workers, sizeof *threads->workers);
+    for (i = 0; i < n_workers; i++) {
+        struct dp_worker *w = &threads->workers[i];
+        w->dp = dp;
+        w->ports = xmalloc(n_ports * sizeof *w->ports);
+        chain_cache_init(&w->cache);
+    }
+    i = 0;
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        if (!IS_HW_PORT(p)) {
+            struct dp_worker *w = &threads->workers[i++ % n_workers];
+            w->ports[w->n_ports++] = p;
+        }
+    }
+
+    flow_use_atomic_counters();
+    dp->threads = threads;
+
+    /* Leave signals, other than those that indicate faults, to the main
+     * thread. */
+    sigfillset(&sigs);
+    sigdelset(&sigs, SIGSEGV);
+    sigdelset(&sigs, SIGBUS);
+    sigdelset(&sigs, SIGFPE);
+    sigdelset(&sigs, SIGILL);
+    sigdelset(&sigs, SIGABRT);
+    pthread_sigmask(SIG_BLOCK, &sigs, &oldsigs);
+    for (i = 0; i < n_workers; i++) {
+        struct dp_worker *w = &threads->workers[i];
+        error = pthread_create(&w->thread, NULL, worker_main, w);
+        if (error) {
+            ofp_fatal(error, "failed to start worker thread");
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+    VLOG_INFO("forwarding with %d worker threads", n_workers);
+    return 0;
+}
+
+/* Queues 'buffer' for dp_output_control() in the main thread.  Called by a
+ * worker. */
+static void
+queue_pktin(struct datapath *dp, struct ofpbuf *buffer, int in_port,
+            size_t max_len, int reason)
+{
+    struct dp_threads *threads = dp->threads;
+    struct dp_pktin *pktin;
+    bool wake = false;
+
+    pthread_mutex_lock(&threads->pktin_mutex);
+    if (threads->n_pktin < DP_PKTIN_QUEUE_MAX) {
+        pktin = xmalloc(sizeof *pktin);
+        pktin->buffer = buffer;
+        pktin->in_port = in_port;
+        pktin->max_len = max_len;
+        pktin->reason = reason;
+        list_push_back(&threads->pktin_queue, &pktin->node);
+        wake = !threads->n_pktin++;
+        buffer = NULL;
+    } else {
+        threads->n_pktin_dropped++;
+    }
+    pthread_mutex_unlock(&threads->pktin_mutex);
+
+    if (buffer) {
+        VLOG_WARN_RL(&rl, "packet-in queue full, dropping packet");
+        ofpbuf_delete(buffer);
+    } else if (wake) {
+        /* If the pipe is full then the main thread will wake up anyway. */
+        if (write(threads->wake_fds[1], "", 1) < 0 && errno != EAGAIN) {
+            VLOG_WARN_RL(&rl, "failed to wake main thread: %s",
+                         strerror(errno));
+        }
+    }
+}
+
+/* Sends the packets that workers have queued for the controller. */
+static void
+run_pktin_queue(struct datapath *dp)
+{
+    struct dp_threads *threads = dp->threads;
+    struct dp_pktin *pktin, *next;
+    struct list queue;
+    char buf[64];
+
+    while (read(threads->wake_fds[0], buf, sizeof buf) > 0) {
+        continue;
+    }
+
+    list_init(&queue);
+    pthread_mutex_lock(&threads->pktin_mutex);
+    if (!list_is_empty(&threads->pktin_queue)) {
+        list_splice(&queue, threads->pktin_queue.next,
+                    &threads->pktin_queue);
+    }
+    threads->n_pktin = 0;
+    pthread_mutex_unlock(&threads->pktin_mutex);
+
+    LIST_FOR_EACH_SAFE (pktin, next, struct dp_pktin, node, &queue) {
+        dp_output_control(dp, pktin->buffer, pktin->in_port,
+                          pktin->max_len, pktin->reason);
+        free(pktin);
+    }
+}
+
+/* Adds the statistics for the workers' microflow caches in 'dp' to
+ * 'stats'. */
+static void
+dp_worker_cache_stats(struct datapath *dp, struct sw_table_stats *stats)
+{
+    int i;
+
+    if (dp->threads) {
+        for (i = 0; i < dp->threads->n_workers; i++) {
+            chain_cache_stats(dp->chain, &dp->threads->workers[i].cache,
+                              stats);
+        }
+    }
+}
+
+/* Adds the workers' lookups in 'dp''s working table 'table_idx' to
+ * 'stats'.  The counts may lag slightly behind the workers, but no lookup is
+ * lost. */
+static void
+dp_worker_table_stats(struct datapath *dp, int table_idx,
+                      struct sw_table_stats *stats)
+{
+    int i;
+
+    if (dp->threads) {
+        for (i = 0; i < dp->threads->n_workers; i++) {
+            chain_cache_table_stats(&dp->threads->workers[i].cache,
+                                    table_idx, stats);
+        }
+    }
+}
+
+/* Keeps worker threads out of 'dp''s flow tables, port configuration and
+ * queues until dp_unlock_tables(), waiting for any batch of packets that they
+ * are forwarding to finish.  Only the main thread changes these, and it must
+ * do so only between these calls.  Does nothing if 'dp' has no workers. */
+static void
+dp_lock_tables(struct datapath *dp)
+{
+    if (dp->threads) {
+        pthread_rwlock_wrlock(&dp->threads->rwlock);
+    }
+}
+
+/* Lets worker threads back into 'dp''s flow tables. */
+static void
+dp_unlock_tables(struct datapath *dp)
+{
+    if (dp->threads) {
+        pthread_rwlock_unlock(&dp->threads->rwlock);
+    }
+}
+
 void
 dp_run(struct datapath *dp)
 {
     time_t now = time_now();
     struct sw_port *p, *pn;
     struct remote *r, *rn;
-    struct ofpbuf *buffer = NULL;
     size_t i;
 
     if (now != dp->last_timeout) {
         struct list deleted = LIST_INITIALIZER(&deleted);
         struct sw_flow *f, *n;
 
+        dp_lock_tables(dp);
         chain_timeout(dp->chain, &deleted);
+        dp_unlock_tables(dp);
         LIST_FOR_EACH_SAFE (f, n, struct sw_flow, node, &deleted) {
             dp_send_flow_end(dp, f, f->reason);
             list_remove(&f->node);
             flow_free(f);
         }
+        pkt_buffers_run(dp->buffers);
         dp->last_timeout = now;
     }
     poll_timer_wait(1000);
@@ -562,34 +1028,16 @@ dp_run(struct datapath *dp)
     }
 #endif
 
-    LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {
-        int error;
-
-        if (IS_HW_PORT(p)) {
-            continue;
-        }
-        if (!buffer) {
-            /* Allocate buffer with some headroom to add headers in forwarding
-             * to the controller or adding a vlan tag, plus an extra 2 bytes to
-             * allow IP headers to be aligned on a 4-byte boundary.  */
-            const int headroom = 128 + 2;
-            const int hard_header = VLAN_ETH_HEADER_LEN;
-            const int mtu = netdev_get_mtu(p->netdev);
-            buffer = ofpbuf_new(headroom + hard_header + mtu);
-            buffer->data = (char*)buffer->data + headroom;
-        }
-        error = netdev_recv(p->netdev, buffer);
-        if (!error) {
-            p->rx_packets++;
-            p->rx_bytes += buffer->size;
-            fwd_port_input(dp, buffer, p);
-            buffer = NULL;
-        } else if (error != EAGAIN) {
-            VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
-                        netdev_get_name(p->netdev), strerror(error));
+    if (dp->threads) {
+        run_pktin_queue(dp);
+    } else {
+        LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {
+            if (IS_HW_PORT(p)) {
+                continue;
+            }
+            port_recv(dp, p, dp->rx_ring);
         }
     }
-    ofpbuf_delete(buffer);
 
     /* Talk to remotes. */
     LIST_FOR_EACH_SAFE (r, rn, struct remote, node, &dp->remotes) {
@@ -609,6 +1057,9 @@ dp_run(struct datapath *dp)
         }
         i++;
     }
+
+    /* Transmit packets queued by output_packet(). */
+    flush_ports(dp);
 }
 
 static void
@@ -651,6 +1102,8 @@ remote_run(struct datapath *dp, struct remote *r)
                     }
                     r->cb_done(r->cb_aux);
                     r->cb_dump = NULL;
+                } else if (error == 2) {
+                    break;
                 }
             } else {
                 break;
@@ -668,6 +1121,9 @@ remote_wait(struct remote *r)
 {
     rconn_run_wait(r->rconn);
     rconn_recv_wait(r->rconn);
+    if (r->cb_dump && r->n_txq < TXQ_LIMIT) {
+        poll_immediate_wake();
+    }
 }
 
 static void
@@ -701,7 +1157,9 @@ remote_create(struct datapath *dp, struct rconn *rconn)
  * queue has an empty slot.  It should compose a message and send it on
  * 'remote'.  On success, it should return 1 if it should be called again when
  * another send queue slot opens up, 0 if its transmissions are complete, or a
- * negative errno value on failure.
+ * negative errno value on failure.  It may instead return 2, without sending
+ * anything, to yield to the rest of the datapath; it is then called again on
+ * the next trip through the main loop.
  *
  * 'done' designates a function to clean up any resources allocated for the
  * dump.  It must handle being called before the dump is complete (which will
@@ -727,11 +1185,18 @@ dp_wait(struct datapath *dp)
     struct remote *r;
     size_t i;
 
-    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
-        if (IS_HW_PORT(p)) {
-            continue;
+    if (dp->threads) {
+        poll_fd_wait(dp->threads->wake_fds[0], POLLIN);
+    } else {
+        LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+            if (IS_HW_PORT(p)) {
+                continue;
+            }
+            netdev_recv_wait(p->netdev);
+            if (p->tx_blocked) {
+                netdev_send_wait(p->netdev);
+            }
         }
-        netdev_recv_wait(p->netdev);
     }
     LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
         remote_wait(r);
@@ -759,7 +1224,7 @@ output_all(struct datapath *dp, struct ofpbuf *buffer, int in_port, int flood)
             continue;
         }
         if (prev_port != -1) {
-            dp_output_port(dp, ofpbuf_clone(buffer), in_port, prev_port,
+            dp_output_port(dp, ofpbuf_share(buffer), in_port, prev_port,
                            0,false);
         }
         prev_port = p->port_no;
@@ -825,6 +1290,9 @@ output_packet(struct datapath *dp, struct ofpbuf *buffer, uint16_t out_port,
                 }
             }
 
+            if (dp->threads) {
+                pthread_mutex_lock(&p->tx_mutex);
+            }
             if (!netdev_send(p->netdev, buffer, class_id)) {
                 p->tx_packets++;
                 p->tx_bytes += buffer->size;
@@ -835,6 +1303,9 @@ output_packet(struct datapath *dp, struct ofpbuf *buffer, uint16_t out_port,
             } else {
                 p->tx_dropped++;
             }
+            if (dp->threads) {
+                pthread_mutex_unlock(&p->tx_mutex);
+            }
         }
         ofpbuf_delete(buffer);
         return;
@@ -924,7 +1395,7 @@ send_openflow_buffer(struct datapath *dp, struct ofpbuf *buffer,
         struct remote *r, *prev = NULL;
         LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
             if (prev) {
-                send_openflow_buffer_to_remote(ofpbuf_clone(buffer), prev);
+                send_openflow_buffer_to_remote(ofpbuf_share(buffer), prev);
             }
             prev = r;
         }
@@ -950,10 +1421,35 @@ dp_output_control(struct datapath *dp, struct ofpbuf *buffer, int in_port,
     size_t total_len;
     uint32_t buffer_id;
 
-    buffer_id = save_buffer(buffer);
+    if (buffer->source != OFPBUF_MALLOC || (cur_worker && buffer->refcnt)) {
+        /* 'buffer' points into a packet ring, but it may need to stay queued
+         * for the controller after the ring space is handed back.  Or it
+         * shares its data with ofpbufs in this thread, but it is going to
+         * another thread. */
+        size_t headroom = offsetof(struct ofp_packet_in, data);
+        struct ofpbuf *copy = ofpbuf_new(headroom + buffer->size);
+        ofpbuf_reserve(copy, headroom);
+        ofpbuf_put(copy, buffer->data, buffer->size);
+        ofpbuf_delete(buffer);
+        buffer = copy;
+    }
+    if (cur_worker) {
+        queue_pktin(dp, buffer, in_port, max_len, reason);
+        return;
+    }
+
+    buffer_id = pkt_buffers_save(dp->buffers, buffer);
     total_len = buffer->size;
-    if (buffer_id != UINT32_MAX && buffer->size > max_len) {
-        buffer->size = max_len;
+    if (buffer_id != UINT32_MAX) {
+        /* The packet stays in the buffer table, so copy only as much of it
+         * as the controller wants into the message. */
+        size_t headroom = offsetof(struct ofp_packet_in, data);
+        size_t len = MIN(total_len, max_len);
+        struct ofpbuf *msg = ofpbuf_new(headroom + len);
+        ofpbuf_reserve(msg, headroom);
+        ofpbuf_put(msg, buffer->data, len);
+        ofpbuf_delete(buffer);
+        buffer = msg;
     }
 
     opi = ofpbuf_push_uninit(buffer, offsetof(struct ofp_packet_in, data));
@@ -1042,7 +1538,7 @@ dp_send_features_reply(struct datapath *dp, const struct sender *sender)
                                sender, &buffer);
     ofr->datapath_id  = htonll(dp->id);
     ofr->n_tables     = dp->chain->n_tables;
-    ofr->n_buffers    = htonl(N_PKT_BUFFERS);
+    ofr->n_buffers    = htonl(pkt_buffers_capacity(dp->buffers));
     ofr->capabilities = htonl(OFP_SUPPORTED_CAPABILITIES);
     ofr->actions      = htonl(OFP_SUPPORTED_ACTIONS);
     LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
@@ -1085,6 +1581,54 @@ send_port_status(struct sw_port *p, uint8_t status)
     send_openflow_buffer(p->dp, buffer, NULL);
 }
 
+/* The most recent flow removals, so that replies to OFP_EXT_STATS_FLOW_DELTA
+ * requests can report the flows removed since a given generation. */
+#define FLOW_DELTA_LOG_SIZE 4096
+
+struct flow_delta_log {
+    struct flow_delta_log_entry {
+        uint32_t generation;    /* flow_generation when the flow went. */
+        struct ofp_ext_flow_delta_removed removed;
+    } entries[FLOW_DELTA_LOG_SIZE];
+    unsigned int n_logged;      /* Removals logged so far, ever. */
+
+    /* The log holds every removal in this generation or any later one. */
+    uint32_t complete_since;
+};
+
+static struct flow_delta_log *
+flow_delta_log_create(void)
+{
+    struct flow_delta_log *log = xmalloc(sizeof *log);
+    log->n_logged = 0;
+    log->complete_since = flow_generation + 1;
+    return log;
+}
+
+static void
+flow_delta_log_add(struct flow_delta_log *log, const struct sw_flow *flow,
+                   enum ofp_flow_removed_reason reason)
+{
+    struct flow_delta_log_entry *e;
+    struct ofp_ext_flow_delta_removed *r;
+
+    e = &log->entries[log->n_logged++ % FLOW_DELTA_LOG_SIZE];
+    if (log->n_logged > FLOW_DELTA_LOG_SIZE
+        && e->generation >= log->complete_since) {
+        log->complete_since = e->generation + 1;
+    }
+    e->generation = flow_generation;
+
+    r = &e->removed;
+    memset(r, 0, sizeof *r);
+    flow_fill_match(&r->match, &flow->key.flow, flow->key.wildcards);
+    r->cookie = htonll(flow->cookie);
+    r->packet_count = htonll(flow->packet_count);
+    r->byte_count = htonll(flow->byte_count);
+    r->priority = htons(flow->priority);
+    r->reason = reason;
+}
+
 void
 dp_send_flow_end(struct datapath *dp, struct sw_flow *flow,
               enum ofp_flow_removed_reason reason)
@@ -1094,6 +1638,10 @@ dp_send_flow_end(struct datapath *dp, struct sw_flow *flow,
     uint64_t tdiff = time_msec() - flow->created;
     uint32_t sec = tdiff / 1000;
 
+    if (dp->delta_log && !flow->emerg_flow) {
+        flow_delta_log_add(dp->delta_log, flow, reason);
+    }
+
     if (!flow->send_flow_rem) {
         return;
     }
@@ -1136,31 +1684,31 @@ dp_send_error_msg(struct datapath *dp, const struct sender *sender,
     send_openflow_buffer(dp, buffer, sender);
 }
 
+/* Returns the number of bytes that fill_flow_stats() appends for 'flow'. */
+static size_t
+flow_stats_length(const struct sw_flow *flow)
+{
+    return sizeof(struct ofp_flow_stats) + flow->sf_acts->actions_len;
+}
+
+/* Appends a flow stats entry for 'flow' to 'buffer'.  Callers that append
+ * many entries should reserve room for them first, since 'buffer' otherwise
+ * grows by only one entry at a time. */
 static void
 fill_flow_stats(struct ofpbuf *buffer, struct sw_flow *flow,
                 int table_idx, uint64_t now)
 {
     struct ofp_flow_stats *ofs;
-    int length = sizeof *ofs + flow->sf_acts->actions_len;
+    int length = flow_stats_length(flow);
     uint64_t tdiff = now - flow->created;
     uint32_t sec = tdiff / 1000;
     ofs = ofpbuf_put_uninit(buffer, length);
     ofs->length          = htons(length);
     ofs->table_id        = table_idx;
     ofs->pad             = 0;
-    ofs->match.wildcards = htonl(flow->key.wildcards);
-    ofs->match.in_port   = flow->key.flow.in_port;
-    memcpy(ofs->match.dl_src, flow->key.flow.dl_src, ETH_ADDR_LEN);
-    memcpy(ofs->match.dl_dst, flow->key.flow.dl_dst, ETH_ADDR_LEN);
-    ofs->match.dl_vlan   = flow->key.flow.dl_vlan;
-    ofs->match.dl_type   = flow->key.flow.dl_type;
-    ofs->match.nw_tos    = flow->key.flow.nw_tos;
-    ofs->match.nw_src    = flow->key.flow.nw_src;
-    ofs->match.nw_dst    = flow->key.flow.nw_dst;
-    ofs->match.nw_proto  = flow->key.flow.nw_proto;
-    ofs->match.dl_vlan_pcp = flow->key.flow.dl_vlan_pcp;
-    ofs->match.tp_src    = flow->key.flow.tp_src;
-    ofs->match.tp_dst    = flow->key.flow.tp_dst;
+    flow_fill_match(&ofs->match, &flow->key.flow, flow->key.wildcards);
+    memset(ofs->match.pad1, 0, sizeof ofs->match.pad1);
+    memset(ofs->match.pad2, 0, sizeof ofs->match.pad2);
     ofs->duration_sec    = htonl(sec);
     ofs->duration_nsec   = htonl((tdiff - (sec * 1000)) * 1000000);
     ofs->cookie          = htonll(flow->cookie);
@@ -1199,11 +1747,12 @@ int run_flow_through_tables(struct datapath *dp, struct ofpbuf *buffer,
         return 0;
     }
 
-    flow = chain_lookup(dp->chain, &key, 0);
+    flow = (cur_worker
+            ? chain_lookup_cache(dp->chain, &cur_worker->cache, &key)
+            : chain_lookup(dp->chain, &key, 0));
     if (flow != NULL) {
         flow_used(flow, buffer);
-        execute_actions(dp, buffer, &key, flow->sf_acts->actions,
-                        flow->sf_acts->actions_len, false);
+        execute_flow_actions(dp, buffer, &key, flow->sf_acts);
         return 0;
     } else {
         return -ESRCH;
@@ -1302,7 +1851,7 @@ recv_packet_out(struct datapath *dp, const struct sender *sender,
         buffer = ofpbuf_new(data_len);
         ofpbuf_put(buffer, (uint8_t *)opo->actions + actions_len, data_len);
     } else {
-        buffer = retrieve_buffer(ntohl(opo->buffer_id));
+        buffer = pkt_buffers_retrieve(dp->buffers, ntohl(opo->buffer_id));
         if (!buffer) {
             return -ESRCH;
         }
@@ -1405,14 +1954,15 @@ add_flow(struct datapath *dp, const struct sender *sender,
 
     error = 0;
     if (ntohl(ofm->buffer_id) != UINT32_MAX) {
-        struct ofpbuf *buffer = retrieve_buffer(ntohl(ofm->buffer_id));
+        struct ofpbuf *buffer;
+
+        buffer = pkt_buffers_retrieve(dp->buffers, ntohl(ofm->buffer_id));
         if (buffer) {
             struct sw_flow_key key;
             uint16_t in_port = ntohs(ofm->match.in_port);
             flow_extract(buffer, in_port, &key.flow);
             flow_used(flow, buffer);
-            execute_actions(dp, buffer, &key,
-                    ofm->actions, actions_len, false);
+            execute_flow_actions(dp, buffer, &key, flow->sf_acts);
         } else {
             error = -ESRCH;
         }
@@ -1423,7 +1973,7 @@ error_free_flow:
     flow_free(flow);
 error:
     if (ntohl(ofm->buffer_id) != (uint32_t) -1)
-        discard_buffer(ntohl(ofm->buffer_id));
+        pkt_buffers_discard(dp->buffers, ntohl(ofm->buffer_id));
     return error;
 }
 
@@ -1480,7 +2030,9 @@ mod_flow(struct datapath *dp, const struct sender *sender,
 
     error = 0;
     if (ntohl(ofm->buffer_id) != UINT32_MAX) {
-      struct ofpbuf *buffer = retrieve_buffer(ntohl(ofm->buffer_id));
+      struct ofpbuf *buffer;
+
+      buffer = pkt_buffers_retrieve(dp->buffers, ntohl(ofm->buffer_id));
       if (buffer) {
             struct sw_flow_key skb_key;
             uint16_t in_port = ntohs(ofm->match.in_port);
@@ -1497,7 +2049,7 @@ error_free_flow:
     flow_free(flow);
 error:
     if (ntohl(ofm->buffer_id) != (uint32_t) -1)
-        discard_buffer(ntohl(ofm->buffer_id));
+        pkt_buffers_discard(dp->buffers, ntohl(ofm->buffer_id));
     return error;
 }
 
@@ -1553,9 +2105,17 @@ struct flow_stats_state {
     uint64_t now;                  /* Current time in milliseconds */
 
     struct ofpbuf *buffer;
+    size_t max_bytes;              /* Maximum size of 'buffer'. */
+    struct ofpbuf *carry;          /* Entry that did not fit in last reply. */
 };
 
-#define MAX_FLOW_STATS_BYTES 4096
+/* Replies to stats requests that span several messages start out at
+ * MIN_STATS_REPLY_BYTES each.  stats_dump() doubles the size for as long as
+ * the controller connection keeps up, up to the largest message that the
+ * OpenFlow length field allows, and halves it if messages back up. */
+#define MIN_STATS_REPLY_BYTES 4096
+#define MAX_STATS_REPLY_BYTES UINT16_MAX
+
 #define EMERG_TABLE_ID_FOR_STATS 0xfe
 
 static int
@@ -1566,6 +2126,7 @@ flow_stats_init(const void *body, int body_len UNUSED, void **state)
     s->table_idx = fsr->table_id == 0xff ? 0 : fsr->table_id;
     memset(&s->position, 0, sizeof s->position);
     s->rq = *fsr;
+    s->carry = NULL;
     *state = s;
     return 0;
 }
@@ -1573,25 +2134,53 @@ flow_stats_init(const void *body, int body_len UNUSED, void **state)
 static int flow_stats_dump_callback(struct sw_flow *flow, void *private)
 {
     struct flow_stats_state *s = private;
+
+    if (s->buffer->size + flow_stats_length(flow) > s->max_bytes) {
+        /* The table resumes after 'flow', so hold on to its entry for the
+         * next reply. */
+        s->carry = ofpbuf_new(flow_stats_length(flow));
+        fill_flow_stats(s->carry, flow, s->table_idx, s->now);
+        return 1;
+    }
     fill_flow_stats(s->buffer, flow, s->table_idx, s->now);
-    return s->buffer->size >= MAX_FLOW_STATS_BYTES;
+    return 0;
 }
 
-static int flow_stats_dump(struct datapath *dp, void *state,
-                           struct ofpbuf *buffer)
+/* Returns the size that a stats dump may grow 'buffer' to. */
+static size_t
+stats_reply_max_bytes(struct ofpbuf *buffer)
+{
+    return MIN(buffer->size + ofpbuf_tailroom(buffer), MAX_STATS_REPLY_BYTES);
+}
+
+/* Passes each flow that 's->rq' selects to 'callback', along with 'aux',
+ * picking up where the previous call left off, until 'callback' returns
+ * nonzero.  'callback' appends to 'buffer' through 's', normally by way of
+ * flow_stats_dump_callback().  Returns 1 if 'callback' stopped the dump, 0
+ * if every flow has been passed to it. */
+static int
+flow_stats_walk(struct datapath *dp, struct flow_stats_state *s,
+                struct ofpbuf *buffer,
+                int (*callback)(struct sw_flow *, void *), void *aux)
 {
-    struct flow_stats_state *s = state;
     struct sw_flow_key match_key;
 
     flow_extract_match(&match_key, &s->rq.match);
     s->buffer = buffer;
+    s->max_bytes = stats_reply_max_bytes(buffer);
     s->now = time_msec();
 
+    if (s->carry) {
+        ofpbuf_put(buffer, s->carry->data, s->carry->size);
+        ofpbuf_delete(s->carry);
+        s->carry = NULL;
+    }
+
     if (s->rq.table_id == EMERG_TABLE_ID_FOR_STATS) {
         struct sw_table *table = dp->chain->emerg_table;
 
-        table->iterate(table, &match_key, s->rq.out_port,
-                       &s->position, flow_stats_dump_callback, s);
+        return table->iterate(table, &match_key, s->rq.out_port,
+                              &s->position, callback, aux);
     } else {
         while (s->table_idx < dp->chain->n_tables
                && (s->rq.table_id == 0xff || s->rq.table_id == s->table_idx))
@@ -1599,88 +2188,115 @@ static int flow_stats_dump(struct datapath *dp, void *state,
             struct sw_table *table = dp->chain->tables[s->table_idx];
 
             if (table->iterate(table, &match_key, s->rq.out_port,
-                               &s->position, flow_stats_dump_callback, s))
-                break;
+                               &s->position, callback, aux))
+                return 1;
 
             s->table_idx++;
             memset(&s->position, 0, sizeof s->position);
         }
     }
-    return s->buffer->size >= MAX_FLOW_STATS_BYTES;
+    return 0;
+}
+
+static int flow_stats_dump(struct datapath *dp, void *state,
+                           struct ofpbuf *buffer)
+{
+    struct flow_stats_state *s = state;
+    return flow_stats_walk(dp, s, buffer, flow_stats_dump_callback, s);
 }
 
 static void flow_stats_done(void *state)
 {
-    free(state);
+    struct flow_stats_state *s = state;
+    if (s) {
+        ofpbuf_delete(s->carry);
+        free(s);
+    }
 }
 
+/* Maximum number of flows that aggregate_stats_dump() looks at in a single
+ * call, whether or not they match.  A request against a full table is spread
+ * across several trips through the main loop, instead of holding up packet
+ * forwarding until the whole table has been walked. */
+#define AGGREGATE_STATS_BUDGET 4096
+
 struct aggregate_stats_state {
     struct ofp_aggregate_stats_request rq;
+    struct sw_flow_key match_key;
+    int table_idx;
+    struct sw_table_position position;
+
+    /* Totals so far, in host byte order. */
+    uint64_t packet_count;
+    uint64_t byte_count;
+    uint32_t flow_count;
 };
 
 static int
 aggregate_stats_init(const void *body, int body_len UNUSED, void **state)
 {
     const struct ofp_aggregate_stats_request *rq = body;
-    struct aggregate_stats_state *s = xmalloc(sizeof *s);
+    struct aggregate_stats_state *s = xcalloc(1, sizeof *s);
     s->rq = *rq;
+    flow_extract_match(&s->match_key, &rq->match);
+    s->table_idx = rq->table_id == 0xff ? 0 : rq->table_id;
     *state = s;
     return 0;
 }
 
 static int aggregate_stats_dump_callback(struct sw_flow *flow, void *private)
 {
-    struct ofp_aggregate_stats_reply *rpy = private;
-    rpy->packet_count += flow->packet_count;
-    rpy->byte_count += flow->byte_count;
-    rpy->flow_count++;
+    struct aggregate_stats_state *s = private;
+    s->packet_count += flow->packet_count;
+    s->byte_count += flow->byte_count;
+    s->flow_count++;
     return 0;
 }
 
+/* Adds up the flows that match the request, resuming where the previous call
+ * left off.  Returns 1 without appending anything to 'buffer' if the budget
+ * ran out first, so that the totals are only sent once every table has been
+ * walked.  Flows added or removed in the meantime may or may not be counted,
+ * as with a flow stats dump that spans several replies. */
 static int aggregate_stats_dump(struct datapath *dp, void *state,
                                 struct ofpbuf *buffer)
 {
     struct aggregate_stats_state *s = state;
     struct ofp_aggregate_stats_request *rq = &s->rq;
     struct ofp_aggregate_stats_reply *rpy;
-    struct sw_table_position position;
-    struct sw_flow_key match_key;
-    int table_idx;
-    int error;
-
-    rpy = ofpbuf_put_uninit(buffer, sizeof *rpy);
-    memset(rpy, 0, sizeof *rpy);
-
-    flow_extract_match(&match_key, &rq->match);
-    table_idx = rq->table_id == 0xff ? 0 : rq->table_id;
-    memset(&position, 0, sizeof position);
 
+    s->position.max_visits = AGGREGATE_STATS_BUDGET;
     if (rq->table_id == EMERG_TABLE_ID_FOR_STATS) {
         struct sw_table *table = dp->chain->emerg_table;
 
-        error = table->iterate(table, &match_key, rq->out_port, &position,
-                               aggregate_stats_dump_callback, rpy);
-        if (error)
-            return error;
+        if (table->iterate(table, &s->match_key, rq->out_port, &s->position,
+                           aggregate_stats_dump_callback, s))
+            return 1;
     } else {
-        while (table_idx < dp->chain->n_tables
-               && (rq->table_id == 0xff || rq->table_id == table_idx))
+        while (s->table_idx < dp->chain->n_tables
+               && (rq->table_id == 0xff || rq->table_id == s->table_idx))
         {
-            struct sw_table *table = dp->chain->tables[table_idx];
+            struct sw_table *table = dp->chain->tables[s->table_idx];
+
+            unsigned int max_visits;
 
-            error = table->iterate(table, &match_key, rq->out_port, &position,
-                                   aggregate_stats_dump_callback, rpy);
-            if (error)
-                return error;
+            if (table->iterate(table, &s->match_key, rq->out_port,
+                               &s->position, aggregate_stats_dump_callback, s))
+                return 1;
 
-            table_idx++;
-            memset(&position, 0, sizeof position);
+            /* The budget is for the whole call, not for each table. */
+            max_visits = s->position.max_visits;
+            s->table_idx++;
+            memset(&s->position, 0, sizeof s->position);
+            s->position.max_visits = max_visits;
         }
     }
 
-    rpy->packet_count = htonll(rpy->packet_count);
-    rpy->byte_count = htonll(rpy->byte_count);
-    rpy->flow_count = htonl(rpy->flow_count);
+    rpy = ofpbuf_put_uninit(buffer, sizeof *rpy);
+    memset(rpy, 0, sizeof *rpy);
+    rpy->packet_count = htonll(s->packet_count);
+    rpy->byte_count = htonll(s->byte_count);
+    rpy->flow_count = htonl(s->flow_count);
     return 0;
 }
 
@@ -1689,24 +2305,43 @@ static void aggregate_stats_done(void *state)
     free(state);
 }
 
+static void
+put_table_stats(struct ofpbuf *buffer, int table_id,
+                const struct sw_table_stats *stats)
+{
+    struct ofp_table_stats *ots = ofpbuf_put_uninit(buffer, sizeof *ots);
+    strncpy(ots->name, stats->name, sizeof ots->name);
+    ots->table_id = table_id;
+    ots->wildcards = htonl(stats->wildcards);
+    memset(ots->pad, 0, sizeof ots->pad);
+    ots->max_entries = htonl(stats->max_flows);
+    ots->active_count = htonl(stats->n_flows);
+    ots->lookup_count = htonll(stats->n_lookup);
+    ots->matched_count = htonll(stats->n_matched);
+}
+
+/* Reports the working tables, followed by the microflow cache as a table of
+ * its own whose 'matched_count' is the number of cache hits.  The cache
+ * holds no flows of its own, so flow_mods never refer to its table_id. */
 static int
 table_stats_dump(struct datapath *dp, void *state UNUSED,
                  struct ofpbuf *buffer)
 {
+    struct sw_table_stats stats;
     int i;
+
     for (i = 0; i < dp->chain->n_tables; i++) {
-        struct ofp_table_stats *ots = ofpbuf_put_uninit(buffer, sizeof *ots);
-        struct sw_table_stats stats;
+        memset(&stats, 0, sizeof stats);
         dp->chain->tables[i]->stats(dp->chain->tables[i], &stats);
-        strncpy(ots->name, stats.name, sizeof ots->name);
-        ots->table_id = i;
-        ots->wildcards = htonl(stats.wildcards);
-        memset(ots->pad, 0, sizeof ots->pad);
-        ots->max_entries = htonl(stats.max_flows);
-        ots->active_count = htonl(stats.n_flows);
-        ots->lookup_count = htonll(stats.n_lookup);
-        ots->matched_count = htonll(stats.n_matched);
+        chain_cache_table_stats(&dp->chain->cache, i, &stats);
+        dp_worker_table_stats(dp, i, &stats);
+        put_table_stats(buffer, i, &stats);
     }
+
+    memset(&stats, 0, sizeof stats);
+    chain_cache_stats(dp->chain, &dp->chain->cache, &stats);
+    dp_worker_cache_stats(dp, &stats);
+    put_table_stats(buffer, i, &stats);
     return 0;
 }
 
@@ -1904,15 +2539,302 @@ queue_stats_done(void *state)
  * <...>                                  // Other stuff.
  * };
  */
+
+/* State for OPENFLOW_VENDOR_ID stats requests. */
+struct ofp_ext_stats_state {
+        uint32_t vendor;                /* OPENFLOW_VENDOR_ID. */
+        uint32_t subtype;               /* One of OFP_EXT_STATS_*. */
+};
+
+/* State for OFP_EXT_STATS_FLOW_DELTA requests. */
+struct flow_delta_state {
+        struct ofp_ext_stats_state ext;
+        uint32_t since;                 /* Generation requested. */
+        bool started;                   /* Has flow_delta_start() run? */
+        bool full;                      /* Listing every flow? */
+        uint32_t generation;            /* Generation to reply with. */
+
+        /* Flows removed since 'since', still to be sent. */
+        struct ofp_ext_flow_delta_removed *removed;
+        size_t n_removed;
+        size_t removed_ofs;             /* Next one to send. */
+
+        /* Walk through the flow tables. */
+        struct flow_stats_state flows;
+};
+
+static struct flow_delta_state *
+flow_delta_create(const struct ofp_ext_flow_delta_request *rq)
+{
+        struct flow_delta_state *s = xcalloc(1, sizeof *s);
+
+        s->since = ntohl(rq->since);
+        s->flows.rq.match.wildcards = htonl(OFPFW_ALL);
+        s->flows.rq.table_id = 0xff;
+        s->flows.rq.out_port = htons(OFPP_NONE);
+        return s;
+}
+
+/* Chooses the generation that 's' replies with and, unless it has to list
+ * every flow, collects the flows removed since the requested generation.
+ * This happens on the first call to flow_delta_dump(), not when the request
+ * arrives, because the removal log belongs to 'dp'. */
+static void
+flow_delta_start(struct datapath *dp, struct flow_delta_state *s)
+{
+        struct flow_delta_log *log;
+        unsigned int i, n;
+
+        if (!dp->delta_log) {
+                dp->delta_log = flow_delta_log_create();
+        }
+        log = dp->delta_log;
+
+        s->full = (!s->since
+                   || s->since < log->complete_since
+                   || s->since > flow_generation);
+        if (!s->full) {
+                n = MIN(log->n_logged, FLOW_DELTA_LOG_SIZE);
+                s->removed = xmalloc(n * sizeof *s->removed);
+                for (i = log->n_logged - n; i != log->n_logged; i++) {
+                        const struct flow_delta_log_entry *e;
+
+                        e = &log->entries[i % FLOW_DELTA_LOG_SIZE];
+                        if (e->generation >= s->since) {
+                                s->removed[s->n_removed++] = e->removed;
+                        }
+                }
+        }
+        /* Workers stamp flows with the generation without locking, so wait
+         * for them to finish with the old one before walking the tables. */
+        dp_lock_tables(dp);
+        s->generation = flow_next_generation();
+        dp_unlock_tables(dp);
+        s->started = true;
+}
+
 static int
-vendor_stats_init(const void *body, int body_len UNUSED,
-                  void **state UNUSED)
+flow_delta_dump_callback(struct sw_flow *flow, void *s_)
+{
+        struct flow_delta_state *s = s_;
+
+        if (!s->full && flow->changed < s->since) {
+                return 0;
+        }
+        return flow_stats_dump_callback(flow, &s->flows);
+}
+
+/* Each reply lists removed flows until there are none left to send, then
+ * changed flows. */
+static int
+flow_delta_dump(struct datapath *dp, struct flow_delta_state *s,
+                struct ofpbuf *buffer)
+{
+        struct ofp_ext_flow_delta_reply *rpy;
+        size_t rpy_ofs = buffer->size;
+        size_t max_bytes = stats_reply_max_bytes(buffer);
+        unsigned int n_removed = 0;
+        int more;
+
+        if (!s->started) {
+                flow_delta_start(dp, s);
+        }
+
+        rpy = ofpbuf_put_zeros(buffer, sizeof *rpy);
+        rpy->header.vendor = htonl(OPENFLOW_VENDOR_ID);
+        rpy->header.subtype = htonl(OFP_EXT_STATS_FLOW_DELTA);
+        rpy->generation = htonl(s->generation);
+        rpy->flags = htons(s->full ? OFP_EXT_FLOW_DELTA_FULL : 0);
+
+        while (s->removed_ofs < s->n_removed
+               && buffer->size + sizeof *s->removed <= max_bytes) {
+                ofpbuf_put(buffer, &s->removed[s->removed_ofs++],
+                           sizeof *s->removed);
+                n_removed++;
+        }
+        if (s->removed_ofs < s->n_removed) {
+                more = 1;
+        } else {
+                more = flow_stats_walk(dp, &s->flows, buffer,
+                                       flow_delta_dump_callback, s);
+        }
+
+        rpy = ofpbuf_at_assert(buffer, rpy_ofs, sizeof *rpy);
+        rpy->n_removed = htons(n_removed);
+        return more;
+}
+
+static int
+ofp_ext_stats_init(const void *body, int body_len, void **state)
+{
+        const struct ofp_ext_stats_header *osh = body;
+        struct ofp_ext_stats_state *s;
+
+        switch (ntohl(osh->subtype)) {
+        case OFP_EXT_STATS_BUFFER:
+        case OFP_EXT_STATS_FLOW_SLAB:
+        case OFP_EXT_STATS_PORT_OUTGOING:
+        case OFP_EXT_STATS_TABLE_HASH:
+                s = xmalloc(sizeof *s);
+                break;
+        case OFP_EXT_STATS_FLOW_DELTA:
+                if (body_len != sizeof(struct ofp_ext_flow_delta_request)) {
+                        return -EINVAL;
+                }
+                s = &flow_delta_create(body)->ext;
+                break;
+        default:
+                return -EINVAL;
+        }
+
+        s->vendor = OPENFLOW_VENDOR_ID;
+        s->subtype = ntohl(osh->subtype);
+        *state = s;
+        return 0;
+}
+
+static void
+ofp_ext_stats_done(struct ofp_ext_stats_state *s)
+{
+        if (s->subtype == OFP_EXT_STATS_FLOW_DELTA) {
+                struct flow_delta_state *fds;
+
+                fds = CONTAINER_OF(s, struct flow_delta_state, ext);
+                free(fds->removed);
+                ofpbuf_delete(fds->flows.carry);
+        }
+        free(s);
+}
+
+static void
+buffer_stats_dump(struct datapath *dp, struct ofpbuf *buffer)
+{
+        struct ofp_ext_buffer_stats *obs;
+        struct pkt_buffer_stats stats;
+
+        pkt_buffers_get_stats(dp->buffers, &stats);
+        obs = ofpbuf_put_zeros(buffer, sizeof *obs);
+        obs->header.vendor = htonl(OPENFLOW_VENDOR_ID);
+        obs->header.subtype = htonl(OFP_EXT_STATS_BUFFER);
+        obs->n_buffers = htonl(stats.n_buffers);
+        obs->n_active = htonl(stats.n_active);
+        obs->saved_count = htonll(stats.n_saved);
+        obs->refused_count = htonll(stats.n_refused);
+        obs->expired_count = htonll(stats.n_expired);
+        obs->hit_count = htonll(stats.n_hit);
+        obs->miss_count = htonll(stats.n_miss);
+        obs->stale_count = htonll(stats.n_stale);
+}
+
+static void
+flow_slab_stats_dump(struct ofpbuf *buffer)
+{
+        struct ofp_ext_flow_slab_stats *ofs;
+        struct flow_slab_stats stats;
+
+        flow_slab_get_stats(&stats);
+        ofs = ofpbuf_put_zeros(buffer, sizeof *ofs);
+        ofs->header.vendor = htonl(OPENFLOW_VENDOR_ID);
+        ofs->header.subtype = htonl(OFP_EXT_STATS_FLOW_SLAB);
+        ofs->slot_size = htonl(stats.slot_size);
+        ofs->n_chunks = htonl(stats.n_chunks);
+        ofs->n_slots = htonl(stats.n_slots);
+        ofs->n_used = htonl(stats.n_used);
+        ofs->max_used = htonl(stats.max_used);
+        ofs->n_external = htonl(stats.n_external);
+}
+
+static void
+put_port_outgoing_stats(struct ofpbuf *buffer, const struct sw_port *p)
+{
+        struct ofp_ext_port_outgoing_stats *pos;
+        unsigned long long int filtered, dropped;
+
+        if (!p->netdev) {
+                return;
+        }
+        netdev_get_outgoing_stats(p->netdev, &filtered, &dropped);
+        pos = ofpbuf_put_zeros(buffer, sizeof *pos);
+        pos->port_no = htons(p->port_no);
+        pos->filtered_count = htonll(filtered);
+        pos->dropped_count = htonll(dropped);
+}
+
+static void
+port_outgoing_stats_dump(struct datapath *dp, struct ofpbuf *buffer)
+{
+        struct ofp_ext_stats_header *osh;
+        int i;
+
+        osh = ofpbuf_put_zeros(buffer, sizeof *osh);
+        osh->vendor = htonl(OPENFLOW_VENDOR_ID);
+        osh->subtype = htonl(OFP_EXT_STATS_PORT_OUTGOING);
+        for (i = 0; i < DP_MAX_PORTS; i++) {
+                struct sw_port *p = dp_lookup_port(dp, i);
+                if (p && PORT_IN_USE(p)) {
+                        put_port_outgoing_stats(buffer, p);
+                }
+        }
+        if (dp->local_port) {
+                put_port_outgoing_stats(buffer, dp->local_port);
+        }
+}
+
+static void
+put_table_hash_stats(struct ofpbuf *buffer, int table_id,
+                     const struct sw_table_stats *stats)
+{
+        struct ofp_ext_table_hash_stats *ths;
+
+        if (!stats->n_buckets) {
+                return;
+        }
+        ths = ofpbuf_put_zeros(buffer, sizeof *ths);
+        ths->table_id = table_id;
+        ths->active_count = htonl(stats->n_flows);
+        ths->n_buckets = htonl(stats->n_buckets);
+        ths->max_chain = htonl(stats->max_chain);
+        ths->lookup_count = htonll(stats->n_lookup);
+        ths->probe_count = htonll(stats->n_probes);
+}
+
+/* Reports the tables that table_stats_dump() does, but only those that hash
+ * their flows. */
+static void
+table_hash_stats_dump(struct datapath *dp, struct ofpbuf *buffer)
+{
+        struct ofp_ext_stats_header *osh;
+        struct sw_table_stats stats;
+        int i;
+
+        osh = ofpbuf_put_zeros(buffer, sizeof *osh);
+        osh->vendor = htonl(OPENFLOW_VENDOR_ID);
+        osh->subtype = htonl(OFP_EXT_STATS_TABLE_HASH);
+        for (i = 0; i < dp->chain->n_tables; i++) {
+                memset(&stats, 0, sizeof stats);
+                dp->chain->tables[i]->stats(dp->chain->tables[i], &stats);
+                chain_cache_table_stats(&dp->chain->cache, i, &stats);
+                dp_worker_table_stats(dp, i, &stats);
+                put_table_hash_stats(buffer, i, &stats);
+        }
+
+        memset(&stats, 0, sizeof stats);
+        chain_cache_stats(dp->chain, &dp->chain->cache, &stats);
+        dp_worker_cache_stats(dp, &stats);
+        put_table_hash_stats(buffer, i, &stats);
+}
+
+static int
+vendor_stats_init(const void *body, int body_len, void **state)
 {
         /* min_body was checked, this should be safe */
         const uint32_t vendor = ntohl(*((uint32_t *)body));
         int err;
 
         switch (vendor) {
+        case OPENFLOW_VENDOR_ID:
+                err = ofp_ext_stats_init(body, body_len, state);
+                break;
         default:
                 err = -EINVAL;
         }
@@ -1921,13 +2843,30 @@ vendor_stats_init(const void *body, int body_len UNUSED,
 }
 
 static int
-vendor_stats_dump(struct datapath *dp UNUSED, void *state,
-                  struct ofpbuf *buffer UNUSED)
+vendor_stats_dump(struct datapath *dp, void *state, struct ofpbuf *buffer)
 {
         const uint32_t vendor = *((uint32_t *)state);
         int err;
 
         switch (vendor) {
+        case OPENFLOW_VENDOR_ID: {
+                struct ofp_ext_stats_state *s = state;
+                err = 0;
+                if (s->subtype == OFP_EXT_STATS_BUFFER) {
+                        buffer_stats_dump(dp, buffer);
+                } else if (s->subtype == OFP_EXT_STATS_FLOW_SLAB) {
+                        flow_slab_stats_dump(buffer);
+                } else if (s->subtype == OFP_EXT_STATS_PORT_OUTGOING) {
+                        port_outgoing_stats_dump(dp, buffer);
+                } else if (s->subtype == OFP_EXT_STATS_TABLE_HASH) {
+                        table_hash_stats_dump(dp, buffer);
+                } else if (s->subtype == OFP_EXT_STATS_FLOW_DELTA) {
+                        err = flow_delta_dump(dp, CONTAINER_OF(
+                                                  s, struct flow_delta_state,
+                                                  ext), buffer);
+                }
+                break;
+        }
         default:
                 /* Should never happen */
                 err = 0;
@@ -1942,6 +2881,9 @@ vendor_stats_done(void *state)
         const uint32_t vendor = *((uint32_t *) state);
 
         switch (vendor) {
+        case OPENFLOW_VENDOR_ID:
+                ofp_ext_stats_done(state);
+                break;
         default:
                 /* Should never happen */
                 free(state);
@@ -1966,9 +2908,15 @@ struct stats_type {
     int (*init)(const void *body, int body_len, void **state);
 
     /* Appends statistics for 'dp' to 'buffer', which initially contains a
-     * struct ofp_stats_reply.  On success, it should return 1 if it should be
+     * struct ofp_stats_reply and has tailroom for a reply of the size that
+     * suits the connection.  A dump that spreads its output over several
+     * replies should not grow 'buffer' beyond that.  On success, it should return 1 if it should be
      * called again later with another buffer, 0 if it is done, or a negative
-     * errno value on failure. */
+     * errno value on failure.
+     *
+     * A dump that needs more time before it has anything to send may return
+     * 1 without appending anything to 'buffer'.  Nothing is sent in that
+     * case, and it is called again on a later trip through the main loop. */
     int (*dump)(struct datapath *dp, void *state, struct ofpbuf *buffer);
 
     /* Cleans any state created by the init or dump functions.  May be null
@@ -2041,8 +2989,24 @@ struct stats_dump_cb {
     struct sender sender;
     const struct stats_type *s;
     void *state;
+    size_t reply_size;          /* Size to allow for the next reply. */
 };
 
+/* Adjusts the size of 'cb''s next reply to how well its controller
+ * connection is keeping up: an empty send queue means the socket is taking
+ * replies as fast as they are produced. */
+static void
+stats_adjust_reply_size(struct stats_dump_cb *cb)
+{
+    int n_txq = cb->sender.remote->n_txq;
+
+    if (!n_txq) {
+        cb->reply_size = MIN(cb->reply_size * 2, MAX_STATS_REPLY_BYTES);
+    } else if (n_txq >= TXQ_LIMIT / 4) {
+        cb->reply_size = MAX(cb->reply_size / 2, MIN_STATS_REPLY_BYTES);
+    }
+}
+
 static int
 stats_dump(struct datapath *dp, void *cb_)
 {
@@ -2059,8 +3023,14 @@ stats_dump(struct datapath *dp, void *cb_)
                               &buffer);
     osr->type = htons(cb->s->type);
     osr->flags = 0;
+    ofpbuf_prealloc_tailroom(buffer, cb->reply_size - buffer->size);
 
     err = cb->s->dump(dp, cb->state, buffer);
+    if (err > 0 && buffer->size == sizeof *osr) {
+        /* Nothing to send yet. */
+        ofpbuf_delete(buffer);
+        return 2;
+    }
     if (err >= 0) {
         int err2;
         if (!err) {
@@ -2073,6 +3043,8 @@ stats_dump(struct datapath *dp, void *cb_)
         err2 = send_openflow_buffer(dp, buffer, &cb->sender);
         if (err2) {
             err = err2;
+        } else if (err) {
+            stats_adjust_reply_size(cb);
         }
     }
 
@@ -2122,6 +3094,7 @@ recv_stats_request(struct datapath *dp UNUSED, const struct sender *sender,
     cb->sender = *sender;
     cb->s = st;
     cb->state = NULL;
+    cb->reply_size = MIN_STATS_REPLY_BYTES;
 
     body_len = rq_len - offsetof(struct ofp_stats_request, body);
     if (body_len < cb->s->min_body || body_len > cb->s->max_body) {
@@ -2234,8 +3207,10 @@ fwd_control_input(struct datapath *dp, const struct sender *sender,
                   const void *msg, size_t length)
 {
     int (*handler)(struct datapath *, const struct sender *, const void *);
+    bool exclusive = false;     /* Might the handler change the tables? */
     struct ofp_header *oh;
     size_t min_size;
+    int error;
 
     /* Check encapsulated length. */
     oh = (struct ofp_header *) msg;
@@ -2261,6 +3236,7 @@ fwd_control_input(struct datapath *dp, const struct sender *sender,
     case OFPT_SET_CONFIG:
         min_size = sizeof(struct ofp_switch_config);
         handler = recv_set_config;
+        exclusive = true;
         break;
     case OFPT_PACKET_OUT:
         min_size = sizeof(struct ofp_packet_out);
@@ -2269,10 +3245,12 @@ fwd_control_input(struct datapath *dp, const struct sender *sender,
     case OFPT_FLOW_MOD:
         min_size = sizeof(struct ofp_flow_mod);
         handler = recv_flow;
+        exclusive = true;
         break;
     case OFPT_PORT_MOD:
         min_size = sizeof(struct ofp_port_mod);
         handler = recv_port_mod;
+        exclusive = true;
         break;
     case OFPT_STATS_REQUEST:
         min_size = sizeof(struct ofp_stats_request);
@@ -2293,6 +3271,7 @@ fwd_control_input(struct datapath *dp, const struct sender *sender,
     case OFPT_VENDOR:
         min_size = sizeof(struct ofp_vendor_header);
         handler = recv_vendor;
+        exclusive = true;
         break;
     default:
         dp_send_error_msg(dp, sender, OFPET_BAD_REQUEST, OFPBRC_BAD_TYPE,
@@ -2303,73 +3282,12 @@ fwd_control_input(struct datapath *dp, const struct sender *sender,
     /* Handle it. */
     if (length < min_size)
         return -EFAULT;
-    return handler(dp, sender, msg);
-}
-
-/* Packet buffering. */
-
-#define OVERWRITE_SECS  1
-
-struct packet_buffer {
-    struct ofpbuf *buffer;
-    uint32_t cookie;
-    time_t timeout;
-};
-
-static struct packet_buffer buffers[N_PKT_BUFFERS];
-static unsigned int buffer_idx;
-
-uint32_t save_buffer(struct ofpbuf *buffer)
-{
-    struct packet_buffer *p;
-    uint32_t id;
-
-    buffer_idx = (buffer_idx + 1) & PKT_BUFFER_MASK;
-    p = &buffers[buffer_idx];
-    if (p->buffer) {
-        /* Don't buffer packet if existing entry is less than
-         * OVERWRITE_SECS old. */
-        if (time_now() < p->timeout) { /* FIXME */
-                return (uint32_t)-1;
-        } else {
-            ofpbuf_delete(p->buffer);
-        }
+    if (exclusive) {
+        dp_lock_tables(dp);
     }
-    /* Don't use maximum cookie value since the all-bits-1 id is
-     * special. */
-    if (++p->cookie >= (1u << PKT_COOKIE_BITS) - 1)
-        p->cookie = 0;
-    p->buffer = ofpbuf_clone(buffer);      /* FIXME */
-    p->timeout = time_now() + OVERWRITE_SECS; /* FIXME */
-    id = buffer_idx | (p->cookie << PKT_BUFFER_BITS);
-
-    return id;
-}
-
-static struct ofpbuf *retrieve_buffer(uint32_t id)
-{
-    struct ofpbuf *buffer = NULL;
-    struct packet_buffer *p;
-
-    p = &buffers[id & PKT_BUFFER_MASK];
-    if (p->cookie == id >> PKT_BUFFER_BITS) {
-        buffer = p->buffer;
-        p->buffer = NULL;
-    } else {
-        printf("cookie mismatch: %x != %x\n",
-               id >> PKT_BUFFER_BITS, p->cookie);
-    }
-
-    return buffer;
-}
-
-static void discard_buffer(uint32_t id)
-{
-    struct packet_buffer *p;
-
-    p = &buffers[id & PKT_BUFFER_MASK];
-    if (p->cookie == id >> PKT_BUFFER_BITS) {
-        ofpbuf_delete(p->buffer);
-        p->buffer = NULL;
+    error = handler(dp, sender, msg);
+    if (exclusive) {
+        dp_unlock_tables(dp);
     }
+    return error;
 }
@@ -36,6 +36,7 @@
 #ifndef DATAPATH_H
 #define DATAPATH_H 1
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include "openflow/nicira-ext.h"
@@ -53,6 +54,8 @@ struct rconn;
 struct pvconn;
 struct sw_flow;
 struct sender;
+struct dp_threads;
+struct flow_delta_log;
 
 struct sw_queue {
     struct list node; /* element in port.queues */
@@ -91,11 +94,13 @@ struct sw_port {
     unsigned long long int rx_packets, tx_packets;
     unsigned long long int rx_bytes, tx_bytes;
     unsigned long long int tx_dropped;
+    bool tx_blocked;            /* Packets still queued after a flush? */
     uint16_t port_no;
     /* port queues */
     uint16_t num_queues;
     struct sw_queue queues[NETDEV_MAX_QUEUES];
     struct list queue_list; /* list of all queues for this port */
+    pthread_mutex_t tx_mutex;   /* Serializes transmission by workers. */
 };
 
 #if defined(OF_HW_PLAT)
@@ -110,6 +115,17 @@ struct hw_pkt_q_entry {
 #define DP_MAX_PORTS 255
 BUILD_ASSERT_DECL(DP_MAX_PORTS <= OFPP_MAX);
 
+/* Maximum number of packets received from a port with one call to
+ * netdev_recv_batch(). */
+#define DP_RX_BATCH 32
+
+/* Default maximum number of packets received from each port in one call to
+ * dp_run(). */
+#define DP_RX_BUDGET_DEFAULT 64
+
+/* Default number of packets buffered for the controller. */
+#define DP_N_BUFFERS_DEFAULT 4096
+
 struct datapath {
     /* Remote connections. */
     struct list remotes;        /* All connections (including controller). */
@@ -130,11 +146,25 @@ struct datapath {
     uint16_t flags;
     uint16_t miss_send_len;
 
+    /* Packets buffered for the controller. */
+    struct pkt_buffers *buffers;
+
+    /* Recently removed flows, kept once a controller has sent an
+     * OFP_EXT_STATS_FLOW_DELTA request. */
+    struct flow_delta_log *delta_log;
+
     /* Switch ports. */
     struct sw_port ports[DP_MAX_PORTS];
     struct sw_port *local_port;  /* OFPP_LOCAL port, if any. */
     struct list port_list; /* All ports, including local_port. */
 
+    /* Packet reception. */
+    struct ofpbuf *rx_ring[DP_RX_BATCH]; /* Buffers ready for reception. */
+    unsigned int rx_budget;     /* Max packets per port per dp_run(). */
+
+    /* Worker threads, if any (see dp_start_workers()). */
+    struct dp_threads *threads;
+
 #if defined(OF_HW_PLAT)
     /* Although the chain maintains the pointer to the HW driver
      * for flow operations, the datapath needs the port functions
@@ -149,6 +179,9 @@ int dp_new(struct datapath **, uint64_t dpid);
 int dp_add_port(struct datapath *, const char *netdev, uint16_t);
 int dp_add_local_port(struct datapath *, const char *netdev, uint16_t);
 void dp_add_pvconn(struct datapath *, struct pvconn *);
+void dp_set_rx_budget(struct datapath *, unsigned int);
+void dp_set_n_buffers(struct datapath *, unsigned int);
+int dp_start_workers(struct datapath *, int n_workers);
 void dp_run(struct datapath *);
 void dp_wait(struct datapath *);
 void dp_send_error_msg(struct datapath *, const struct sender *,
@@ -69,15 +69,19 @@ validate_queue(struct datapath *dp UNUSED, const struct sw_flow_key *key UNUSED,
     return ACT_VALIDATION_OK;
 }
 
+/* Executes 'op', an OFPAT_OUTPUT or OFPAT_ENQUEUE op, against 'buffer'. */
 static void
 do_output(struct datapath *dp, struct ofpbuf *buffer, int in_port,
-          size_t max_len, int out_port, uint32_t queue_id,
-          bool ignore_no_fwd)
+          const struct sw_flow_op *op, bool ignore_no_fwd)
 {
-    if (out_port != OFPP_CONTROLLER) {
-        dp_output_port(dp, buffer, in_port, out_port, queue_id, ignore_no_fwd);
+    if (op->type == OFPAT_ENQUEUE) {
+        dp_output_port(dp, buffer, in_port, op->arg, op->arg32,
+                       ignore_no_fwd);
+    } else if (op->arg != OFPP_CONTROLLER) {
+        /* Using the default best-effort queue. */
+        dp_output_port(dp, buffer, in_port, op->arg, 0, ignore_no_fwd);
     } else {
-        dp_output_control(dp, buffer, in_port, max_len, OFPR_ACTION);
+        dp_output_control(dp, buffer, in_port, op->arg32, OFPR_ACTION);
     }
 }
 
@@ -137,41 +141,21 @@ vlan_pull_tag(struct ofpbuf *buffer)
 }
 
 static void
-set_vlan_vid(struct ofpbuf *buffer, struct sw_flow_key *key, 
-        const struct ofp_action_header *ah)
-{
-    struct ofp_action_vlan_vid *va = (struct ofp_action_vlan_vid *)ah;
-    uint16_t tci = ntohs(va->vlan_vid);
-
-    modify_vlan_tci(buffer, key, tci, VLAN_VID_MASK);
-}
-
-static void
-set_vlan_pcp(struct ofpbuf *buffer, struct sw_flow_key *key, 
-        const struct ofp_action_header *ah)
-{
-    struct ofp_action_vlan_pcp *va = (struct ofp_action_vlan_pcp *)ah;
-    uint16_t tci = (uint16_t)va->vlan_pcp << 13;
-
-    modify_vlan_tci(buffer, key, tci, VLAN_PCP_MASK);
-}
-
-static void
-strip_vlan(struct ofpbuf *buffer, struct sw_flow_key *key, 
-        const struct ofp_action_header *ah UNUSED)
+strip_vlan(struct ofpbuf *buffer, struct sw_flow_key *key)
 {
     vlan_pull_tag(buffer);
     key->flow.dl_vlan = htons(OFP_VLAN_NONE);
 }
 
 static void
-set_dl_addr(struct ofpbuf *buffer, struct sw_flow_key *key UNUSED, 
-        const struct ofp_action_header *ah)
+set_dl_addr(struct ofpbuf *buffer, const struct sw_flow_op *op,
+        const struct ofp_action_header *actions)
 {
-    struct ofp_action_dl_addr *da = (struct ofp_action_dl_addr *)ah;
+    const struct ofp_action_dl_addr *da
+        = (const void *) ((const uint8_t *) actions + op->arg);
     struct eth_header *eh = buffer->l2;
 
-    if (da->type == htons(OFPAT_SET_DL_SRC)) {
+    if (op->type == OFPAT_SET_DL_SRC) {
         memcpy(eh->eth_src, da->dl_addr, sizeof eh->eth_src);
     } else {
         memcpy(eh->eth_dst, da->dl_addr, sizeof eh->eth_dst);
@@ -180,9 +164,8 @@ set_dl_addr(struct ofpbuf *buffer, struct sw_flow_key *key UNUSED,
 
 static void
 set_nw_addr(struct ofpbuf *buffer, struct sw_flow_key *key, 
-        const struct ofp_action_header *ah)
+        const struct sw_flow_op *op)
 {
-    struct ofp_action_nw_addr *na = (struct ofp_action_nw_addr *)ah;
     uint16_t eth_proto = ntohs(key->flow.dl_type);
 
     if (eth_proto == ETH_TYPE_IP) {
@@ -190,8 +173,8 @@ set_nw_addr(struct ofpbuf *buffer, struct sw_flow_key *key,
         uint8_t nw_proto = key->flow.nw_proto;
         uint32_t new, *field;
 
-        new = na->nw_addr;
-        field = na->type == htons(OFPAT_SET_NW_SRC) ? &nh->ip_src : &nh->ip_dst;
+        new = op->arg32;
+        field = op->type == OFPAT_SET_NW_SRC ? &nh->ip_src : &nh->ip_dst;
         if (nw_proto == IP_TYPE_TCP) {
             struct tcp_header *th = buffer->l4;
             th->tcp_csum = recalc_csum32(th->tcp_csum, *field, new);
@@ -211,9 +194,8 @@ set_nw_addr(struct ofpbuf *buffer, struct sw_flow_key *key,
 
 static void
 set_nw_tos(struct ofpbuf *buffer, struct sw_flow_key *key, 
-           const struct ofp_action_header *ah)
+           const struct sw_flow_op *op)
 {
-    struct ofp_action_nw_tos *nt = (struct ofp_action_nw_tos *)ah;
     uint16_t eth_proto = ntohs(key->flow.dl_type);
 
    if (eth_proto == ETH_TYPE_IP) {
@@ -221,7 +203,7 @@ set_nw_tos(struct ofpbuf *buffer, struct sw_flow_key *key,
        uint8_t new, *field;
 
        /* JeanII : Set only 6 bits, don't clobber ECN */
-       new = (nt->nw_tos & 0xFC) | (nh->ip_tos & 0x03);
+       new = (op->arg & 0xFC) | (nh->ip_tos & 0x03);
 
        /* Get address of field */
        field = &nh->ip_tos;
@@ -238,24 +220,23 @@ set_nw_tos(struct ofpbuf *buffer, struct sw_flow_key *key,
 
 static void
 set_tp_port(struct ofpbuf *buffer, struct sw_flow_key *key, 
-        const struct ofp_action_header *ah)
+        const struct sw_flow_op *op)
 {
-    struct ofp_action_tp_port *ta = (struct ofp_action_tp_port *)ah;
     uint16_t eth_proto = ntohs(key->flow.dl_type);
 
     if (eth_proto == ETH_TYPE_IP) {
         uint8_t nw_proto = key->flow.nw_proto;
         uint16_t new, *field;
 
-        new = ta->tp_port;
+        new = op->arg;
         if (nw_proto == IP_TYPE_TCP) {
             struct tcp_header *th = buffer->l4;
-            field = ta->type == htons(OFPAT_SET_TP_SRC) ? &th->tcp_src : &th->tcp_dst;
+            field = op->type == OFPAT_SET_TP_SRC ? &th->tcp_src : &th->tcp_dst;
             th->tcp_csum = recalc_csum16(th->tcp_csum, *field, new);
             *field = new;
         } else if (nw_proto == IP_TYPE_UDP) {
             struct udp_header *th = buffer->l4;
-            field = ta->type == htons(OFPAT_SET_TP_SRC) ? &th->udp_src : &th->udp_dst;
+            field = op->type == OFPAT_SET_TP_SRC ? &th->udp_src : &th->udp_dst;
             th->udp_csum = recalc_csum16(th->udp_csum, *field, new);
             *field = new;
         }
@@ -268,83 +249,68 @@ struct openflow_action {
     uint16_t (*validate)(struct datapath *dp, 
             const struct sw_flow_key *key,
             const struct ofp_action_header *ah);
-    void (*execute)(struct ofpbuf *buffer,
-            struct sw_flow_key *key, 
-            const struct ofp_action_header *ah);
 };
 
 static const struct openflow_action of_actions[] = {
     [OFPAT_OUTPUT] = {
         sizeof(struct ofp_action_output),
         sizeof(struct ofp_action_output),
-        validate_output,
-        NULL                   /* This is optimized into execute_actions */
+        validate_output
     },
     [OFPAT_ENQUEUE] = {
         sizeof(struct ofp_action_enqueue),
         sizeof(struct ofp_action_enqueue),
-        validate_queue,
-        NULL         /* This is optimized into execute_actions */
+        validate_queue
     },
     [OFPAT_SET_VLAN_VID] = {
         sizeof(struct ofp_action_vlan_vid),
         sizeof(struct ofp_action_vlan_vid),
-        NULL,
-        set_vlan_vid
+        NULL
     },
     [OFPAT_SET_VLAN_PCP] = {
         sizeof(struct ofp_action_vlan_pcp),
         sizeof(struct ofp_action_vlan_pcp),
-        NULL,
-        set_vlan_pcp
+        NULL
     },
     [OFPAT_STRIP_VLAN] = {
         sizeof(struct ofp_action_header),
         sizeof(struct ofp_action_header),
-        NULL,
-        strip_vlan
+        NULL
     },
     [OFPAT_SET_DL_SRC] = {
         sizeof(struct ofp_action_dl_addr),
         sizeof(struct ofp_action_dl_addr),
-        NULL,
-        set_dl_addr
+        NULL
     },
     [OFPAT_SET_DL_DST] = {
         sizeof(struct ofp_action_dl_addr),
         sizeof(struct ofp_action_dl_addr),
-        NULL,
-        set_dl_addr
+        NULL
     },
     [OFPAT_SET_NW_SRC] = {
         sizeof(struct ofp_action_nw_addr),
         sizeof(struct ofp_action_nw_addr),
-        NULL,
-        set_nw_addr
+        NULL
     },
     [OFPAT_SET_NW_DST] = {
         sizeof(struct ofp_action_nw_addr),
         sizeof(struct ofp_action_nw_addr),
-        NULL,
-        set_nw_addr
+        NULL
     },
     [OFPAT_SET_NW_TOS] = {
         sizeof(struct ofp_action_nw_tos),
         sizeof(struct ofp_action_nw_tos),
-        NULL,
-        set_nw_tos
+        NULL
     },
     [OFPAT_SET_TP_SRC] = {
         sizeof(struct ofp_action_tp_port),
         sizeof(struct ofp_action_tp_port),
-        NULL,
-        set_tp_port
+        NULL
     },
     [OFPAT_SET_TP_DST] = {
         sizeof(struct ofp_action_tp_port),
         sizeof(struct ofp_action_tp_port),
-        NULL,
-        set_tp_port
+        NULL
     }
     /* OFPAT_VENDOR is not here, since it would blow up the array size. */
 };
@@ -440,18 +406,6 @@ validate_actions(struct datapath *dp, const struct sw_flow_key *key,
     return ACT_VALIDATION_OK;
 }
 
-/* Execute a built-in OpenFlow action against 'buffer'. */
-static void
-execute_ofpat(struct ofpbuf *buffer, struct sw_flow_key *key, 
-        const struct ofp_action_header *ah, uint16_t type)
-{
-    const struct openflow_action *act = &of_actions[type];
-
-    if (act->execute) {
-        act->execute(buffer, key, ah);
-    }
-}
-
 /* Execute a vendor-defined action against 'buffer'. */
 static void
 execute_vendor(struct ofpbuf *buffer UNUSED, const struct sw_flow_key *key UNUSED, 
@@ -469,63 +423,113 @@ execute_vendor(struct ofpbuf *buffer UNUSED, const struct sw_flow_key *key UNUSE
     }
 }
 
-/* Execute a list of actions against 'buffer'. */
-void execute_actions(struct datapath *dp, struct ofpbuf *buffer,
-             struct sw_flow_key *key,
-             const struct ofp_action_header *actions, size_t actions_len,
-             int ignore_no_fwd)
+/* Execute 'op', which modifies the packet, against 'buffer'.  'actions' is the
+ * action list that 'op' was compiled from. */
+static void
+execute_op(struct ofpbuf *buffer, struct sw_flow_key *key,
+           const struct sw_flow_op *op,
+           const struct ofp_action_header *actions)
 {
-    /* Every output action needs a separate clone of 'buffer', but the common
-     * case is just a single output action, so that doing a clone and then
-     * freeing the original buffer is wasteful.  So the following code is
-     * slightly obscure just to avoid that. */
-    int prev_port;
-    uint32_t prev_queue;
-    size_t max_len = UINT16_MAX;
-    uint16_t in_port = ntohs(key->flow.in_port);
-    uint8_t *p = (uint8_t *)actions;
-
-    prev_port = -1;
-    prev_queue = 0;
+    ofpbuf_unshare(buffer);
+    switch (op->type) {
+    case OFPAT_SET_VLAN_VID:
+        modify_vlan_tci(buffer, key, op->arg, VLAN_VID_MASK);
+        break;
+    case OFPAT_SET_VLAN_PCP:
+        modify_vlan_tci(buffer, key, op->arg, VLAN_PCP_MASK);
+        break;
+    case OFPAT_STRIP_VLAN:
+        strip_vlan(buffer, key);
+        break;
+    case OFPAT_SET_DL_SRC:
+    case OFPAT_SET_DL_DST:
+        set_dl_addr(buffer, op, actions);
+        break;
+    case OFPAT_SET_NW_SRC:
+    case OFPAT_SET_NW_DST:
+        set_nw_addr(buffer, key, op);
+        break;
+    case OFPAT_SET_NW_TOS:
+        set_nw_tos(buffer, key, op);
+        break;
+    case OFPAT_SET_TP_SRC:
+    case OFPAT_SET_TP_DST:
+        set_tp_port(buffer, key, op);
+        break;
+    case OFPAT_VENDOR:
+        execute_vendor(buffer, key, (const struct ofp_action_header *)
+                       ((const uint8_t *) actions + op->arg));
+        break;
+    }
+}
 
-    /* The action list was already validated, so we can be a bit looser
-     * in our sanity-checking. */
-    while (actions_len > 0) {
-        struct ofp_action_header *ah = (struct ofp_action_header *)p;
-        size_t len = htons(ah->len);
+/* Execute the 'n_ops' ops in 'ops', compiled from 'actions', against
+ * 'buffer'. */
+static void
+execute_ops(struct datapath *dp, struct ofpbuf *buffer,
+            struct sw_flow_key *key, const struct ofp_action_header *actions,
+            const struct sw_flow_op *ops, size_t n_ops, int ignore_no_fwd)
+{
+    /* Every output action needs a separate reference to 'buffer', but the
+     * common case is just a single output action, so that taking a reference
+     * and then freeing the original buffer is wasteful.  So the following
+     * code is slightly obscure just to avoid that.  The data is copied only
+     * if an action modifies the packet while an earlier output still holds a
+     * reference, e.g. because it was queued for the controller. */
+    const struct sw_flow_op *prev = NULL;
+    const struct sw_flow_op *op;
+    uint16_t in_port = ntohs(key->flow.in_port);
 
-        if (prev_port != -1) {
-            do_output(dp, ofpbuf_clone(buffer), in_port, max_len,
-                      prev_port, prev_queue, ignore_no_fwd);
-            prev_port = -1;
+    for (op = ops; op < &ops[n_ops]; op++) {
+        if (prev) {
+            do_output(dp, ofpbuf_share(buffer), in_port, prev, ignore_no_fwd);
+            prev = NULL;
         }
 
-        if (ah->type == htons(OFPAT_OUTPUT)) {
-            struct ofp_action_output *oa = (struct ofp_action_output *)p;
-            prev_port = ntohs(oa->port);
-            prev_queue = 0; /* using the default best-effort queue */
-            max_len = ntohs(oa->max_len);
-        } else if (ah->type == htons(OFPAT_ENQUEUE)) {
-            struct ofp_action_enqueue *ea = (struct ofp_action_enqueue *)p;
-            prev_port = ntohs(ea->port);
-            prev_queue = ntohl(ea->queue_id);
-            max_len = 0; /* we will not send to the controller anyways - useless */
+        if (op->type == OFPAT_OUTPUT || op->type == OFPAT_ENQUEUE) {
+            prev = op;
         } else {
-            uint16_t type = ntohs(ah->type);
-
-            if (type < ARRAY_SIZE(of_actions)) {
-                execute_ofpat(buffer, key, ah, type);
-            } else if (type == OFPAT_VENDOR) {
-                execute_vendor(buffer, key, ah);
-            }
+            execute_op(buffer, key, op, actions);
         }
-
-        p += len;
-        actions_len -= len;
     }
-    if (prev_port != -1) {
-        do_output(dp, buffer, in_port, max_len, prev_port, prev_queue, ignore_no_fwd);
+    if (prev) {
+        do_output(dp, buffer, in_port, prev, ignore_no_fwd);
     } else {
         ofpbuf_delete(buffer);
     }
 }
+
+/* Execute a list of actions against 'buffer'.  The list must already have
+ * been validated. */
+void execute_actions(struct datapath *dp, struct ofpbuf *buffer,
+             struct sw_flow_key *key,
+             const struct ofp_action_header *actions, size_t actions_len,
+             int ignore_no_fwd)
+{
+    struct sw_flow_op stub[16];
+    struct sw_flow_op *ops;
+    uint16_t out_port;
+    size_t n_ops;
+
+    ops = (actions_len / sizeof *actions <= ARRAY_SIZE(stub) ? stub
+           : xmalloc(actions_len / sizeof *actions * sizeof *ops));
+    n_ops = flow_compile_actions(actions, actions_len, ops, &out_port);
+    execute_ops(dp, buffer, key, actions, ops, n_ops, ignore_no_fwd);
+    if (ops != stub) {
+        free(ops);
+    }
+}
+
+/* Execute the actions in 'sfa', a flow's actions, against 'buffer'. */
+void execute_flow_actions(struct datapath *dp, struct ofpbuf *buffer,
+                          struct sw_flow_key *key,
+                          const struct sw_flow_actions *sfa)
+{
+    if (sfa->out_port != OFPP_NONE) {
+        dp_output_port(dp, buffer, ntohs(key->flow.in_port), sfa->out_port,
+                       0, false);
+    } else {
+        execute_ops(dp, buffer, key, sfa->actions, sfa_ops(sfa), sfa->n_ops,
+                    false);
+    }
+}
@@ -45,5 +45,7 @@ uint16_t validate_actions(struct datapath *, const struct sw_flow_key *,
 void execute_actions(struct datapath *, struct ofpbuf *,
 		struct sw_flow_key *, const struct ofp_action_header *, 
 		size_t action_len, int ignore_no_fwd);
+void execute_flow_actions(struct datapath *, struct ofpbuf *,
+		struct sw_flow_key *, const struct sw_flow_actions *);
 
 #endif /* dp_act.h */
@@ -0,0 +1,238 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#include <config.h>
+#include "flow-hash.h"
+#include <errno.h>
+#include <string.h>
+#include "crc32.h"
+#include "hash.h"
+
+#define THIS_MODULE VLM_chain
+#include "vlog.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CRC32C_INSN 1
+#include <nmmintrin.h>
+#endif
+
+const struct flow_hash_impl *flow_hash_cur;
+
+/* Finishes a hash by mixing its high bits into its low bits.  This is the
+ * 32-bit finalizer from MurmurHash3, which is in the public domain. */
+static inline uint32_t
+mix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Byte-at-a-time CRC32, using the two polynomials that table_hash2 has
+ * always used.  This is the slowest implementation and is kept mostly for
+ * comparison. */
+
+static struct crc32 crc_tables[2];
+
+static bool
+crc32_available(void)
+{
+    static bool inited;
+    if (!inited) {
+        crc32_init(&crc_tables[0], 0x1EDC6F41);
+        crc32_init(&crc_tables[1], 0x741B8CD7);
+        inited = true;
+    }
+    return true;
+}
+
+static uint32_t
+crc32_hash(const uint32_t *p, size_t n)
+{
+    return crc32_calculate(&crc_tables[0], p, n * sizeof *p);
+}
+
+static void
+crc32_hash2(const uint32_t *p, size_t n, uint32_t hashes[2])
+{
+    hashes[0] = crc32_calculate(&crc_tables[0], p, n * sizeof *p);
+    hashes[1] = crc32_calculate(&crc_tables[1], p, n * sizeof *p);
+}
+
+static const struct flow_hash_impl crc32_impl = {
+    "crc32",
+    crc32_available,
+    crc32_hash,
+    crc32_hash2,
+};
+
+/* Bob Jenkins' lookup3, a word at a time.  Its final state has two
+ * well-mixed words, so both hashes come out of the same pass. */
+
+static bool
+lookup3_available(void)
+{
+    return true;
+}
+
+static uint32_t
+lookup3_hash(const uint32_t *p, size_t n)
+{
+    return hash_words(p, n, 0);
+}
+
+static void
+lookup3_hash2(const uint32_t *p, size_t n, uint32_t hashes[2])
+{
+    hash_words2(p, n, 0, hashes);
+}
+
+static const struct flow_hash_impl lookup3_impl = {
+    "lookup3",
+    lookup3_available,
+    lookup3_hash,
+    lookup3_hash2,
+};
+
+#ifdef HAVE_CRC32C_INSN
+/* CRC32-C using the SSE4.2 "crc32" instruction, one word per instruction.
+ *
+ * CRC is linear, so a second CRC of the same words, even with a different
+ * seed, collides exactly when the first one does, and so does any function of
+ * the first hash.  The second hash is instead a CRC of each word multiplied by
+ * an odd constant, which is not linear over GF(2).  The two CRCs are computed
+ * in the same loop, where they run in parallel in the CPU. */
+
+static bool
+crc32c_available(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+
+static uint32_t __attribute__((target("sse4.2")))
+crc32c_hash(const uint32_t *p, size_t n)
+{
+    uint32_t crc = 0xffffffff;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        crc = _mm_crc32_u32(crc, p[i]);
+    }
+    return crc;
+}
+
+static void __attribute__((target("sse4.2")))
+crc32c_hash2(const uint32_t *p, size_t n, uint32_t hashes[2])
+{
+    uint32_t crc0 = 0xffffffff;
+    uint32_t crc1 = 0xffffffff;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        crc0 = _mm_crc32_u32(crc0, p[i]);
+        crc1 = _mm_crc32_u32(crc1, p[i] * 0x9e3779b1);
+    }
+    hashes[0] = crc0;
+    hashes[1] = mix32(crc1);
+}
+
+static const struct flow_hash_impl crc32c_impl = {
+    "crc32c",
+    crc32c_available,
+    crc32c_hash,
+    crc32c_hash2,
+};
+#endif
+
+/* In order of preference. */
+const struct flow_hash_impl *const flow_hash_impls[] = {
+#ifdef HAVE_CRC32C_INSN
+    &crc32c_impl,
+#endif
+    &lookup3_impl,
+    &crc32_impl,
+    NULL,
+};
+
+/* Chooses the most preferred flow hash implementation that is available, if
+ * none has been chosen yet. */
+void
+flow_hash_init(void)
+{
+    const struct flow_hash_impl *const *impl;
+
+    if (flow_hash_cur) {
+        return;
+    }
+    for (impl = flow_hash_impls; *impl; impl++) {
+        if ((*impl)->available()) {
+            flow_hash_cur = *impl;
+            VLOG_DBG("using %s flow hash", flow_hash_cur->name);
+            return;
+        }
+    }
+    NOT_REACHED();
+}
+
+/* Chooses the flow hash implementation named 'name'.  Must be called before
+ * any flow is inserted into a table, since hashes computed by different
+ * implementations are not comparable.  Returns 0 if successful, otherwise
+ * ENOENT if there is no such implementation or EOPNOTSUPP if it cannot run
+ * on this machine. */
+int
+flow_hash_select(const char *name)
+{
+    const struct flow_hash_impl *const *impl;
+
+    for (impl = flow_hash_impls; *impl; impl++) {
+        if (!strcmp((*impl)->name, name)) {
+            if (!(*impl)->available()) {
+                return EOPNOTSUPP;
+            }
+            flow_hash_cur = *impl;
+            return 0;
+        }
+    }
+    return ENOENT;
+}
+
+/* Returns the name of the flow hash implementation in use. */
+const char *
+flow_hash_name(void)
+{
+    return flow_hash_get()->name;
+}
@@ -0,0 +1,109 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Hash functions for the udatapath flow tables.
+ *
+ * Several implementations are available.  Unless flow_hash_select() is
+ * called, the fastest one that the CPU supports is chosen the first time a
+ * hash is computed.  Every implementation computes two independent hashes in
+ * a single pass over the key, for the benefit of tables such as table_hash2
+ * that probe two locations, and the first of the two hashes is always equal
+ * to the single hash. */
+
+#ifndef FLOW_HASH_H
+#define FLOW_HASH_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "flow.h"
+#include "util.h"
+
+struct flow_hash_impl {
+    const char *name;
+
+    /* Returns true if this implementation can run on this machine. */
+    bool (*available)(void);
+
+    /* Returns a hash of the 'n' 32-bit words at 'p'. */
+    uint32_t (*hash)(const uint32_t *p, size_t n);
+
+    /* Stores two independent hashes of the 'n' 32-bit words at 'p' into
+     * 'hashes'.  hashes[0] is the value that 'hash' would return. */
+    void (*hash2)(const uint32_t *p, size_t n, uint32_t hashes[2]);
+};
+
+/* Null-terminated array of all the implementations. */
+extern const struct flow_hash_impl *const flow_hash_impls[];
+
+/* Implementation in use, or a null pointer if none has been chosen yet. */
+extern const struct flow_hash_impl *flow_hash_cur;
+
+void flow_hash_init(void);
+int flow_hash_select(const char *name);
+const char *flow_hash_name(void);
+
+static inline const struct flow_hash_impl *
+flow_hash_get(void)
+{
+    if (!flow_hash_cur) {
+        flow_hash_init();
+    }
+    return flow_hash_cur;
+}
+
+/* Returns a hash of the 'n' 32-bit words at 'p'. */
+static inline uint32_t
+flow_hash_words(const uint32_t *p, size_t n)
+{
+    return flow_hash_get()->hash(p, n);
+}
+
+/* Returns a hash of 'flow'. */
+static inline uint32_t
+flow_hash_key(const struct flow *flow)
+{
+    BUILD_ASSERT_DECL(!(sizeof *flow % sizeof(uint32_t)));
+    return flow_hash_words((const uint32_t *) flow,
+                           sizeof *flow / sizeof(uint32_t));
+}
+
+/* Stores two independent hashes of 'flow' into 'hashes'. */
+static inline void
+flow_hash_key2(const struct flow *flow, uint32_t hashes[2])
+{
+    flow_hash_get()->hash2((const uint32_t *) flow,
+                           sizeof *flow / sizeof(uint32_t), hashes);
+}
+
+#endif /* flow-hash.h */
@@ -0,0 +1,398 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#include <config.h>
+#include "flow-index.h"
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "switch-flow.h"
+#include "util.h"
+
+/* All the flows in one flow_index_set that have the same value for the
+ * set's field. */
+struct flow_index_bucket {
+    struct hmap_node node;      /* In flow_index_set's 'buckets'. */
+    uint64_t value;             /* Value of the field. */
+    size_t n_flows;             /* Number of flows in 'flows'. */
+    struct list flows;          /* Contains "struct flow_index_entry"s. */
+};
+
+/* A flow's membership in each of the flow_index_sets of a flow_index.  Kept
+ * out of struct sw_flow, which lookups touch, because only flow_mods use
+ * it. */
+struct flow_index_entry {
+    struct sw_flow *flow;
+    struct flow_index_link {
+        struct list node;       /* In a bucket's 'flows' or in 'others'. */
+        struct flow_index_bucket *bucket; /* Null if in 'others'. */
+    } links[FLOW_INDEX_N_FIELDS];
+};
+
+/* Set to false by flow_index_disable(). */
+static bool enabled = true;
+
+/* Stops flow_index_insert() from indexing flows, so that every request
+ * visits every flow, to save memory.  Must be called before any flows are
+ * inserted. */
+void
+flow_index_disable(void)
+{
+    enabled = false;
+}
+
+void
+flow_index_init(struct flow_index *fi)
+{
+    int i;
+
+    for (i = 0; i < FLOW_INDEX_N_FIELDS; i++) {
+        struct flow_index_set *set = &fi->sets[i];
+
+        hmap_init(&set->buckets);
+        list_init(&set->others);
+        set->n_others = 0;
+    }
+    fi->n_flows = 0;
+}
+
+/* Frees the memory that 'fi' uses.  Does not touch the flows in 'fi', which
+ * may already have been freed. */
+void
+flow_index_destroy(struct flow_index *fi)
+{
+    struct flow_index_set *set = &fi->sets[0];
+    struct flow_index_bucket *b, *next_b;
+    struct flow_index_entry *e, *next_e;
+    int i;
+
+    /* Every entry is on exactly one list in each set, so visiting the lists
+     * in the first set visits every entry once. */
+    HMAP_FOR_EACH (b, struct flow_index_bucket, node, &set->buckets) {
+        LIST_FOR_EACH_SAFE (e, next_e, struct flow_index_entry,
+                            links[0].node, &b->flows) {
+            free(e);
+        }
+    }
+    LIST_FOR_EACH_SAFE (e, next_e, struct flow_index_entry, links[0].node,
+                        &set->others) {
+        free(e);
+    }
+
+    for (i = 0; i < FLOW_INDEX_N_FIELDS; i++) {
+        set = &fi->sets[i];
+        HMAP_FOR_EACH_SAFE (b, next_b, struct flow_index_bucket, node,
+                            &set->buckets) {
+            hmap_remove(&set->buckets, &b->node);
+            free(b);
+        }
+        hmap_destroy(&set->buckets);
+    }
+}
+
+static uint32_t
+hash_value(uint64_t value, enum flow_index_field field)
+{
+    uint32_t words[2];
+
+    words[0] = value >> 32;
+    words[1] = value;
+    return hash_words(words, 2, field);
+}
+
+/* Stores in '*value' the value of 'field' in 'flow' and returns true, or
+ * returns false if 'field' does not index 'flow'. */
+static bool
+flow_field_value(const struct sw_flow *flow, enum flow_index_field field,
+                 uint64_t *value)
+{
+    switch (field) {
+    case FLOW_INDEX_IN_PORT:
+        *value = flow->key.flow.in_port;
+        return !(flow->key.wildcards & OFPFW_IN_PORT);
+
+    case FLOW_INDEX_DL_DST:
+        *value = eth_addr_to_uint64(flow->key.flow.dl_dst);
+        return !(flow->key.wildcards & OFPFW_DL_DST);
+
+    case FLOW_INDEX_OUT_PORT:
+        *value = flow->sf_acts->out_port;
+        return flow->sf_acts->out_port != OFPP_NONE;
+
+    case FLOW_INDEX_N_FIELDS:
+    default:
+        NOT_REACHED();
+    }
+}
+
+/* Stores in '*value' the value of 'field' that a request for flows matching
+ * 'key' and having 'out_port' (in network byte order) as an output port
+ * specifies, and returns true, or returns false if the request does not
+ * specify 'field'. */
+static bool
+request_field_value(const struct sw_flow_key *key, uint16_t out_port,
+                    enum flow_index_field field, uint64_t *value)
+{
+    switch (field) {
+    case FLOW_INDEX_IN_PORT:
+        *value = key->flow.in_port;
+        return !(key->wildcards & OFPFW_IN_PORT);
+
+    case FLOW_INDEX_DL_DST:
+        *value = eth_addr_to_uint64(key->flow.dl_dst);
+        return !(key->wildcards & OFPFW_DL_DST);
+
+    case FLOW_INDEX_OUT_PORT:
+        *value = ntohs(out_port);
+        return *value != OFPP_NONE;
+
+    case FLOW_INDEX_N_FIELDS:
+    default:
+        NOT_REACHED();
+    }
+}
+
+static struct flow_index_bucket *
+find_bucket(const struct flow_index_set *set, enum flow_index_field field,
+            uint64_t value)
+{
+    struct flow_index_bucket *b;
+
+    HMAP_FOR_EACH_WITH_HASH (b, struct flow_index_bucket, node,
+                             hash_value(value, field), &set->buckets) {
+        if (b->value == value) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+static void
+link_field(struct flow_index *fi, struct flow_index_entry *e,
+           enum flow_index_field field)
+{
+    struct flow_index_set *set = &fi->sets[field];
+    struct flow_index_link *link = &e->links[field];
+    uint64_t value;
+
+    if (flow_field_value(e->flow, field, &value)) {
+        struct flow_index_bucket *b = find_bucket(set, field, value);
+        if (!b) {
+            b = xmalloc(sizeof *b);
+            b->value = value;
+            b->n_flows = 0;
+            list_init(&b->flows);
+            hmap_insert(&set->buckets, &b->node, hash_value(value, field));
+        }
+        list_push_back(&b->flows, &link->node);
+        b->n_flows++;
+        link->bucket = b;
+    } else {
+        list_push_back(&set->others, &link->node);
+        set->n_others++;
+        link->bucket = NULL;
+    }
+}
+
+static void
+unlink_field(struct flow_index *fi, struct flow_index_entry *e,
+             enum flow_index_field field)
+{
+    struct flow_index_set *set = &fi->sets[field];
+    struct flow_index_link *link = &e->links[field];
+    struct flow_index_bucket *b = link->bucket;
+
+    list_remove(&link->node);
+    if (b) {
+        if (!--b->n_flows) {
+            hmap_remove(&set->buckets, &b->node);
+            free(b);
+        }
+    } else {
+        set->n_others--;
+    }
+}
+
+/* Adds 'flow', which must not already be in an index, to 'fi'. */
+void
+flow_index_insert(struct flow_index *fi, struct sw_flow *flow)
+{
+    struct flow_index_entry *e;
+    int i;
+
+    if (!enabled) {
+        flow->index_entry = NULL;
+        return;
+    }
+
+    e = flow->index_entry = xmalloc(sizeof *e);
+    e->flow = flow;
+    for (i = 0; i < FLOW_INDEX_N_FIELDS; i++) {
+        link_field(fi, e, i);
+    }
+    fi->n_flows++;
+}
+
+/* Removes 'flow' from 'fi'. */
+void
+flow_index_remove(struct flow_index *fi, struct sw_flow *flow)
+{
+    struct flow_index_entry *e = flow->index_entry;
+    int i;
+
+    if (e) {
+        for (i = 0; i < FLOW_INDEX_N_FIELDS; i++) {
+            unlink_field(fi, e, i);
+        }
+        free(e);
+        flow->index_entry = NULL;
+        fi->n_flows--;
+    }
+}
+
+/* Updates 'fi' after the actions of 'flow', which is in 'fi', have been
+ * replaced. */
+void
+flow_index_update_actions(struct flow_index *fi, struct sw_flow *flow)
+{
+    struct flow_index_entry *e = flow->index_entry;
+
+    if (e) {
+        unlink_field(fi, e, FLOW_INDEX_OUT_PORT);
+        link_field(fi, e, FLOW_INDEX_OUT_PORT);
+    }
+}
+
+/* Appends the flows on 'list', whose elements are linked through
+ * 'links[field]', to the 'n' flows in 'flows'.  Returns the new number of
+ * flows. */
+static size_t
+collect_flows(const struct list *list, enum flow_index_field field,
+              struct sw_flow **flows, size_t n)
+{
+    const struct list *node;
+
+    for (node = list->next; node != list; node = node->next) {
+        const struct flow_index_link *link;
+        const struct flow_index_entry *e;
+
+        link = CONTAINER_OF(node, struct flow_index_link, node) - field;
+        e = CONTAINER_OF(link, struct flow_index_entry, links);
+        flows[n++] = e->flow;
+    }
+    return n;
+}
+
+/* Initializes 'cursor' to visit, through flow_index_cursor_next(), every flow
+ * in 'fi' that might match 'key' and have 'out_port' (in network byte order)
+ * as an output port, plus possibly others that do not.  If the request does
+ * not specify any indexed field, or if the index would not rule out many
+ * flows, the cursor visits every flow on 'all_flows', which must contain all
+ * of the table's flows linked through their 'iter_node' members.
+ *
+ * The caller may remove the flow most recently returned by the cursor from
+ * the table, or change its actions, but must not otherwise change the table
+ * until the cursor is destroyed. */
+void
+flow_index_cursor_init(struct flow_index_cursor *cursor,
+                       const struct flow_index *fi,
+                       const struct sw_flow_key *key, uint16_t out_port,
+                       struct list *all_flows)
+{
+    const struct flow_index_bucket *best_bucket = NULL;
+    size_t best_n = fi->n_flows / 2;
+    int best = -1;
+    int i;
+
+    memset(cursor, 0, sizeof *cursor);
+    cursor->all_flows = all_flows;
+    cursor->next = all_flows->next;
+
+    for (i = 0; i < FLOW_INDEX_N_FIELDS; i++) {
+        const struct flow_index_set *set = &fi->sets[i];
+        const struct flow_index_bucket *b;
+        uint64_t value;
+        size_t n;
+
+        if (!request_field_value(key, out_port, i, &value)) {
+            continue;
+        }
+        b = find_bucket(set, i, value);
+        n = (b ? b->n_flows : 0) + set->n_others;
+        if (n < best_n) {
+            best = i;
+            best_n = n;
+            best_bucket = b;
+        }
+    }
+
+    if (best >= 0) {
+        size_t n = 0;
+
+        cursor->all_flows = NULL;
+        cursor->flows = xmalloc(MAX(best_n, 1) * sizeof *cursor->flows);
+        if (best_bucket) {
+            n = collect_flows(&best_bucket->flows, best, cursor->flows, n);
+        }
+        n = collect_flows(&fi->sets[best].others, best, cursor->flows, n);
+        cursor->n_flows = n;
+    }
+}
+
+/* Returns the next flow that 'cursor' visits, or a null pointer if it has
+ * visited them all. */
+struct sw_flow *
+flow_index_cursor_next(struct flow_index_cursor *cursor)
+{
+    if (!cursor->all_flows) {
+        return (cursor->ofs < cursor->n_flows
+                ? cursor->flows[cursor->ofs++]
+                : NULL);
+    } else if (cursor->next != cursor->all_flows) {
+        struct sw_flow *flow = CONTAINER_OF(cursor->next, struct sw_flow,
+                                            iter_node);
+        cursor->next = cursor->next->next;
+        return flow;
+    } else {
+        return NULL;
+    }
+}
+
+void
+flow_index_cursor_destroy(struct flow_index_cursor *cursor)
+{
+    free(cursor->flows);
+}
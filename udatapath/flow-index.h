@@ -0,0 +1,106 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Secondary indexes for wildcarded flow_mod requests.
+ *
+ * A flow_mod whose match has wildcards, or one that names an output port,
+ * may apply to any number of flows.  A table can find the flows that it
+ * applies to only by comparing the request against every flow it holds, or,
+ * if it keeps a flow_index, by comparing it against the flows that the
+ * flow_index says might match.
+ *
+ * A flow_index indexes flows by the fields that such requests most often
+ * specify: the input port, the Ethernet destination, and the output port of
+ * flows whose actions are a single output action.  Each field has a hash of
+ * buckets, one per value, plus a list of the flows that the field does not
+ * index: those that wildcard it, or, for the output port, those with other
+ * actions.  A request that specifies a field can only apply to the flows in
+ * that field's bucket for its value and to the unindexed flows, so
+ * flow_index_cursor_init() picks whichever specified field leaves the fewest
+ * of those candidates. */
+
+#ifndef FLOW_INDEX_H
+#define FLOW_INDEX_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "hmap.h"
+#include "list.h"
+
+struct sw_flow;
+struct sw_flow_key;
+
+enum flow_index_field {
+    FLOW_INDEX_IN_PORT,
+    FLOW_INDEX_DL_DST,
+    FLOW_INDEX_OUT_PORT,
+    FLOW_INDEX_N_FIELDS
+};
+
+struct flow_index {
+    struct flow_index_set {
+        struct hmap buckets;    /* Contains "struct flow_index_bucket"s. */
+        struct list others;     /* Flows that this field does not index. */
+        size_t n_others;        /* Number of flows in 'others'. */
+    } sets[FLOW_INDEX_N_FIELDS];
+    size_t n_flows;             /* Number of flows in the index. */
+};
+
+void flow_index_init(struct flow_index *);
+void flow_index_destroy(struct flow_index *);
+void flow_index_insert(struct flow_index *, struct sw_flow *);
+void flow_index_remove(struct flow_index *, struct sw_flow *);
+void flow_index_update_actions(struct flow_index *, struct sw_flow *);
+void flow_index_disable(void);
+
+/* Iterates over the flows that a request might apply to. */
+struct flow_index_cursor {
+    /* If an index applied, the candidate flows. */
+    struct sw_flow **flows;
+    size_t n_flows;             /* Number of flows in 'flows'. */
+    size_t ofs;                 /* Index of the next flow in 'flows'. */
+
+    /* Otherwise, every flow in the table, linked through 'iter_node'. */
+    struct list *all_flows;     /* Null if an index applied. */
+    struct list *next;          /* Next element of 'all_flows'. */
+};
+
+void flow_index_cursor_init(struct flow_index_cursor *,
+                            const struct flow_index *,
+                            const struct sw_flow_key *, uint16_t out_port,
+                            struct list *all_flows);
+struct sw_flow *flow_index_cursor_next(struct flow_index_cursor *);
+void flow_index_cursor_destroy(struct flow_index_cursor *);
+
+#endif /* flow-index.h */
@@ -0,0 +1,150 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#include <config.h>
+#include "flow-wheel.h"
+#include <limits.h>
+#include "openflow/openflow.h"
+#include "switch-flow.h"
+#include "timeval.h"
+
+/* Flows in the wheel are linked through 'node', which the tables that use a
+ * flow_wheel do not otherwise need until a flow has been removed. */
+
+void
+flow_wheel_init(struct flow_wheel *fw)
+{
+    int i;
+
+    for (i = 0; i < FLOW_WHEEL_SLOTS; i++) {
+        list_init(&fw->slots[i]);
+    }
+    fw->last_sec = time_msec() / 1000;
+    fw->n_flows = 0;
+}
+
+/* Returns the time, in milliseconds, after which 'flow' will time out if it
+ * is not used in the meantime, or LLONG_MAX if it has no timeouts. */
+static long long int
+flow_deadline(const struct sw_flow *flow)
+{
+    long long int deadline = LLONG_MAX;
+
+    if (flow->idle_timeout != OFP_FLOW_PERMANENT) {
+        deadline = flow->used + flow->idle_timeout * 1000;
+    }
+    if (flow->hard_timeout != OFP_FLOW_PERMANENT) {
+        long long int hard = flow->created + flow->hard_timeout * 1000;
+        if (hard < deadline) {
+            deadline = hard;
+        }
+    }
+    return deadline;
+}
+
+/* Adds 'flow' to 'fw', if it has a timeout.  A flow must be passed to
+ * flow_wheel_remove() before it is freed or added again. */
+void
+flow_wheel_insert(struct flow_wheel *fw, struct sw_flow *flow)
+{
+    long long int deadline = flow_deadline(flow);
+    long long int sec;
+
+    if (deadline == LLONG_MAX) {
+        list_init(&flow->node);
+        return;
+    }
+
+    /* flow_timeout() considers a flow expired once the current time is past
+     * its deadline, so check it in the following second. */
+    sec = deadline / 1000 + 1;
+    if (sec <= fw->last_sec) {
+        sec = fw->last_sec + 1;
+    }
+    list_push_back(&fw->slots[sec % FLOW_WHEEL_SLOTS], &flow->node);
+    fw->n_flows++;
+}
+
+/* Removes 'flow' from 'fw', if it is there. */
+void
+flow_wheel_remove(struct flow_wheel *fw, struct sw_flow *flow)
+{
+    if (!list_is_empty(&flow->node)) {
+        list_remove(&flow->node);
+        list_init(&flow->node);
+        fw->n_flows--;
+    }
+}
+
+/* Expires the flows in 'fw' whose time has come.  Each expired flow is taken
+ * out of 'fw', passed to 'remove' along with 'aux' to take it out of its
+ * table, and appended to 'deleted'.  Flows that turn out to have been used
+ * since they were added to 'fw' are moved to the slot for their new
+ * deadline. */
+void
+flow_wheel_run(struct flow_wheel *fw,
+               void (*remove)(struct sw_flow *, void *aux), void *aux,
+               struct list *deleted)
+{
+    long long int now_sec = time_msec() / 1000;
+    long long int sec;
+
+    /* After a long stall, one revolution visits every slot. */
+    if (now_sec - fw->last_sec > FLOW_WHEEL_SLOTS) {
+        fw->last_sec = now_sec - FLOW_WHEEL_SLOTS;
+    }
+
+    for (sec = fw->last_sec + 1; sec <= now_sec; sec++) {
+        struct list *slot = &fw->slots[sec % FLOW_WHEEL_SLOTS];
+        struct sw_flow *flow, *next;
+        struct list due;
+
+        if (list_is_empty(slot)) {
+            continue;
+        }
+        list_init(&due);
+        list_splice(&due, slot->next, slot);
+
+        fw->last_sec = sec;
+        LIST_FOR_EACH_SAFE (flow, next, struct sw_flow, node, &due) {
+            flow_wheel_remove(fw, flow);
+            if (flow_timeout(flow)) {
+                remove(flow, aux);
+                list_push_back(deleted, &flow->node);
+            } else {
+                flow_wheel_insert(fw, flow);
+            }
+        }
+    }
+    fw->last_sec = now_sec;
+}
@@ -0,0 +1,70 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Timing wheel for flow expiration.
+ *
+ * A table that uses a flow_wheel adds each of its flows that has an idle or
+ * hard timeout to the slot for the second in which the flow will next be due
+ * to expire, so that flow_wheel_run() only has to look at flows that are
+ * probably due rather than at every flow in the table.  A flow that has been
+ * used since it was added to the wheel is not moved at the time of use.
+ * Instead, flow_wheel_run() notices that it has not expired after all and
+ * moves it to the slot for its new deadline.
+ *
+ * The wheel has FLOW_WHEEL_SLOTS slots of one second each.  A flow whose
+ * deadline is farther away than that shares a slot with flows due sooner and
+ * is simply moved along once per revolution. */
+
+#ifndef FLOW_WHEEL_H
+#define FLOW_WHEEL_H 1
+
+#include "list.h"
+
+struct sw_flow;
+
+#define FLOW_WHEEL_SLOTS 1024
+
+struct flow_wheel {
+    struct list slots[FLOW_WHEEL_SLOTS]; /* Contains "struct sw_flow"s. */
+    long long int last_sec;     /* Last second processed. */
+    unsigned int n_flows;       /* Number of flows in the wheel. */
+};
+
+void flow_wheel_init(struct flow_wheel *);
+void flow_wheel_insert(struct flow_wheel *, struct sw_flow *);
+void flow_wheel_remove(struct flow_wheel *, struct sw_flow *);
+void flow_wheel_run(struct flow_wheel *,
+                    void (*remove)(struct sw_flow *, void *aux), void *aux,
+                    struct list *deleted);
+
+#endif /* flow-wheel.h */
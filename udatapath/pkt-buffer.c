@@ -0,0 +1,225 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+
+#include <config.h>
+#include "pkt-buffer.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include "list.h"
+#include "ofpbuf.h"
+#include "timeval.h"
+#include "util.h"
+
+struct pkt_buffer {
+    struct list node;           /* In 'age_list' if 'buffer' is nonnull,
+                                 * otherwise in 'free_list'. */
+    struct ofpbuf *buffer;      /* Buffered packet, if any. */
+    uint32_t cookie;            /* Cookie of the last packet saved here. */
+    bool expired;               /* Last packet was aged out, not used. */
+    long long int saved;        /* Time the packet was saved, in ms. */
+};
+
+struct pkt_buffers {
+    struct pkt_buffer *slots;
+    int bits;                   /* log2 of the number of slots. */
+    uint32_t mask;              /* Number of slots, minus 1. */
+    uint32_t max_cookie;        /* Largest valid cookie. */
+    struct list age_list;       /* Slots holding packets, oldest first. */
+    struct list free_list;      /* Empty slots. */
+    struct pkt_buffer_stats stats;
+};
+
+/* Creates and returns a new packet buffer store with room for at least
+ * 'n_buffers' packets, rounded up to a power of 2 and to the limits in
+ * pkt-buffer.h. */
+struct pkt_buffers *
+pkt_buffers_create(unsigned int n_buffers)
+{
+    struct pkt_buffers *pb;
+    uint32_t i;
+    int bits;
+
+    for (bits = PKT_BUFFER_MIN_BITS;
+         bits < PKT_BUFFER_MAX_BITS && (1u << bits) < n_buffers; bits++) {
+        continue;
+    }
+
+    pb = xcalloc(1, sizeof *pb);
+    pb->bits = bits;
+    pb->mask = (1u << bits) - 1;
+    /* Don't use the maximum cookie value since the all-bits-1 ID is
+     * special. */
+    pb->max_cookie = (1u << (32 - bits)) - 2;
+    pb->slots = xcalloc(1u << bits, sizeof *pb->slots);
+    list_init(&pb->age_list);
+    list_init(&pb->free_list);
+    for (i = 0; i <= pb->mask; i++) {
+        list_push_back(&pb->free_list, &pb->slots[i].node);
+    }
+    pb->stats.n_buffers = 1u << bits;
+    return pb;
+}
+
+/* Destroys 'pb' and the packets buffered in it. */
+void
+pkt_buffers_destroy(struct pkt_buffers *pb)
+{
+    if (pb) {
+        struct pkt_buffer *p;
+
+        LIST_FOR_EACH (p, struct pkt_buffer, node, &pb->age_list) {
+            ofpbuf_delete(p->buffer);
+        }
+        free(pb->slots);
+        free(pb);
+    }
+}
+
+/* Returns the number of packets that 'pb' can hold. */
+unsigned int
+pkt_buffers_capacity(const struct pkt_buffers *pb)
+{
+    return pb->mask + 1;
+}
+
+/* Empties 'p', which must hold a packet, and moves it to the free list.
+ * Returns the packet that it held. */
+static struct ofpbuf *
+release_slot(struct pkt_buffers *pb, struct pkt_buffer *p)
+{
+    struct ofpbuf *buffer = p->buffer;
+
+    p->buffer = NULL;
+    list_remove(&p->node);
+    list_push_back(&pb->free_list, &p->node);
+    pb->stats.n_active--;
+    return buffer;
+}
+
+/* Drops the packet in 'p', which must hold one, without its having been
+ * used, and moves 'p' to the free list. */
+static void
+expire_slot(struct pkt_buffers *pb, struct pkt_buffer *p)
+{
+    ofpbuf_delete(release_slot(pb, p));
+    p->expired = true;
+    pb->stats.n_expired++;
+}
+
+/* Saves a reference to 'buffer' in 'pb' and returns its ID, or UINT32_MAX if
+ * 'pb' is full of packets too young to be overwritten.  The caller retains
+ * its own reference to 'buffer'. */
+uint32_t
+pkt_buffers_save(struct pkt_buffers *pb, struct ofpbuf *buffer)
+{
+    long long int now = time_msec();
+    struct pkt_buffer *p;
+
+    if (list_is_empty(&pb->free_list)) {
+        p = CONTAINER_OF(pb->age_list.next, struct pkt_buffer, node);
+        if (now - p->saved < PKT_BUFFER_MIN_AGE) {
+            pb->stats.n_refused++;
+            return UINT32_MAX;
+        }
+        expire_slot(pb, p);
+    }
+
+    p = CONTAINER_OF(list_pop_front(&pb->free_list), struct pkt_buffer, node);
+    list_push_back(&pb->age_list, &p->node);
+    if (++p->cookie > pb->max_cookie) {
+        p->cookie = 0;
+    }
+    p->buffer = ofpbuf_share(buffer);
+    p->expired = false;
+    p->saved = now;
+    pb->stats.n_active++;
+    pb->stats.n_saved++;
+
+    return (p - pb->slots) | (p->cookie << pb->bits);
+}
+
+/* Removes the packet with the given 'id' from 'pb' and returns it, passing
+ * ownership of the reference to the caller.  Returns NULL if 'pb' no longer
+ * holds that packet. */
+struct ofpbuf *
+pkt_buffers_retrieve(struct pkt_buffers *pb, uint32_t id)
+{
+    struct pkt_buffer *p = &pb->slots[id & pb->mask];
+
+    if (p->cookie != id >> pb->bits || (!p->buffer && p->expired)) {
+        pb->stats.n_stale++;
+        return NULL;
+    } else if (!p->buffer) {
+        pb->stats.n_miss++;
+        return NULL;
+    }
+    pb->stats.n_hit++;
+    return release_slot(pb, p);
+}
+
+/* Drops the packet with the given 'id' from 'pb', if it is still there. */
+void
+pkt_buffers_discard(struct pkt_buffers *pb, uint32_t id)
+{
+    struct pkt_buffer *p = &pb->slots[id & pb->mask];
+
+    if (p->cookie == id >> pb->bits && p->buffer) {
+        ofpbuf_delete(release_slot(pb, p));
+    }
+}
+
+/* Drops the packets that have been in 'pb' for longer than
+ * PKT_BUFFER_MAX_AGE ms. */
+void
+pkt_buffers_run(struct pkt_buffers *pb)
+{
+    long long int now = time_msec();
+
+    while (!list_is_empty(&pb->age_list)) {
+        struct pkt_buffer *p = CONTAINER_OF(pb->age_list.next,
+                                            struct pkt_buffer, node);
+        if (now - p->saved < PKT_BUFFER_MAX_AGE) {
+            break;
+        }
+        expire_slot(pb, p);
+    }
+}
+
+/* Stores statistics for 'pb' into '*stats'. */
+void
+pkt_buffers_get_stats(const struct pkt_buffers *pb,
+                      struct pkt_buffer_stats *stats)
+{
+    *stats = pb->stats;
+}
@@ -0,0 +1,91 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+
+/* Store for packets sent to the controller in packet-in messages.
+ *
+ * A buffered packet is identified to the controller by a 32-bit opaque ID.
+ * The low bits of the ID are the index of a slot in an array, whose size is
+ * set when the store is created, and the high bits are a cookie that
+ * distinguishes between the packets that have occupied the same slot over
+ * time.  Thus, the more buffers the store has, the lower-quality the
+ * cookie.
+ *
+ * Slots that hold packets are kept on a list in the order they were filled,
+ * so that the oldest packets are the first to be aged out and the first to
+ * be overwritten when every slot is in use.  A packet is never overwritten
+ * until it has been buffered for PKT_BUFFER_MIN_AGE ms, to give the
+ * controller a chance to use it, and it is dropped after PKT_BUFFER_MAX_AGE
+ * ms whether the store is full or not. */
+
+#ifndef PKT_BUFFER_H
+#define PKT_BUFFER_H 1
+
+#include <stdint.h>
+
+struct ofpbuf;
+
+/* Limits on the number of buffers in a store. */
+#define PKT_BUFFER_MIN_BITS 4
+#define PKT_BUFFER_MAX_BITS 20
+
+#define PKT_BUFFER_MIN_AGE 1000
+#define PKT_BUFFER_MAX_AGE 5000
+
+struct pkt_buffer_stats {
+    unsigned int n_buffers;     /* Number of slots. */
+    unsigned int n_active;      /* Number of slots that hold a packet. */
+    uint64_t n_saved;           /* Packets buffered. */
+    uint64_t n_refused;         /* Packets not buffered because the store was
+                                 * full of packets too young to overwrite. */
+    uint64_t n_expired;         /* Packets aged out or overwritten unused. */
+    uint64_t n_hit;             /* Retrievals that found their packet. */
+    uint64_t n_miss;            /* Retrievals of a packet that had already been
+                                 * retrieved or discarded. */
+    uint64_t n_stale;           /* Retrievals of a packet that had been aged
+                                 * out or overwritten. */
+};
+
+struct pkt_buffers *pkt_buffers_create(unsigned int n_buffers);
+void pkt_buffers_destroy(struct pkt_buffers *);
+unsigned int pkt_buffers_capacity(const struct pkt_buffers *);
+
+uint32_t pkt_buffers_save(struct pkt_buffers *, struct ofpbuf *);
+struct ofpbuf *pkt_buffers_retrieve(struct pkt_buffers *, uint32_t id);
+void pkt_buffers_discard(struct pkt_buffers *, uint32_t id);
+void pkt_buffers_run(struct pkt_buffers *);
+
+void pkt_buffers_get_stats(const struct pkt_buffers *,
+                           struct pkt_buffer_stats *);
+
+#endif /* pkt-buffer.h */
@@ -37,32 +37,76 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "ofpbuf.h"
 #include "openflow/openflow.h"
 #include "openflow/nicira-ext.h"
 #include "packets.h"
+#include "table.h"
 #include "timeval.h"
 
 #define THIS_MODULE VLM_chain
 #include "vlog.h"
 
-/* Internal function used to compare fields in flow. */
-static inline int
-flow_fields_match(const struct flow *a, const struct flow *b, uint32_t w,
-                  uint32_t src_mask, uint32_t dst_mask)
+BUILD_ASSERT_DECL(sizeof(struct flow) == 36);
+
+/* Returns true if 'a' and 'b' are equal in every bit that is 1 in both 'm1'
+ * and 'm2'.  Each struct flow is compared as a 36-byte block, with a few wide
+ * XORs and ANDs instead of a branch per field. */
+static inline bool
+flow_masked_equal(const struct flow *a, const struct flow *b,
+                  const struct flow *m1, const struct flow *m2)
 {
-    return ((w & OFPFW_IN_PORT || a->in_port == b->in_port)
-            && (w & OFPFW_DL_VLAN || a->dl_vlan == b->dl_vlan)
-            && (w & OFPFW_DL_VLAN_PCP || a->dl_vlan_pcp == b->dl_vlan_pcp)
-            && (w & OFPFW_DL_SRC || eth_addr_equals(a->dl_src, b->dl_src))
-            && (w & OFPFW_DL_DST || eth_addr_equals(a->dl_dst, b->dl_dst))
-            && (w & OFPFW_DL_TYPE || a->dl_type == b->dl_type)
-            && (w & OFPFW_NW_TOS || a->nw_tos == b->nw_tos)
-            && (w & OFPFW_NW_PROTO || a->nw_proto == b->nw_proto)
-            && !((a->nw_src ^ b->nw_src) & src_mask)
-            && !((a->nw_dst ^ b->nw_dst) & dst_mask)
-            && (w & OFPFW_TP_SRC || a->tp_src == b->tp_src)
-            && (w & OFPFW_TP_DST || a->tp_dst == b->tp_dst));
+    const uint8_t *pa = (const uint8_t *) a;
+    const uint8_t *pb = (const uint8_t *) b;
+    const uint8_t *p1 = (const uint8_t *) m1;
+    const uint8_t *p2 = (const uint8_t *) m2;
+    uint32_t ta, tb, t1, t2;
+
+    memcpy(&ta, pa + 32, 4);
+    memcpy(&tb, pb + 32, 4);
+    memcpy(&t1, p1 + 32, 4);
+    memcpy(&t2, p2 + 32, 4);
+    if ((ta ^ tb) & t1 & t2) {
+        return false;
+    }
+
+#ifdef __SSE2__
+    {
+        __m128i x0, x1;
+
+        x0 = _mm_and_si128(
+            _mm_xor_si128(_mm_loadu_si128((const __m128i *) pa),
+                          _mm_loadu_si128((const __m128i *) pb)),
+            _mm_and_si128(_mm_loadu_si128((const __m128i *) p1),
+                          _mm_loadu_si128((const __m128i *) p2)));
+        x1 = _mm_and_si128(
+            _mm_xor_si128(_mm_loadu_si128((const __m128i *) (pa + 16)),
+                          _mm_loadu_si128((const __m128i *) (pb + 16))),
+            _mm_and_si128(_mm_loadu_si128((const __m128i *) (p1 + 16)),
+                          _mm_loadu_si128((const __m128i *) (p2 + 16))));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(x0, x1),
+                                                _mm_setzero_si128())) == 0xffff;
+    }
+#else
+    {
+        uint64_t diff = 0;
+        int i;
+
+        for (i = 0; i < 32; i += 8) {
+            uint64_t wa, wb, w1, w2;
+
+            memcpy(&wa, pa + i, 8);
+            memcpy(&wb, pb + i, 8);
+            memcpy(&w1, p1 + i, 8);
+            memcpy(&w2, p2 + i, 8);
+            diff |= (wa ^ wb) & w1 & w2;
+        }
+        return !diff;
+    }
+#endif
 }
 
 static uint32_t make_nw_mask(int n_wild_bits)
@@ -71,13 +115,54 @@ static uint32_t make_nw_mask(int n_wild_bits)
     return n_wild_bits < 32 ? htonl(~((1u << n_wild_bits) - 1)) : 0;
 }
 
+/* Sets 'key->mask' according to 'key->wildcards'. */
+void
+flow_key_set_mask(struct sw_flow_key *key)
+{
+    struct flow *mask = &key->mask;
+    uint32_t w = key->wildcards;
+
+    memset(mask, 0, sizeof *mask);
+    mask->nw_src = make_nw_mask(w >> OFPFW_NW_SRC_SHIFT);
+    mask->nw_dst = make_nw_mask(w >> OFPFW_NW_DST_SHIFT);
+    if (!(w & OFPFW_IN_PORT)) {
+        mask->in_port = 0xffff;
+    }
+    if (!(w & OFPFW_DL_VLAN)) {
+        mask->dl_vlan = 0xffff;
+    }
+    if (!(w & OFPFW_DL_TYPE)) {
+        mask->dl_type = 0xffff;
+    }
+    if (!(w & OFPFW_TP_SRC)) {
+        mask->tp_src = 0xffff;
+    }
+    if (!(w & OFPFW_TP_DST)) {
+        mask->tp_dst = 0xffff;
+    }
+    if (!(w & OFPFW_DL_SRC)) {
+        memset(mask->dl_src, 0xff, sizeof mask->dl_src);
+    }
+    if (!(w & OFPFW_DL_DST)) {
+        memset(mask->dl_dst, 0xff, sizeof mask->dl_dst);
+    }
+    if (!(w & OFPFW_DL_VLAN_PCP)) {
+        mask->dl_vlan_pcp = 0xff;
+    }
+    if (!(w & OFPFW_NW_TOS)) {
+        mask->nw_tos = 0xff;
+    }
+    if (!(w & OFPFW_NW_PROTO)) {
+        mask->nw_proto = 0xff;
+    }
+}
+
 /* Returns nonzero if 'a' and 'b' match, that is, if their fields are equal
  * modulo wildcards in 'b', zero otherwise. */
 inline int
 flow_matches_1wild(const struct sw_flow_key *a, const struct sw_flow_key *b)
 {
-    return flow_fields_match(&a->flow, &b->flow, b->wildcards,
-                             b->nw_src_mask, b->nw_dst_mask);
+    return flow_masked_equal(&a->flow, &b->flow, &b->mask, &b->mask);
 }
 
 /* Returns nonzero if 'a' and 'b' match, that is, if their fields are equal
@@ -85,9 +170,7 @@ flow_matches_1wild(const struct sw_flow_key *a, const struct sw_flow_key *b)
 inline int
 flow_matches_2wild(const struct sw_flow_key *a, const struct sw_flow_key *b)
 {
-    return flow_fields_match(&a->flow, &b->flow, a->wildcards | b->wildcards,
-                             a->nw_src_mask & b->nw_src_mask,
-                             a->nw_dst_mask & b->nw_dst_mask);
+    return flow_masked_equal(&a->flow, &b->flow, &a->mask, &b->mask);
 }
 
 /* Returns nonzero if 't' (the table entry's key) and 'd' (the key 
@@ -178,9 +261,122 @@ flow_extract_match(struct sw_flow_key* to, const struct ofp_match* from)
         to->wildcards &= ~(OFPFW_NW | OFPFW_TP);
     }
 
-	/* We set these late because code above adjusts to->wildcards. */
-	to->nw_src_mask = make_nw_mask(to->wildcards >> OFPFW_NW_SRC_SHIFT);
-	to->nw_dst_mask = make_nw_mask(to->wildcards >> OFPFW_NW_DST_SHIFT);
+	/* We set this late because code above adjusts to->wildcards. */
+	flow_key_set_mask(to);
+}
+
+/* Flow slab. */
+
+#define CACHE_LINE_SIZE 64
+#define FLOW_SLOT_SIZE ROUND_UP(sizeof(struct sw_flow), CACHE_LINE_SIZE)
+#define FLOW_SLAB_CHUNK_FLOWS 256
+
+/* A free slot in the flow slab. */
+struct flow_slot {
+    struct flow_slot *next;
+};
+
+static struct flow_slot *free_slots;
+static struct flow_slab_stats slab_stats = { FLOW_SLOT_SIZE, 0, 0, 0, 0, 0 };
+
+/* Adds a new chunk of slots to the free list.  Returns false if memory is
+ * exhausted. */
+static bool
+flow_slab_grow(void)
+{
+    char *chunk;
+    int i;
+
+    chunk = malloc(FLOW_SLAB_CHUNK_FLOWS * FLOW_SLOT_SIZE + CACHE_LINE_SIZE);
+    if (!chunk) {
+        return false;
+    }
+    chunk = (char *) ROUND_UP((uintptr_t) chunk, CACHE_LINE_SIZE);
+    for (i = FLOW_SLAB_CHUNK_FLOWS - 1; i >= 0; i--) {
+        struct flow_slot *slot = (struct flow_slot *) (chunk
+                                                       + i * FLOW_SLOT_SIZE);
+        slot->next = free_slots;
+        free_slots = slot;
+    }
+
+    slab_stats.n_chunks++;
+    slab_stats.n_slots += FLOW_SLAB_CHUNK_FLOWS;
+    VLOG_DBG("flow slab grew to %u flows in %u chunks",
+             slab_stats.n_slots, slab_stats.n_chunks);
+    return true;
+}
+
+static struct sw_flow *
+flow_slab_alloc(void)
+{
+    struct flow_slot *slot;
+
+    if (!free_slots && !flow_slab_grow()) {
+        return NULL;
+    }
+    slot = free_slots;
+    free_slots = slot->next;
+
+    if (++slab_stats.n_used > slab_stats.max_used) {
+        slab_stats.max_used = slab_stats.n_used;
+    }
+    return (struct sw_flow *) slot;
+}
+
+static void
+flow_slab_free(struct sw_flow *flow)
+{
+    struct flow_slot *slot = (struct flow_slot *) flow;
+    slot->next = free_slots;
+    free_slots = slot;
+    slab_stats.n_used--;
+}
+
+/* Stores statistics about the flow slab in '*stats'. */
+void
+flow_slab_get_stats(struct flow_slab_stats *stats)
+{
+    *stats = slab_stats;
+}
+
+/* Returns storage for 'actions_len' bytes of actions for 'flow': its inline
+ * storage if the actions fit, otherwise a new heap block.  Returns a null
+ * pointer on failure. */
+static struct sw_flow_actions *
+flow_acts_alloc(struct sw_flow *flow, size_t actions_len)
+{
+    struct sw_flow_actions *sfa;
+
+    if (actions_len <= FLOW_INLINE_ACTIONS_LEN) {
+        return &flow->inline_acts.acts;
+    }
+    sfa = malloc(sizeof *sfa + FLOW_ACTS_SPACE(actions_len));
+    if (sfa) {
+        slab_stats.n_external++;
+    }
+    return sfa;
+}
+
+/* Frees 'sfa', which belongs to 'flow', unless it is inline. */
+static void
+flow_acts_free(struct sw_flow *flow, struct sw_flow_actions *sfa)
+{
+    if (sfa && sfa != &flow->inline_acts.acts) {
+        free(sfa);
+        slab_stats.n_external--;
+    }
+}
+
+/* Copies the 'actions_len' bytes of 'actions' into 'sfa', which must have room
+ * for them, and compiles them. */
+static void
+flow_acts_set(struct sw_flow_actions *sfa,
+              const struct ofp_action_header *actions, size_t actions_len)
+{
+    sfa->actions_len = actions_len;
+    memcpy(sfa->actions, actions, actions_len);
+    sfa->n_ops = flow_compile_actions(sfa->actions, actions_len, sfa_ops(sfa),
+                                      &sfa->out_port);
 }
 
 /* Allocates and returns a new flow with room for 'actions_len' actions. 
@@ -189,14 +385,16 @@ struct sw_flow *
 flow_alloc(size_t actions_len)
 {
     struct sw_flow_actions *sfa;
-    size_t size = sizeof *sfa + actions_len;
-    struct sw_flow *flow = calloc(1, sizeof *flow);
+    struct sw_flow *flow;
+
+    flow = flow_slab_alloc();
     if (!flow)
         return NULL;
+    memset(flow, 0, sizeof *flow);
 
-    sfa = calloc(1, size);
+    sfa = flow_acts_alloc(flow, actions_len);
     if (!sfa) {
-        free(flow);
+        flow_slab_free(flow);
         return NULL;
     }
     sfa->actions_len = actions_len;
@@ -218,10 +416,10 @@ flow_setup_actions(struct sw_flow *                    flow,
 			  actions_len, (unsigned long)flow->sf_acts->actions_len);
 
 	flow->used = flow->created = time_msec();
-	flow->sf_acts->actions_len = actions_len;
+	flow->changed = flow_generation;
 	flow->byte_count = 0;
 	flow->packet_count = 0;
-	memcpy(flow->sf_acts->actions, actions, actions_len);
+	flow_acts_set(flow->sf_acts, actions, actions_len);
 }
 
 /* Frees 'flow' immediately. */
@@ -231,27 +429,29 @@ flow_free(struct sw_flow *flow)
     if (!flow) {
         return; 
     }
-    free(flow->sf_acts);
-    free(flow);
+    flow_acts_free(flow, flow->sf_acts);
+    flow_slab_free(flow);
 }
 
-/* Copies 'actions' into a newly allocated structure for use by 'flow'
- * and frees the structure that defined the previous actions. */
+/* Copies 'actions' into 'flow', replacing its previous actions.  Short action
+ * lists are copied into the flow's inline storage, so that replacing them
+ * does not touch the heap. */
 void flow_replace_acts(struct sw_flow *flow, 
         const struct ofp_action_header *actions, size_t actions_len)
 {
     struct sw_flow_actions *sfa;
-    int size = sizeof *sfa + actions_len;
 
-    sfa = malloc(size);
+    sfa = flow_acts_alloc(flow, actions_len);
     if (unlikely(!sfa))
         return;
 
-    sfa->actions_len = actions_len;
-    memcpy(sfa->actions, actions, actions_len);
+    flow_acts_set(sfa, actions, actions_len);
 
-    free(flow->sf_acts);
-    flow->sf_acts = sfa;
+    if (flow->sf_acts != sfa) {
+        flow_acts_free(flow, flow->sf_acts);
+        flow->sf_acts = sfa;
+    }
+    flow->changed = flow_generation;
 
     return;
 }
@@ -308,34 +508,186 @@ bool flow_timeout(struct sw_flow *flow)
  * has the value OFPP_NONE. 'out_port' is in network-byte order. */
 int flow_has_out_port(struct sw_flow *flow, uint16_t out_port)
 {
-    struct sw_flow_actions *sf_acts = flow->sf_acts;
-    size_t actions_len = sf_acts->actions_len;
-    uint8_t *p = (uint8_t *)sf_acts->actions;
+    const struct sw_flow_actions *sf_acts = flow->sf_acts;
+    const struct sw_flow_op *op = sfa_ops(sf_acts);
+    const struct sw_flow_op *end = op + sf_acts->n_ops;
+    uint16_t port = ntohs(out_port);
 
-    if (out_port == htons(OFPP_NONE))
+    if (port == OFPP_NONE)
         return 1;
 
-    while (actions_len > 0) {
-        struct ofp_action_header *ah = (struct ofp_action_header *)p;
+    for (; op < end; op++) {
+        if (op->type == OFPAT_OUTPUT && op->arg == port) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Tables that keep their flows on a list through 'iter_node', newest first,
+ * resume an iteration by skipping the flows whose serial numbers show that
+ * they were already visited.  Walking past those flows again on every call
+ * makes a dump that takes many calls quadratic in the size of the table, so
+ * these functions also remember where the iteration stopped.
+ *
+ * flow_iterate_start() returns the node of 'flows' from which to resume the
+ * iteration at 'position'.  The table counts in 'n_removed' every flow that
+ * it removes or replaces.  If that count has not changed since
+ * flow_iterate_save() recorded 'position', the flow that the iteration stopped
+ * at is still on the list and the iteration picks up right after it.
+ * Otherwise it starts over at the head of the list, still skipping flows by
+ * serial number. */
+struct list *
+flow_iterate_start(struct list *flows,
+                   const struct sw_table_position *position,
+                   unsigned long int n_removed)
+{
+    struct sw_flow *last = (struct sw_flow *) position->private[1];
+
+    return (last && position->private[2] == n_removed
+            ? last->iter_node.next
+            : flows->next);
+}
+
+/* Records in 'position' that an iteration stopped at 'flow', for
+ * flow_iterate_start(). */
+void
+flow_iterate_save(struct sw_table_position *position, struct sw_flow *flow,
+                  unsigned long int n_removed)
+{
+    position->private[0] = ~(flow->serial - 1);
+    position->private[1] = (unsigned long) flow;
+    position->private[2] = n_removed;
+}
+
+/* Compiles the 'actions_len' bytes of 'actions', which must already have been
+ * validated, into 'ops', which must have room for one op per 8 bytes of
+ * actions.  Returns the number of ops.  Sets '*out_port' to the port if the
+ * actions are just an output to a port other than OFPP_CONTROLLER, which can
+ * be executed without looking at the ops, otherwise to OFPP_NONE. */
+size_t
+flow_compile_actions(const struct ofp_action_header *actions,
+                     size_t actions_len, struct sw_flow_op *ops,
+                     uint16_t *out_port)
+{
+    const uint8_t *start = (const uint8_t *) actions;
+    const uint8_t *p = start;
+    size_t n_ops = 0;
+
+    while (actions_len >= sizeof *actions) {
+        const struct ofp_action_header *ah = (const void *) p;
         size_t len = ntohs(ah->len);
+        struct sw_flow_op *op;
+
+        if (!len || len > actions_len) {
+            break;
+        }
 
-        if (ah->type == htons(OFPAT_OUTPUT)) {
-            struct ofp_action_output *oa = (struct ofp_action_output *)p;
-            if (oa->port == out_port) {
-                return 1;
-            }
+        op = &ops[n_ops++];
+        op->type = ntohs(ah->type);
+        op->arg = 0;
+        op->arg32 = 0;
+        switch (op->type) {
+        case OFPAT_OUTPUT: {
+            const struct ofp_action_output *oa = (const void *) ah;
+            op->arg = ntohs(oa->port);
+            op->arg32 = ntohs(oa->max_len);
+            break;
+        }
+        case OFPAT_ENQUEUE: {
+            const struct ofp_action_enqueue *ea = (const void *) ah;
+            op->arg = ntohs(ea->port);
+            op->arg32 = ntohl(ea->queue_id);
+            break;
+        }
+        case OFPAT_SET_VLAN_VID: {
+            const struct ofp_action_vlan_vid *va = (const void *) ah;
+            op->arg = ntohs(va->vlan_vid);
+            break;
+        }
+        case OFPAT_SET_VLAN_PCP: {
+            const struct ofp_action_vlan_pcp *va = (const void *) ah;
+            op->arg = (uint16_t) va->vlan_pcp << VLAN_PCP_SHIFT;
+            break;
+        }
+        case OFPAT_SET_NW_TOS: {
+            const struct ofp_action_nw_tos *nt = (const void *) ah;
+            op->arg = nt->nw_tos;
+            break;
+        }
+        case OFPAT_SET_NW_SRC:
+        case OFPAT_SET_NW_DST: {
+            const struct ofp_action_nw_addr *na = (const void *) ah;
+            op->arg32 = na->nw_addr;
+            break;
+        }
+        case OFPAT_SET_TP_SRC:
+        case OFPAT_SET_TP_DST: {
+            const struct ofp_action_tp_port *ta = (const void *) ah;
+            op->arg = ta->tp_port;
+            break;
         }
+        case OFPAT_STRIP_VLAN:
+            break;
+        default:
+            op->arg = p - start;
+            break;
+        }
+
         p += len;
         actions_len -= len;
     }
 
-    return 0;
+    *out_port = (n_ops == 1 && ops[0].type == OFPAT_OUTPUT
+                 && ops[0].arg != OFPP_CONTROLLER ? ops[0].arg : OFPP_NONE);
+    return n_ops;
 }
 
-void flow_used(struct sw_flow *flow, struct ofpbuf *buffer)
+/* True if flow_used() may be called for the same flow from more than one
+ * thread at a time. */
+static bool atomic_counters;
+
+/* Makes flow_used() update the packet and byte counters atomically, so that
+ * they stay accurate when several threads forward packets through the same
+ * flows.  Must be called before such threads are started. */
+void flow_use_atomic_counters(void)
 {
-    flow->used = time_msec();
+    atomic_counters = true;
+}
 
-    flow->packet_count++;
-    flow->byte_count += buffer->size;
+/* Flows are stamped with the current generation in their 'changed' member
+ * whenever they are created, have their actions replaced, or have their
+ * counters updated by flow_used(), so that a flow has changed since
+ * generation 'g' if its 'changed' is at least 'g'.  Only the main thread
+ * advances the generation, while it holds worker threads out of the
+ * tables. */
+uint32_t flow_generation = 1;
+
+/* Starts a new generation and returns it.  Flows that change from now on
+ * are stamped with the returned generation. */
+uint32_t
+flow_next_generation(void)
+{
+    return ++flow_generation;
+}
+
+/* Tables that keep their flows in a flow_wheel are not told about the new
+ * 'used' time: the flow is left in its slot and flow_wheel_run() re-arms it
+ * for its new idle deadline when the slot comes due. */
+void flow_used(struct sw_flow *flow, struct ofpbuf *buffer)
+{
+    if (!atomic_counters) {
+        flow->used = time_msec();
+        flow->changed = flow_generation;
+        flow->packet_count++;
+        flow->byte_count += buffer->size;
+    } else {
+        __atomic_store_n(&flow->used, time_msec(), __ATOMIC_RELAXED);
+        __atomic_store_n(&flow->changed,
+                         __atomic_load_n(&flow_generation, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+        __atomic_fetch_add(&flow->packet_count, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&flow->byte_count, buffer->size, __ATOMIC_RELAXED);
+    }
 }
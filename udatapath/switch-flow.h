@@ -37,23 +37,70 @@
 #include <time.h>
 #include "openflow/openflow.h"
 #include "flow.h"
+#include "hmap.h"
 #include "list.h"
 
+struct flow_index_entry;
 struct ofp_match;
+struct sw_table_position;
 
 /* Identification data for a flow. */
 struct sw_flow_key {
     struct flow flow;           /* Flow data (in network byte order). */
     uint32_t wildcards;         /* Wildcard fields (in host byte order). */
-    uint32_t nw_src_mask;       /* 1-bit in each significant nw_src bit. */
-    uint32_t nw_dst_mask;       /* 1-bit in each significant nw_dst bit. */
+    struct flow mask;           /* 1-bit in each significant bit of 'flow',
+                                 * according to 'wildcards'. */
+};
+
+/* An action compiled by flow_compile_actions(), so that executing it does not
+ * have to decode the OpenFlow action.  The operands depend on 'type':
+ *
+ *   OFPAT_OUTPUT: 'arg' is the port and 'arg32' the max_len.
+ *   OFPAT_ENQUEUE: 'arg' is the port and 'arg32' the queue id.
+ *   OFPAT_SET_VLAN_VID, OFPAT_SET_VLAN_PCP: 'arg' is the TCI bits to set.
+ *   OFPAT_SET_NW_TOS: 'arg' is the ToS.
+ *   OFPAT_SET_NW_SRC, OFPAT_SET_NW_DST: 'arg32' is the address.
+ *   OFPAT_SET_TP_SRC, OFPAT_SET_TP_DST: 'arg' is the port.
+ *   OFPAT_SET_DL_SRC, OFPAT_SET_DL_DST, OFPAT_VENDOR: 'arg' is the offset of
+ *     the OpenFlow action within the action list.
+ *
+ * Operands are in host byte order, except for the values of header fields,
+ * that is, addresses and transport ports, which are in network byte order so
+ * that they can be stored into packets as they are. */
+struct sw_flow_op {
+    uint16_t type;              /* One of OFPAT_*. */
+    uint16_t arg;
+    uint32_t arg32;
 };
 
 struct sw_flow_actions {
-    size_t actions_len;
+    uint32_t actions_len;       /* Length of 'actions' in bytes. */
+    uint16_t n_ops;             /* Number of ops (see sfa_ops()). */
+    uint16_t out_port;          /* If the actions are only an output to a port
+                                 * other than OFPP_CONTROLLER, that port,
+                                 * otherwise OFPP_NONE. */
     struct ofp_action_header actions[0];
 };
 
+/* Returns the compiled form of 'sfa''s actions, which follows them. */
+static inline struct sw_flow_op *
+sfa_ops(const struct sw_flow_actions *sfa)
+{
+    return (struct sw_flow_op *) ((uint8_t *) sfa->actions
+                                  + sfa->actions_len);
+}
+
+/* Bytes needed after struct sw_flow_actions for an action list 'LEN' bytes
+ * long and its compiled form, which has at most one op per 8 bytes. */
+#define FLOW_ACTS_SPACE(LEN) \
+    ((LEN) + (LEN) / sizeof(struct ofp_action_header) \
+     * sizeof(struct sw_flow_op))
+
+/* Action lists up to this many bytes long are stored, with their compiled
+ * form, inside struct sw_flow instead of in a separate allocation.  The value
+ * keeps a 64-bit sw_flow within 5 cache lines. */
+#define FLOW_INLINE_ACTIONS_LEN 48
+
 struct sw_flow {
     struct sw_flow_key key;
 
@@ -68,15 +115,36 @@ struct sw_flow {
     uint8_t reason;             /* Reason flow removed (one of OFPRR_*). */
     uint8_t send_flow_rem;      /* Send a flow removed to the controller */
     uint8_t emerg_flow;         /* Emergency flow indicator */
+    uint32_t changed;           /* flow_generation when last changed. */
 
     struct sw_flow_actions *sf_acts;
 
     /* Private to table implementations. */
     struct list node;
     struct list iter_node;
+    struct hmap_node hmap_node;
     unsigned long int serial;
 
     void *private;              /* Cookie for tables */
+    struct flow_index_entry *index_entry; /* See flow-index.c. */
+
+    /* Storage for 'sf_acts' if the actions are short enough. */
+    union {
+        struct sw_flow_actions acts;
+        uint8_t space[sizeof(struct sw_flow_actions)
+                      + FLOW_ACTS_SPACE(FLOW_INLINE_ACTIONS_LEN)];
+    } inline_acts;
+};
+
+/* Flows are allocated from a slab of cache-line-aligned slots, whose freed
+ * slots are reused by later allocations. */
+struct flow_slab_stats {
+    size_t slot_size;           /* Bytes per flow. */
+    unsigned int n_chunks;      /* Chunks obtained from the heap. */
+    unsigned int n_slots;       /* Flows that fit in those chunks. */
+    unsigned int n_used;        /* Flows currently allocated. */
+    unsigned int max_used;      /* Maximum value of 'n_used' so far. */
+    unsigned int n_external;    /* Flows whose actions are not inline. */
 };
 
 int flow_matches_1wild(const struct sw_flow_key *, const struct sw_flow_key *);
@@ -89,12 +157,25 @@ int flow_has_out_port(struct sw_flow *flow, uint16_t out_port);
 struct sw_flow *flow_alloc(size_t);
 void flow_setup_actions(struct sw_flow *, const struct ofp_action_header *, int);
 void flow_free(struct sw_flow *);
+void flow_slab_get_stats(struct flow_slab_stats *);
 void flow_replace_acts(struct sw_flow *, const struct ofp_action_header *, 
         size_t);
+size_t flow_compile_actions(const struct ofp_action_header *, size_t,
+                            struct sw_flow_op *, uint16_t *out_port);
 void flow_extract_match(struct sw_flow_key* to, const struct ofp_match* from);
+void flow_key_set_mask(struct sw_flow_key *);
+struct list *flow_iterate_start(struct list *,
+                                const struct sw_table_position *,
+                                unsigned long int n_removed);
+void flow_iterate_save(struct sw_table_position *, struct sw_flow *,
+                       unsigned long int n_removed);
 
 void print_flow(const struct sw_flow_key *);
 bool flow_timeout(struct sw_flow *flow);
 void flow_used(struct sw_flow *flow, struct ofpbuf *buffer);
+void flow_use_atomic_counters(void);
+
+extern uint32_t flow_generation;
+uint32_t flow_next_generation(void);
 
 #endif /* switch-flow.h */
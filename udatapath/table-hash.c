@@ -34,29 +34,46 @@
 #include <config.h>
 #include "table.h"
 #include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include "openflow/nicira-ext.h"
-#include "crc32.h"
 #include "datapath.h"
 #include "flow.h"
+#include "flow-hash.h"
 #include "switch-flow.h"
 
 struct sw_table_hash {
     struct sw_table swt;
-    struct crc32 crc32;
+    int hash_idx;             /* Which of the flow_hash_key2() hashes. */
     unsigned int n_flows;
     unsigned int bucket_mask; /* Number of buckets minus 1. */
     struct sw_flow **buckets;
 };
 
+static uint32_t hash_key(const struct sw_table_hash *th,
+                         const struct sw_flow_key *key)
+{
+    uint32_t hashes[2];
+
+    if (!th->hash_idx) {
+        return flow_hash_key(&key->flow);
+    }
+    flow_hash_key2(&key->flow, hashes);
+    return hashes[th->hash_idx];
+}
+
+static struct sw_flow **find_bucket__(struct sw_table *swt, uint32_t hash)
+{
+    struct sw_table_hash *th = (struct sw_table_hash *) swt;
+    return &th->buckets[hash & th->bucket_mask];
+}
+
 static struct sw_flow **find_bucket(struct sw_table *swt,
                                     const struct sw_flow_key *key)
 {
     struct sw_table_hash *th = (struct sw_table_hash *) swt;
-    unsigned int crc = crc32_calculate(&th->crc32, key, 
-            offsetof(struct sw_flow_key, wildcards));
-    return &th->buckets[crc & th->bucket_mask];
+    return find_bucket__(swt, hash_key(th, key));
 }
 
 static struct sw_flow *table_hash_lookup(struct sw_table *swt,
@@ -66,16 +83,15 @@ static struct sw_flow *table_hash_lookup(struct sw_table *swt,
     return flow && !flow_compare(&flow->key.flow, &key->flow) ? flow : NULL;
 }
 
-static int table_hash_insert(struct sw_table *swt, struct sw_flow *flow)
+/* Inserts 'flow', whose hash for 'swt' is 'hash', into 'swt'. */
+static int table_hash_insert__(struct sw_table *swt, struct sw_flow *flow,
+                               uint32_t hash)
 {
     struct sw_table_hash *th = (struct sw_table_hash *) swt;
     struct sw_flow **bucket;
     int retval;
 
-    if (flow->key.wildcards != 0)
-        return 0;
-
-    bucket = find_bucket(swt, &flow->key);
+    bucket = find_bucket__(swt, hash);
     if (*bucket == NULL) {
         th->n_flows++;
         *bucket = flow;
@@ -93,6 +109,15 @@ static int table_hash_insert(struct sw_table *swt, struct sw_flow *flow)
     return retval;
 }
 
+static int table_hash_insert(struct sw_table *swt, struct sw_flow *flow)
+{
+    struct sw_table_hash *th = (struct sw_table_hash *) swt;
+
+    if (flow->key.wildcards != 0)
+        return 0;
+    return table_hash_insert__(swt, flow, hash_key(th, &flow->key));
+}
+
 static int table_hash_modify(struct sw_table *swt, 
         const struct sw_flow_key *key, uint16_t priority, int strict,
         const struct ofp_action_header *actions, size_t actions_len) 
@@ -250,13 +275,18 @@ static int table_hash_iterate(struct sw_table *swt,
 
         for (i = position->private[0]; i <= th->bucket_mask; i++) {
             struct sw_flow *flow = th->buckets[i];
+            int error = 0;
+
             if (flow && flow_matches_1wild(&flow->key, key)
                     && flow_has_out_port(flow, out_port)) {
-                int error = callback(flow, private);
-                if (error) {
-                    position->private[0] = i + 1;
-                    return error;
-                }
+                error = callback(flow, private);
+            }
+            if (!error && table_position_visit(position)) {
+                error = EAGAIN;
+            }
+            if (error) {
+                position->private[0] = i + 1;
+                return error;
             }
         }
         return 0;
@@ -273,10 +303,12 @@ static void table_hash_stats(struct sw_table *swt,
     stats->max_flows = th->bucket_mask + 1;
     stats->n_lookup  = swt->n_lookup;
     stats->n_matched = swt->n_matched;
+    stats->n_buckets = th->bucket_mask + 1;
+    stats->max_chain = th->n_flows > 0;
 }
 
-struct sw_table *table_hash_create(unsigned int polynomial,
-                                   unsigned int n_buckets)
+static struct sw_table *table_hash_create__(int hash_idx,
+                                            unsigned int n_buckets)
 {
     struct sw_table_hash *th;
     struct sw_table *swt;
@@ -293,6 +325,7 @@ struct sw_table *table_hash_create(unsigned int polynomial,
         free(th);
         return NULL;
     }
+    th->hash_idx = hash_idx;
     th->n_flows = 0;
     th->bucket_mask = n_buckets - 1;
 
@@ -307,11 +340,14 @@ struct sw_table *table_hash_create(unsigned int polynomial,
     swt->iterate = table_hash_iterate;
     swt->stats = table_hash_stats;
 
-    crc32_init(&th->crc32, polynomial);
-
     return swt;
 }
 
+struct sw_table *table_hash_create(unsigned int n_buckets)
+{
+    return table_hash_create__(0, n_buckets);
+}
+
 /* Double-hashing table. */
 
 struct sw_table_hash2 {
@@ -323,10 +359,12 @@ static struct sw_flow *table_hash2_lookup(struct sw_table *swt,
                                           const struct sw_flow_key *key)
 {
     struct sw_table_hash2 *t2 = (struct sw_table_hash2 *) swt;
+    uint32_t hashes[2];
     int i;
-        
+
+    flow_hash_key2(&key->flow, hashes);
     for (i = 0; i < 2; i++) {
-        struct sw_flow *flow = *find_bucket(t2->subtable[i], key);
+        struct sw_flow *flow = *find_bucket__(t2->subtable[i], hashes[i]);
         if (flow && !flow_compare(&flow->key.flow, &key->flow))
             return flow;
     }
@@ -336,10 +374,15 @@ static struct sw_flow *table_hash2_lookup(struct sw_table *swt,
 static int table_hash2_insert(struct sw_table *swt, struct sw_flow *flow)
 {
     struct sw_table_hash2 *t2 = (struct sw_table_hash2 *) swt;
+    uint32_t hashes[2];
+
+    if (flow->key.wildcards != 0)
+        return 0;
 
-    if (table_hash_insert(t2->subtable[0], flow))
+    flow_hash_key2(&flow->key.flow, hashes);
+    if (table_hash_insert__(t2->subtable[0], flow, hashes[0]))
         return 1;
-    return table_hash_insert(t2->subtable[1], flow);
+    return table_hash_insert__(t2->subtable[1], flow, hashes[1]);
 }
 
 static int table_hash2_modify(struct sw_table *swt, 
@@ -418,6 +461,7 @@ static void table_hash2_stats(struct sw_table *swt,
     struct sw_table_stats substats[2];
     int i;
 
+    memset(substats, 0, sizeof substats);
     for (i = 0; i < 2; i++)
         table_hash_stats(t2->subtable[i], &substats[i]);
     stats->name = "hash2";
@@ -426,10 +470,12 @@ static void table_hash2_stats(struct sw_table *swt,
     stats->max_flows = substats[0].max_flows + substats[1].max_flows;
     stats->n_lookup  = swt->n_lookup;
     stats->n_matched = swt->n_matched;
+    stats->n_buckets = substats[0].n_buckets + substats[1].n_buckets;
+    stats->max_chain = MAX(substats[0].max_chain, substats[1].max_chain);
 }
 
-struct sw_table *table_hash2_create(unsigned int poly0, unsigned int buckets0,
-                                    unsigned int poly1, unsigned int buckets1)
+struct sw_table *table_hash2_create(unsigned int buckets0,
+                                    unsigned int buckets1)
 
 {
     struct sw_table_hash2 *t2;
@@ -440,11 +486,11 @@ struct sw_table *table_hash2_create(unsigned int poly0, unsigned int buckets0,
         return NULL;
     memset(t2, '\0', sizeof *t2);
 
-    t2->subtable[0] = table_hash_create(poly0, buckets0);
+    t2->subtable[0] = table_hash_create__(0, buckets0);
     if (t2->subtable[0] == NULL)
         goto out_free_t2;
 
-    t2->subtable[1] = table_hash_create(poly1, buckets1);
+    t2->subtable[1] = table_hash_create__(1, buckets1);
     if (t2->subtable[1] == NULL)
         goto out_free_subtable0;
 
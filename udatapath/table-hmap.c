@@ -0,0 +1,465 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Exact-match table built on a chained, resizable hash map.  Unlike
+ * table-hash, an insertion never fails because of a collision: colliding
+ * flows simply share a bucket, and the bucket array grows with the number of
+ * flows to keep the average chain short. */
+
+#include <config.h>
+#include "table.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flow.h"
+#include "flow-hash.h"
+#include "flow-index.h"
+#include "flow-wheel.h"
+#include "hmap.h"
+#include "list.h"
+#include "openflow/openflow.h"
+#include "openflow/nicira-ext.h"
+#include "switch-flow.h"
+#include "util.h"
+#include "datapath.h"
+
+struct sw_table_hmap {
+    struct sw_table swt;
+
+    unsigned int max_flows;
+    struct hmap flows;          /* Contains "struct sw_flow"s. */
+    struct list iter_flows;     /* All flows, most recently added first. */
+    unsigned long int next_serial;
+    unsigned long int n_removed; /* Flows ever removed or replaced. */
+    unsigned long long int n_probes; /* Flows compared during lookups. */
+    unsigned int *chains;       /* chains[i] is the number of buckets that
+                                   hold i flows, for i >= 1. */
+    unsigned int n_chains;      /* Number of elements in 'chains'. */
+    unsigned int max_chain;     /* Flows in the fullest bucket. */
+    struct flow_wheel wheel;    /* Flows with timeouts, by deadline. */
+    struct flow_index index;    /* Flows by fields that flow_mods specify. */
+};
+
+/* Looks up 'key' in 'th'.  If 'count_probes' is true, adds the number of
+ * flows compared to th->n_probes, atomically, since worker threads look up
+ * flows concurrently. */
+static struct sw_flow *
+hmap_table_find(struct sw_table_hmap *th, const struct flow *key,
+                bool count_probes)
+{
+    unsigned long long int n_probes = 0;
+    struct sw_flow *flow, *found = NULL;
+
+    HMAP_FOR_EACH_WITH_HASH (flow, struct sw_flow, hmap_node,
+                             flow_hash_key(key), &th->flows) {
+        n_probes++;
+        if (flow_equal(&flow->key.flow, key)) {
+            found = flow;
+            break;
+        }
+    }
+    if (count_probes && n_probes) {
+        __atomic_fetch_add(&th->n_probes, n_probes, __ATOMIC_RELAXED);
+    }
+    return found;
+}
+
+/* Returns the number of flows in the bucket of 'th' that 'hash' maps to. */
+static unsigned int
+hmap_table_chain_len(const struct sw_table_hmap *th, size_t hash)
+{
+    const struct hmap_node *node;
+    unsigned int n = 0;
+
+    for (node = th->flows.buckets[hash & th->flows.mask]; node;
+         node = node->next) {
+        n++;
+    }
+    return n;
+}
+
+/* Records that a bucket of 'th' that held 'old_len' flows now holds
+ * 'new_len', keeping th->max_chain up to date without scanning the buckets
+ * for table_hmap_stats(). */
+static void
+hmap_table_chain_changed(struct sw_table_hmap *th, unsigned int old_len,
+                         unsigned int new_len)
+{
+    if (new_len >= th->n_chains) {
+        unsigned int n = MAX(new_len + 1, th->n_chains * 2);
+
+        th->chains = xrealloc(th->chains, n * sizeof *th->chains);
+        memset(&th->chains[th->n_chains], 0,
+               (n - th->n_chains) * sizeof *th->chains);
+        th->n_chains = n;
+    }
+    if (old_len) {
+        th->chains[old_len]--;
+    }
+    if (new_len) {
+        th->chains[new_len]++;
+    }
+
+    if (new_len > th->max_chain) {
+        th->max_chain = new_len;
+    } else {
+        while (th->max_chain && !th->chains[th->max_chain]) {
+            th->max_chain--;
+        }
+    }
+}
+
+/* Counts the flows in every bucket of 'th' from scratch, after the bucket
+ * array has been resized. */
+static void
+hmap_table_count_chains(struct sw_table_hmap *th)
+{
+    size_t i;
+
+    if (th->n_chains) {
+        memset(th->chains, 0, th->n_chains * sizeof *th->chains);
+    }
+    th->max_chain = 0;
+    for (i = 0; i <= th->flows.mask; i++) {
+        unsigned int len = hmap_table_chain_len(th, i);
+        if (len) {
+            hmap_table_chain_changed(th, 0, len);
+        }
+    }
+}
+
+/* Removes 'flow' from 'th', without freeing it. */
+static void
+hmap_table_remove(struct sw_table_hmap *th, struct sw_flow *flow)
+{
+    unsigned int len = hmap_table_chain_len(th, flow->hmap_node.hash);
+
+    hmap_remove(&th->flows, &flow->hmap_node);
+    hmap_table_chain_changed(th, len, len - 1);
+    list_remove(&flow->iter_node);
+    flow_wheel_remove(&th->wheel, flow);
+    flow_index_remove(&th->index, flow);
+    th->n_removed++;
+}
+
+static void
+hmap_table_remove_cb(struct sw_flow *flow, void *th_)
+{
+    hmap_table_remove(th_, flow);
+}
+
+/* Gives back memory after a batch of deletions, if the bucket array has
+ * become much larger than necessary. */
+static void
+hmap_table_maybe_shrink(struct sw_table_hmap *th)
+{
+    if (hmap_count(&th->flows) < th->flows.mask / 4) {
+        hmap_shrink(&th->flows);
+        hmap_table_count_chains(th);
+    }
+}
+
+static struct sw_flow *table_hmap_lookup(struct sw_table *swt,
+                                         const struct sw_flow_key *key)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    return hmap_table_find(th, &key->flow, true);
+}
+
+static int table_hmap_insert(struct sw_table *swt, struct sw_flow *flow)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    struct sw_flow *old_flow;
+    size_t hash;
+
+    if (flow->key.wildcards != 0)
+        return 0;
+
+    old_flow = hmap_table_find(th, &flow->key.flow, false);
+    if (old_flow) {
+        hmap_remove(&th->flows, &old_flow->hmap_node);
+        hmap_insert_fast(&th->flows, &flow->hmap_node,
+                         old_flow->hmap_node.hash);
+        list_replace(&flow->iter_node, &old_flow->iter_node);
+        flow_wheel_remove(&th->wheel, old_flow);
+        flow_wheel_insert(&th->wheel, flow);
+        flow_index_remove(&th->index, old_flow);
+        flow_index_insert(&th->index, flow);
+        flow->serial = old_flow->serial;
+        th->n_removed++;
+        flow_free(old_flow);
+        return 1;
+    }
+
+    if (hmap_count(&th->flows) >= th->max_flows) {
+        return 0;
+    }
+
+    /* Keep the load factor at or below 1, so that a successful lookup
+     * usually compares against a single flow. */
+    hash = flow_hash_key(&flow->key.flow);
+    hmap_insert_fast(&th->flows, &flow->hmap_node, hash);
+    if (hmap_count(&th->flows) > th->flows.mask) {
+        hmap_reserve(&th->flows, hmap_count(&th->flows) * 2);
+        hmap_table_count_chains(th);
+    } else {
+        unsigned int len = hmap_table_chain_len(th, hash);
+        hmap_table_chain_changed(th, len - 1, len);
+    }
+    flow->serial = th->next_serial++;
+    list_push_front(&th->iter_flows, &flow->iter_node);
+    flow_wheel_insert(&th->wheel, flow);
+    flow_index_insert(&th->index, flow);
+    return 1;
+}
+
+static int table_hmap_modify(struct sw_table *swt,
+        const struct sw_flow_key *key, uint16_t priority, int strict,
+        const struct ofp_action_header *actions, size_t actions_len)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    struct sw_flow *flow;
+    unsigned int count = 0;
+
+    if (key->wildcards == 0) {
+        flow = hmap_table_find(th, &key->flow, false);
+        if (flow && flow_matches_desc(&flow->key, key, strict)
+                && (!strict || (flow->priority == priority))) {
+            flow_replace_acts(flow, actions, actions_len);
+            flow_index_update_actions(&th->index, flow);
+            count = 1;
+        }
+    } else {
+        struct flow_index_cursor cursor;
+
+        flow_index_cursor_init(&cursor, &th->index, key, htons(OFPP_NONE),
+                               &th->iter_flows);
+        while ((flow = flow_index_cursor_next(&cursor)) != NULL) {
+            if (flow_matches_desc(&flow->key, key, strict)
+                    && (!strict || (flow->priority == priority))) {
+                flow_replace_acts(flow, actions, actions_len);
+                flow_index_update_actions(&th->index, flow);
+                count++;
+            }
+        }
+        flow_index_cursor_destroy(&cursor);
+    }
+    return count;
+}
+
+static int table_hmap_has_conflict(struct sw_table *swt,
+                                   const struct sw_flow_key *key,
+                                   uint16_t priority, int strict)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    struct flow_index_cursor cursor;
+    struct sw_flow *flow;
+    bool conflict = false;
+
+    if (key->wildcards == 0) {
+        flow = hmap_table_find(th, &key->flow, false);
+        return (flow && flow_matches_2desc(&flow->key, key, strict)
+                && (flow->priority == priority));
+    }
+
+    flow_index_cursor_init(&cursor, &th->index, key, htons(OFPP_NONE),
+                           &th->iter_flows);
+    while ((flow = flow_index_cursor_next(&cursor)) != NULL) {
+        if (flow_matches_2desc(&flow->key, key, strict)
+                && (flow->priority == priority)) {
+            conflict = true;
+            break;
+        }
+    }
+    flow_index_cursor_destroy(&cursor);
+    return conflict;
+}
+
+/* Returns number of deleted flows.  We ignore the priority
+ * argument, since all exact-match entries are the same (highest)
+ * priority. */
+static int table_hmap_delete(struct datapath *dp, struct sw_table *swt,
+                             const struct sw_flow_key *key,
+                             uint16_t out_port,
+                             uint16_t priority UNUSED, int strict)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    struct sw_flow *flow;
+    unsigned int count = 0;
+
+    if (key->wildcards == 0) {
+        flow = hmap_table_find(th, &key->flow, false);
+        if (flow && flow_has_out_port(flow, out_port)) {
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            hmap_table_remove(th, flow);
+            flow_free(flow);
+            count = 1;
+        }
+    } else {
+        struct flow_index_cursor cursor;
+
+        flow_index_cursor_init(&cursor, &th->index, key, out_port,
+                               &th->iter_flows);
+        while ((flow = flow_index_cursor_next(&cursor)) != NULL) {
+            if (flow_matches_desc(&flow->key, key, strict)
+                    && flow_has_out_port(flow, out_port)) {
+                dp_send_flow_end(dp, flow, OFPRR_DELETE);
+                hmap_table_remove(th, flow);
+                flow_free(flow);
+                count++;
+            }
+        }
+        flow_index_cursor_destroy(&cursor);
+    }
+    hmap_table_maybe_shrink(th);
+    return count;
+}
+
+static void table_hmap_timeout(struct sw_table *swt, struct list *deleted)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+
+    flow_wheel_run(&th->wheel, hmap_table_remove_cb, th, deleted);
+    hmap_table_maybe_shrink(th);
+}
+
+static void table_hmap_destroy(struct sw_table *swt)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    struct sw_flow *flow, *n;
+
+    flow_index_destroy(&th->index);
+    LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, iter_node, &th->iter_flows) {
+        flow_free(flow);
+    }
+    hmap_destroy(&th->flows);
+    free(th->chains);
+    free(th);
+}
+
+static int table_hmap_iterate(struct sw_table *swt,
+                              const struct sw_flow_key *key,
+                              uint16_t out_port,
+                              struct sw_table_position *position,
+                              int (*callback)(struct sw_flow *, void *),
+                              void *private)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+    struct sw_flow *flow;
+    struct list *node;
+    unsigned long start;
+
+    if (key->wildcards == 0) {
+        if (position->private[0]) {
+            return 0;
+        }
+        position->private[0] = 1;
+        flow = hmap_table_find(th, &key->flow, false);
+        if (!flow || !flow_has_out_port(flow, out_port)) {
+            return 0;
+        }
+        return callback(flow, private);
+    }
+
+    /* Iterate by serial number, as table-linear does, so that resizing the
+     * hash map between calls neither skips nor repeats flows. */
+    start = ~position->private[0];
+    node = flow_iterate_start(&th->iter_flows, position, th->n_removed);
+    for (; node != &th->iter_flows; node = node->next) {
+        int error = 0;
+
+        flow = CONTAINER_OF(node, struct sw_flow, iter_node);
+        if (flow->serial > start) {
+            continue;
+        }
+        if (flow_matches_1wild(&flow->key, key)
+                && flow_has_out_port(flow, out_port)) {
+            error = callback(flow, private);
+        }
+        if (!error && table_position_visit(position)) {
+            error = EAGAIN;
+        }
+        if (error) {
+            flow_iterate_save(position, flow, th->n_removed);
+            return error;
+        }
+    }
+    return 0;
+}
+
+static void table_hmap_stats(struct sw_table *swt,
+                             struct sw_table_stats *stats)
+{
+    struct sw_table_hmap *th = (struct sw_table_hmap *) swt;
+
+    stats->name = "hash";
+    stats->wildcards = 0;        /* No wildcards are supported. */
+    stats->n_flows   = hmap_count(&th->flows);
+    stats->max_flows = th->max_flows;
+    stats->n_lookup  = swt->n_lookup;
+    stats->n_matched = swt->n_matched;
+    stats->n_buckets = th->flows.mask + 1;
+    stats->max_chain = th->max_chain;
+    stats->n_probes  = th->n_probes;
+}
+
+struct sw_table *table_hmap_create(unsigned int max_flows)
+{
+    struct sw_table_hmap *th;
+    struct sw_table *swt;
+
+    th = calloc(1, sizeof *th);
+    if (th == NULL)
+        return NULL;
+
+    swt = &th->swt;
+    swt->lookup = table_hmap_lookup;
+    swt->insert = table_hmap_insert;
+    swt->modify = table_hmap_modify;
+    swt->has_conflict = table_hmap_has_conflict;
+    swt->delete = table_hmap_delete;
+    swt->timeout = table_hmap_timeout;
+    swt->destroy = table_hmap_destroy;
+    swt->iterate = table_hmap_iterate;
+    swt->stats = table_hmap_stats;
+
+    th->max_flows = max_flows;
+    hmap_init(&th->flows);
+    list_init(&th->iter_flows);
+    th->next_serial = 1;
+    flow_wheel_init(&th->wheel);
+    flow_index_init(&th->index);
+
+    return swt;
+}
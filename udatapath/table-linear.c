@@ -33,6 +33,7 @@
 
 #include <config.h>
 #include "table.h"
+#include <errno.h>
 #include <stdlib.h>
 #include "flow.h"
 #include "list.h"
@@ -206,14 +207,21 @@ static int table_linear_iterate(struct sw_table *swt,
 
     start = ~position->private[0];
     LIST_FOR_EACH (flow, struct sw_flow, iter_node, &tl->iter_flows) {
-        if (flow->serial <= start 
-                && flow_matches_2wild(key, &flow->key)
+        int error = 0;
+
+        if (flow->serial > start) {
+            continue;
+        }
+        if (flow_matches_2wild(key, &flow->key)
                 && flow_has_out_port(flow, out_port)) {
-            int error = callback(flow, private);
-            if (error) {
-                position->private[0] = ~(flow->serial - 1);
-                return error;
-            }
+            error = callback(flow, private);
+        }
+        if (!error && table_position_visit(position)) {
+            error = EAGAIN;
+        }
+        if (error) {
+            position->private[0] = ~(flow->serial - 1);
+            return error;
         }
     }
     return 0;
@@ -256,7 +264,10 @@ struct sw_table *table_linear_create(unsigned int max_flows)
     tl->n_flows = 0;
     list_init(&tl->flows);
     list_init(&tl->iter_flows);
-    tl->next_serial = 0;
+
+    /* Serial 0 is reserved: an iteration that stops at serial 0 would
+     * otherwise record a position that restarts at the beginning. */
+    tl->next_serial = 1;
 
     return swt;
 }
@@ -0,0 +1,499 @@
+/* Copyright (c) 2009 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Tuple space search table.
+ *
+ * Flows are grouped into subtables according to the shape of their match,
+ * that is, the mask of significant bits in the flow's key.  Each subtable is
+ * a hash table keyed on the masked flow, so that a lookup costs one hash probe per distinct shape
+ * instead of one comparison per flow. */
+
+#include <config.h>
+#include "table.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flow.h"
+#include "flow-hash.h"
+#include "flow-index.h"
+#include "flow-wheel.h"
+#include "hmap.h"
+#include "list.h"
+#include "openflow/openflow.h"
+#include "openflow/nicira-ext.h"
+#include "switch-flow.h"
+#include "datapath.h"
+
+#define TSS_N_WORDS (sizeof(struct flow) / sizeof(uint32_t))
+BUILD_ASSERT_DECL(!(sizeof(struct flow) % sizeof(uint32_t)));
+
+/* A set of flows that all share the same match shape. */
+struct tss_subtable {
+    struct list node;           /* Element in sw_table_tss.subtables. */
+    struct flow mask;           /* 1-bit in each significant bit. */
+    struct hmap flows;          /* Contains "struct sw_flow"s. */
+    uint16_t max_priority;      /* No flow in 'flows' has higher priority. */
+};
+
+struct sw_table_tss {
+    struct sw_table swt;
+
+    unsigned int max_flows;
+    unsigned int n_flows;
+    struct list subtables;      /* In descending order of max_priority. */
+    struct list iter_flows;     /* All flows, most recently added first. */
+    unsigned long int next_serial;
+    unsigned long int n_removed; /* Flows ever removed or replaced. */
+    struct flow_wheel wheel;    /* Flows with timeouts, by deadline. */
+    struct flow_index index;    /* Flows by fields that flow_mods specify. */
+};
+
+/* Stores 'flow' masked by 'mask' into 'masked' and returns its hash. */
+static uint32_t
+tss_hash_masked(const struct flow *flow, const struct flow *mask,
+                struct flow *masked)
+{
+    const uint32_t *f = (const uint32_t *) flow;
+    const uint32_t *m = (const uint32_t *) mask;
+    uint32_t *dst = (uint32_t *) masked;
+    size_t i;
+
+    for (i = 0; i < TSS_N_WORDS; i++) {
+        dst[i] = f[i] & m[i];
+    }
+    return flow_hash_words(dst, TSS_N_WORDS);
+}
+
+/* Returns true if 'flow' masked by 'mask' equals 'masked'. */
+static bool
+tss_equal_masked(const struct flow *flow, const struct flow *mask,
+                 const struct flow *masked)
+{
+    const uint32_t *f = (const uint32_t *) flow;
+    const uint32_t *m = (const uint32_t *) mask;
+    const uint32_t *p = (const uint32_t *) masked;
+    size_t i;
+
+    for (i = 0; i < TSS_N_WORDS; i++) {
+        if ((f[i] & m[i]) != p[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static struct tss_subtable *
+tss_find_subtable(struct sw_table_tss *tt, const struct flow *mask)
+{
+    struct tss_subtable *st;
+
+    LIST_FOR_EACH (st, struct tss_subtable, node, &tt->subtables) {
+        if (flow_equal(&st->mask, mask)) {
+            return st;
+        }
+    }
+    return NULL;
+}
+
+/* Moves 'st', which is not in 'tt''s list of subtables, to its place in that
+ * list according to its max_priority. */
+static void
+tss_sort_subtable(struct sw_table_tss *tt, struct tss_subtable *st)
+{
+    struct tss_subtable *pos;
+
+    LIST_FOR_EACH (pos, struct tss_subtable, node, &tt->subtables) {
+        if (pos->max_priority < st->max_priority) {
+            break;
+        }
+    }
+    list_insert(&pos->node, &st->node);
+}
+
+static struct tss_subtable *
+tss_create_subtable(struct sw_table_tss *tt, const struct flow *mask)
+{
+    struct tss_subtable *st = malloc(sizeof *st);
+    if (st == NULL)
+        return NULL;
+
+    st->mask = *mask;
+    hmap_init(&st->flows);
+    st->max_priority = 0;
+    tss_sort_subtable(tt, st);
+    return st;
+}
+
+static void
+tss_destroy_subtable(struct tss_subtable *st)
+{
+    list_remove(&st->node);
+    hmap_destroy(&st->flows);
+    free(st);
+}
+
+/* Returns the flow in 'st' whose key is identical to 'key' in wildcards and
+ * significant fields and whose priority is 'priority', if any. */
+static struct sw_flow *
+tss_find_exact(struct tss_subtable *st, const struct sw_flow_key *key,
+               uint16_t priority)
+{
+    struct sw_flow *flow;
+    struct flow masked;
+    uint32_t hash;
+
+    hash = tss_hash_masked(&key->flow, &st->mask, &masked);
+    HMAP_FOR_EACH_WITH_HASH (flow, struct sw_flow, hmap_node, hash,
+                             &st->flows) {
+        if (flow->priority == priority
+                && flow->key.wildcards == key->wildcards
+                && tss_equal_masked(&flow->key.flow, &st->mask, &masked)) {
+            return flow;
+        }
+    }
+    return NULL;
+}
+
+/* Removes 'flow' from 'tt', without freeing it. */
+static void
+tss_remove(struct sw_table_tss *tt, struct sw_flow *flow)
+{
+    struct tss_subtable *st = flow->private;
+
+    hmap_remove(&st->flows, &flow->hmap_node);
+    list_remove(&flow->iter_node);
+    flow_wheel_remove(&tt->wheel, flow);
+    flow_index_remove(&tt->index, flow);
+    tt->n_removed++;
+    if (hmap_is_empty(&st->flows)) {
+        tss_destroy_subtable(st);
+    }
+    tt->n_flows--;
+}
+
+static void
+tss_remove_cb(struct sw_flow *flow, void *tt_)
+{
+    tss_remove(tt_, flow);
+}
+
+static struct sw_flow *table_tss_lookup(struct sw_table *swt,
+                                        const struct sw_flow_key *key)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct tss_subtable *st;
+    struct sw_flow *best = NULL;
+
+    LIST_FOR_EACH (st, struct tss_subtable, node, &tt->subtables) {
+        struct sw_flow *flow;
+        struct flow masked;
+        uint32_t hash;
+
+        if (best && best->priority > st->max_priority) {
+            break;
+        }
+
+        hash = tss_hash_masked(&key->flow, &st->mask, &masked);
+        HMAP_FOR_EACH_WITH_HASH (flow, struct sw_flow, hmap_node, hash,
+                                 &st->flows) {
+            if (tss_equal_masked(&flow->key.flow, &st->mask, &masked)
+                && (!best
+                    || flow->priority > best->priority
+                    || (flow->priority == best->priority
+                        && flow->serial < best->serial))) {
+                best = flow;
+            }
+        }
+    }
+    return best;
+}
+
+static int table_tss_insert(struct sw_table *swt, struct sw_flow *flow)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct tss_subtable *st;
+    struct sw_flow *f;
+    struct flow masked;
+    uint32_t hash;
+
+    st = tss_find_subtable(tt, &flow->key.mask);
+
+    /* Replace any flow that matches exactly. */
+    f = st ? tss_find_exact(st, &flow->key, flow->priority) : NULL;
+    if (f) {
+        hmap_remove(&st->flows, &f->hmap_node);
+        hmap_insert(&st->flows, &flow->hmap_node, f->hmap_node.hash);
+        list_replace(&flow->iter_node, &f->iter_node);
+        flow_wheel_remove(&tt->wheel, f);
+        flow_wheel_insert(&tt->wheel, flow);
+        flow_index_remove(&tt->index, f);
+        flow_index_insert(&tt->index, flow);
+        flow->serial = f->serial;
+        flow->private = st;
+        tt->n_removed++;
+        flow_free(f);
+        return 1;
+    }
+
+    /* Make sure there's room in the table. */
+    if (tt->n_flows >= tt->max_flows) {
+        return 0;
+    }
+    if (!st) {
+        st = tss_create_subtable(tt, &flow->key.mask);
+        if (!st) {
+            return 0;
+        }
+    }
+    tt->n_flows++;
+
+    hash = tss_hash_masked(&flow->key.flow, &flow->key.mask, &masked);
+    hmap_insert(&st->flows, &flow->hmap_node, hash);
+    if (flow->priority > st->max_priority) {
+        st->max_priority = flow->priority;
+        list_remove(&st->node);
+        tss_sort_subtable(tt, st);
+    }
+    flow->serial = tt->next_serial++;
+    flow->private = st;
+    list_push_front(&tt->iter_flows, &flow->iter_node);
+    flow_wheel_insert(&tt->wheel, flow);
+    flow_index_insert(&tt->index, flow);
+
+    return 1;
+}
+
+static int table_tss_modify(struct sw_table *swt,
+                const struct sw_flow_key *key, uint16_t priority, int strict,
+                const struct ofp_action_header *actions, size_t actions_len)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct flow_index_cursor cursor;
+    struct sw_flow *flow;
+    unsigned int count = 0;
+
+    if (strict) {
+        struct tss_subtable *st;
+
+        /* A strict match has the same shape as 'key', so at most one flow
+         * in the corresponding subtable can match. */
+        st = tss_find_subtable(tt, &key->mask);
+        flow = st ? tss_find_exact(st, key, priority) : NULL;
+        if (flow) {
+            flow_replace_acts(flow, actions, actions_len);
+            flow_index_update_actions(&tt->index, flow);
+            count = 1;
+        }
+        return count;
+    }
+
+    flow_index_cursor_init(&cursor, &tt->index, key, htons(OFPP_NONE),
+                           &tt->iter_flows);
+    while ((flow = flow_index_cursor_next(&cursor)) != NULL) {
+        if (flow_matches_desc(&flow->key, key, strict)) {
+            flow_replace_acts(flow, actions, actions_len);
+            flow_index_update_actions(&tt->index, flow);
+            count++;
+        }
+    }
+    flow_index_cursor_destroy(&cursor);
+    return count;
+}
+
+static int table_tss_has_conflict(struct sw_table *swt,
+                                  const struct sw_flow_key *key,
+                                  uint16_t priority, int strict)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct flow_index_cursor cursor;
+    struct sw_flow *flow;
+    bool conflict = false;
+
+    if (strict) {
+        struct tss_subtable *st;
+
+        st = tss_find_subtable(tt, &key->mask);
+        return st && tss_find_exact(st, key, priority) != NULL;
+    }
+
+    flow_index_cursor_init(&cursor, &tt->index, key, htons(OFPP_NONE),
+                           &tt->iter_flows);
+    while ((flow = flow_index_cursor_next(&cursor)) != NULL) {
+        if (flow_matches_2desc(&flow->key, key, strict)
+                && (flow->priority == priority)) {
+            conflict = true;
+            break;
+        }
+    }
+    flow_index_cursor_destroy(&cursor);
+    return conflict;
+}
+
+static int table_tss_delete(struct datapath *dp, struct sw_table *swt,
+                            const struct sw_flow_key *key,
+                            uint16_t out_port,
+                            uint16_t priority, int strict)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct flow_index_cursor cursor;
+    struct sw_flow *flow;
+    unsigned int count = 0;
+
+    if (strict) {
+        struct tss_subtable *st;
+
+        st = tss_find_subtable(tt, &key->mask);
+        flow = st ? tss_find_exact(st, key, priority) : NULL;
+        if (flow && flow_has_out_port(flow, out_port)) {
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            tss_remove(tt, flow);
+            flow_free(flow);
+            count = 1;
+        }
+        return count;
+    }
+
+    flow_index_cursor_init(&cursor, &tt->index, key, out_port,
+                           &tt->iter_flows);
+    while ((flow = flow_index_cursor_next(&cursor)) != NULL) {
+        if (flow_matches_desc(&flow->key, key, strict)
+                && flow_has_out_port(flow, out_port)) {
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            tss_remove(tt, flow);
+            flow_free(flow);
+            count++;
+        }
+    }
+    flow_index_cursor_destroy(&cursor);
+    return count;
+}
+
+static void table_tss_timeout(struct sw_table *swt, struct list *deleted)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+
+    flow_wheel_run(&tt->wheel, tss_remove_cb, tt, deleted);
+}
+
+static void table_tss_destroy(struct sw_table *swt)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct sw_flow *flow, *n;
+
+    LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, iter_node, &tt->iter_flows) {
+        tss_remove(tt, flow);
+        flow_free(flow);
+    }
+    flow_index_destroy(&tt->index);
+    free(tt);
+}
+
+static int table_tss_iterate(struct sw_table *swt,
+                             const struct sw_flow_key *key,
+                             uint16_t out_port,
+                             struct sw_table_position *position,
+                             int (*callback)(struct sw_flow *, void *),
+                             void *private)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct sw_flow *flow;
+    struct list *node;
+    unsigned long start;
+
+    start = ~position->private[0];
+    node = flow_iterate_start(&tt->iter_flows, position, tt->n_removed);
+    for (; node != &tt->iter_flows; node = node->next) {
+        int error = 0;
+
+        flow = CONTAINER_OF(node, struct sw_flow, iter_node);
+        if (flow->serial > start) {
+            continue;
+        }
+        if (flow_matches_2wild(key, &flow->key)
+                && flow_has_out_port(flow, out_port)) {
+            error = callback(flow, private);
+        }
+        if (!error && table_position_visit(position)) {
+            error = EAGAIN;
+        }
+        if (error) {
+            flow_iterate_save(position, flow, tt->n_removed);
+            return error;
+        }
+    }
+    return 0;
+}
+
+static void table_tss_stats(struct sw_table *swt,
+                            struct sw_table_stats *stats)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    stats->name = "tss";
+    stats->wildcards = OFPFW_ALL;
+    stats->n_flows   = tt->n_flows;
+    stats->max_flows = tt->max_flows;
+    stats->n_lookup  = swt->n_lookup;
+    stats->n_matched = swt->n_matched;
+}
+
+struct sw_table *table_tss_create(unsigned int max_flows)
+{
+    struct sw_table_tss *tt;
+    struct sw_table *swt;
+
+    tt = calloc(1, sizeof *tt);
+    if (tt == NULL)
+        return NULL;
+
+    swt = &tt->swt;
+    swt->lookup = table_tss_lookup;
+    swt->insert = table_tss_insert;
+    swt->modify = table_tss_modify;
+    swt->has_conflict = table_tss_has_conflict;
+    swt->delete = table_tss_delete;
+    swt->timeout = table_tss_timeout;
+    swt->destroy = table_tss_destroy;
+    swt->iterate = table_tss_iterate;
+    swt->stats = table_tss_stats;
+
+    tt->max_flows = max_flows;
+    tt->n_flows = 0;
+    list_init(&tt->subtables);
+    list_init(&tt->iter_flows);
+    tt->next_serial = 1;
+    flow_wheel_init(&tt->wheel);
+    flow_index_init(&tt->index);
+
+    return swt;
+}
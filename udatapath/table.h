@@ -55,21 +55,45 @@ struct sw_table_stats {
     unsigned int max_flows;      /* Flow capacity. */
     unsigned long int n_lookup;  /* Number of packets looked up. */
     unsigned long int n_matched; /* Number of packets that have hit. */
+
+    /* Occupancy and probe statistics for hashed tables.  Left zero by
+     * tables that do not hash their flows. */
+    unsigned int n_buckets;      /* Number of hash buckets. */
+    unsigned int max_chain;      /* Flows in the most heavily used bucket. */
+    unsigned long long n_probes; /* Flows compared during lookups. */
 };
 
 /* Position within an iteration of a sw_table.
  *
  * The contents are private to the table implementation, except that a position
- * initialized to all-zero-bits represents the start of a table. */
+ * initialized to all-zero-bits represents the start of a table and that the
+ * caller may set 'max_visits'.
+ *
+ * If 'max_visits' is nonzero, the iterator function counts it down for each
+ * flow that it walks past, whether or not the flow matches, and stops with
+ * EAGAIN when it reaches zero.  This bounds the time a single call takes even
+ * when few flows match.  Tables that cannot resume partway through ignore
+ * it. */
 struct sw_table_position {
     unsigned long private[4];
+    unsigned int max_visits;
 };
 
+/* Counts a visit to one flow against 'position''s 'max_visits'.  Returns
+ * nonzero if the iteration should now save its position past the flow and
+ * return EAGAIN. */
+static inline int
+table_position_visit(struct sw_table_position *position)
+{
+    return position->max_visits && !--position->max_visits;
+}
+
 /* A single table of flows.  */
 struct sw_table {
     /* The number of packets that have been looked up and matched,
-     * respecitvely.  To make these 100% accurate, they should be atomic.  
-     * However, we're primarily concerned about speed. */
+     * respecitvely, in the emergency table.  Lookups in the working tables
+     * are counted in the chain_cache that they go through instead, so that
+     * threads forwarding in parallel do not share counters. */
     unsigned long long n_lookup;
     unsigned long long n_matched;
 
@@ -122,29 +146,31 @@ struct sw_table {
      * matches 'key' and output port 'out_port' to 'callback'.  The 
      * callback function should return 0 to continue iteration or a 
      * nonzero error code to stop.  The iterator function returns either 
-     * 0 if the table iteration completed or the value returned by the 
-     * callback function otherwise.
+     * 0 if the table iteration completed, EAGAIN if it used up
+     * 'position->max_visits', or the value returned by the callback
+     * function otherwise.
      *
      * The iteration starts at 'position', which may be initialized to
      * all-zero-bits to iterate from the beginning of the table.  If the
-     * iteration terminates due to an error from the callback function,
-     * 'position' is updated to a value that can be passed back to the
-     * iterator function to resume iteration later with the following
-     * flow. */
+     * iteration terminates early, 'position' is updated to a value that
+     * can be passed back to the iterator function to resume iteration later
+     * with the following flow. */
     int (*iterate)(struct sw_table *table,
                const struct sw_flow_key *key, uint16_t out_port,
                struct sw_table_position *position,
                int (*callback)(struct sw_flow *flow, void *private),
                void *private);
 
-    /* Dumps statistics for 'table' into 'stats'. */
+    /* Dumps statistics for 'table' into 'stats', which the caller
+     * initializes to all-zero-bits. */
     void (*stats)(struct sw_table *table, struct sw_table_stats *stats);
 };
 
-struct sw_table *table_hash_create(unsigned int polynomial,
-                                   unsigned int n_buckets);
-struct sw_table *table_hash2_create(unsigned int poly0, unsigned int buckets0,
-                                    unsigned int poly1, unsigned int buckets1);
+struct sw_table *table_hash_create(unsigned int n_buckets);
+struct sw_table *table_hash2_create(unsigned int buckets0,
+                                    unsigned int buckets1);
+struct sw_table *table_hmap_create(unsigned int max_flows);
 struct sw_table *table_linear_create(unsigned int max_flows);
+struct sw_table *table_tss_create(unsigned int max_flows);
 
 #endif /* table.h */
@@ -44,6 +44,8 @@
 #include "daemon.h"
 #include "datapath.h"
 #include "fault.h"
+#include "flow-hash.h"
+#include "flow-index.h"
 #include "openflow/openflow.h"
 #include "poll-loop.h"
 #include "queue.h"
@@ -78,6 +80,9 @@ static uint64_t dpid = UINT64_MAX;
 static char *port_list;
 static char *local_port = "tap:";
 static uint16_t num_queues = NETDEV_MAX_QUEUES;
+static int rx_budget = DP_RX_BUDGET_DEFAULT;
+static int n_workers;
+static int n_buffers = DP_N_BUFFERS_DEFAULT;
 
 static void add_ports(struct datapath *dp, char *port_list);
 
@@ -119,6 +124,8 @@ udatapath_cmd(int argc, char *argv[])
     }
 
     error = dp_new(&dp, dpid);
+    dp_set_rx_budget(dp, rx_budget);
+    dp_set_n_buffers(dp, n_buffers);
 
     n_listeners = 0;
     for (i = optind; i < argc; i++) {
@@ -156,6 +163,13 @@ udatapath_cmd(int argc, char *argv[])
     die_if_already_running();
     daemonize();
 
+    if (n_workers) {
+        error = dp_start_workers(dp, n_workers);
+        if (error) {
+            OFP_FATAL(error, "failed to start worker threads");
+        }
+    }
+
     for (;;) {
         dp_run(dp);
         dp_wait(dp);
@@ -194,7 +208,13 @@ parse_options(int argc, char *argv[])
         OPT_SERIAL_NUM,
         OPT_BOOTSTRAP_CA_CERT,
         OPT_NO_LOCAL_PORT,
-        OPT_NO_SLICING
+        OPT_NO_SLICING,
+        OPT_NO_FLOW_INDEX,
+        OPT_FLOW_HASH,
+        OPT_RX_BUDGET,
+        OPT_WORKERS,
+        OPT_BUFFERS,
+        OPT_POLL_BACKEND
     };
 
     static struct option long_options[] = {
@@ -206,6 +226,12 @@ parse_options(int argc, char *argv[])
         {"help",        no_argument, 0, 'h'},
         {"version",     no_argument, 0, 'V'},
         {"no-slicing",  no_argument, 0, OPT_NO_SLICING},
+        {"no-flow-index", no_argument, 0, OPT_NO_FLOW_INDEX},
+        {"flow-hash",   required_argument, 0, OPT_FLOW_HASH},
+        {"rx-budget",   required_argument, 0, OPT_RX_BUDGET},
+        {"workers",     required_argument, 0, OPT_WORKERS},
+        {"buffers",     required_argument, 0, OPT_BUFFERS},
+        {"poll-backend", required_argument, 0, OPT_POLL_BACKEND},
         {"mfr-desc",    required_argument, 0, OPT_MFR_DESC},
         {"hw-desc",     required_argument, 0, OPT_HW_DESC},
         {"sw-desc",     required_argument, 0, OPT_SW_DESC},
@@ -295,6 +321,53 @@ parse_options(int argc, char *argv[])
             num_queues = 0;
             break;
 
+        case OPT_NO_FLOW_INDEX:
+            flow_index_disable();
+            break;
+
+        case OPT_FLOW_HASH: {
+            int error = flow_hash_select(optarg);
+            if (error == ENOENT) {
+                ofp_fatal(0, "unknown flow hash \"%s\"", optarg);
+            } else if (error) {
+                ofp_fatal(0, "flow hash \"%s\" is not supported on this "
+                          "machine", optarg);
+            }
+            break;
+        }
+
+        case OPT_POLL_BACKEND: {
+            int error = poll_backend_select(optarg);
+            if (error == ENOENT) {
+                ofp_fatal(0, "unknown poll backend \"%s\"", optarg);
+            } else if (error) {
+                ofp_fatal(error, "poll backend \"%s\" is not available",
+                          optarg);
+            }
+            break;
+        }
+
+        case OPT_RX_BUDGET:
+            rx_budget = atoi(optarg);
+            if (rx_budget < 1) {
+                ofp_fatal(0, "--rx-budget argument must be at least 1");
+            }
+            break;
+
+        case OPT_WORKERS:
+            n_workers = atoi(optarg);
+            if (n_workers < 0) {
+                ofp_fatal(0, "--workers argument must not be negative");
+            }
+            break;
+
+        case OPT_BUFFERS:
+            n_buffers = atoi(optarg);
+            if (n_buffers < 1) {
+                ofp_fatal(0, "--buffers argument must be at least 1");
+            }
+            break;
+
         DAEMON_OPTION_HANDLERS
 
 #ifdef HAVE_OPENSSL
@@ -327,11 +400,22 @@ usage(void)
     printf("\nConfiguration options:\n"
            "  -i, --interfaces=NETDEV[,NETDEV]...\n"
            "                          add specified initial switch ports\n"
+           "                          (prefix NETDEV with mmap: to use\n"
+           "                          PACKET_MMAP rings)\n"
            "  -L, --local-port=NETDEV set network device for local port\n"
            "  --no-local-port         disable local port\n"
            "  -d, --datapath-id=ID    Use ID as the OpenFlow switch ID\n"
            "                          (ID must consist of 12 hex digits)\n"
            "  --no-slicing            disable slicing\n"
+           "  --no-flow-index         do not index flows for flow_mods\n"
+           "  --flow-hash=HASH        hash flow tables with HASH (crc32c,\n"
+           "                          lookup3, or crc32)\n"
+           "  --rx-budget=N           receive at most N packets from each\n"
+           "                          port per main loop iteration\n"
+           "  --workers=N             forward packets in N threads\n"
+           "  --buffers=N             buffer up to N packets for controllers\n"
+           "  --poll-backend=BACKEND  wait for events with BACKEND (poll or\n"
+           "                          epoll)\n"
            "\nOther options:\n"
            "  -D, --detach            run in background as daemon\n"
            "  -P, --pidfile[=FILE]    create pidfile (default: %s/ofdatapath.pid)\n"
@@ -230,8 +230,13 @@ usage(void)
            "  show-protostat SWITCH       report protocol statistics\n"
            "  dump-desc SWITCH            print switch description\n"
            "  dump-tables SWITCH          print table stats\n"
+           "  dump-table-hash SWITCH      print hash table occupancy stats\n"
+           "  dump-buffers SWITCH         print packet buffer stats\n"
+           "  dump-flow-delta SWITCH [G]  print flows changed since G\n"
+           "  dump-flow-slab SWITCH       print flow memory stats\n"
            "  mod-port SWITCH IFACE ACT   modify port behavior\n"
            "  dump-ports SWITCH [PORT]    print port statistics\n"
+           "  dump-outgoing SWITCH        print outgoing packet copy stats\n"
            "  desc SWITCH STRING          set switch description\n"
            "  dump-flows SWITCH           print all flow entries\n"
            "  dump-flows SWITCH FLOW      print matching FLOWs\n"
@@ -732,6 +737,58 @@ do_dump_tables(const struct settings *s UNUSED, int argc UNUSED, char *argv[])
   dump_trivial_stats_transaction(argv[1], OFPST_TABLE);
 }
 
+static void
+do_dump_buffers(const struct settings *s UNUSED, int argc UNUSED,
+                char *argv[])
+{
+    struct ofp_ext_stats_header *osh;
+    struct ofpbuf *request;
+
+    osh = alloc_stats_request(sizeof *osh, OFPST_VENDOR, &request);
+    osh->vendor = htonl(OPENFLOW_VENDOR_ID);
+    osh->subtype = htonl(OFP_EXT_STATS_BUFFER);
+    dump_stats_transaction(argv[1], request);
+}
+
+static void
+do_dump_flow_slab(const struct settings *s UNUSED, int argc UNUSED,
+                  char *argv[])
+{
+    struct ofp_ext_stats_header *osh;
+    struct ofpbuf *request;
+
+    osh = alloc_stats_request(sizeof *osh, OFPST_VENDOR, &request);
+    osh->vendor = htonl(OPENFLOW_VENDOR_ID);
+    osh->subtype = htonl(OFP_EXT_STATS_FLOW_SLAB);
+    dump_stats_transaction(argv[1], request);
+}
+
+static void
+do_dump_outgoing(const struct settings *s UNUSED, int argc UNUSED,
+                 char *argv[])
+{
+    struct ofp_ext_stats_header *osh;
+    struct ofpbuf *request;
+
+    osh = alloc_stats_request(sizeof *osh, OFPST_VENDOR, &request);
+    osh->vendor = htonl(OPENFLOW_VENDOR_ID);
+    osh->subtype = htonl(OFP_EXT_STATS_PORT_OUTGOING);
+    dump_stats_transaction(argv[1], request);
+}
+
+static void
+do_dump_table_hash(const struct settings *s UNUSED, int argc UNUSED,
+                   char *argv[])
+{
+    struct ofp_ext_stats_header *osh;
+    struct ofpbuf *request;
+
+    osh = alloc_stats_request(sizeof *osh, OFPST_VENDOR, &request);
+    osh->vendor = htonl(OPENFLOW_VENDOR_ID);
+    osh->subtype = htonl(OFP_EXT_STATS_TABLE_HASH);
+    dump_stats_transaction(argv[1], request);
+}
+
 static uint32_t
 str_to_u32(const char *str)
 {
@@ -746,6 +803,19 @@ str_to_u32(const char *str)
     return value;
 }
 
+static void
+do_dump_flow_delta(const struct settings *s UNUSED, int argc, char *argv[])
+{
+    struct ofp_ext_flow_delta_request *rq;
+    struct ofpbuf *request;
+
+    rq = alloc_stats_request(sizeof *rq, OFPST_VENDOR, &request);
+    rq->header.vendor = htonl(OPENFLOW_VENDOR_ID);
+    rq->header.subtype = htonl(OFP_EXT_STATS_FLOW_DELTA);
+    rq->since = htonl(argc > 2 ? str_to_u32(argv[2]) : 0);
+    dump_stats_transaction(argv[1], request);
+}
+
 static void
 str_to_mac(const char *str, uint8_t mac[6]) 
 {
@@ -1752,6 +1822,11 @@ static struct command all_commands[] = {
     { "monitor", 1, 1, do_monitor },
     { "dump-desc", 1, 1, do_dump_desc },
     { "dump-tables", 1, 1, do_dump_tables },
+    { "dump-table-hash", 1, 1, do_dump_table_hash },
+    { "dump-buffers", 1, 1, do_dump_buffers },
+    { "dump-flow-delta", 1, 2, do_dump_flow_delta },
+    { "dump-flow-slab", 1, 1, do_dump_flow_slab },
+    { "dump-outgoing", 1, 1, do_dump_outgoing },
     { "desc", 2, 2, do_desc },
     { "dump-flows", 1, 2, do_dump_flows },
     { "dump-aggregate", 1, 2, do_dump_aggregate },